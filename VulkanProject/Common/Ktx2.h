@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+// The subset of the KTX2 container shared by the TextureBaker tool and the runtime loader.
+// Only single layer, single face 2D textures without supercompression are written or accepted.
+namespace Ktx2 {
+
+	constexpr uint8_t IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	// Standard key, four characters out of "rgba01" giving the source of each sampled channel
+	constexpr const char* SWIZZLE_KEY = "KTXswizzle";
+
+	struct Header {
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	static_assert(sizeof(Header) == 80, "KTX2 header layout");
+
+	// One per mip level, directly after the header, level 0 first
+	struct LevelIndex {
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	inline bool HasIdentifier(const Header& header)
+	{
+		return memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) == 0;
+	}
+
+	// The baked file lives next to its source image: textures/foo.png -> textures/foo.ktx2
+	inline std::string GetBakedPath(const std::string& sourcePath)
+	{
+		return std::filesystem::path(sourcePath).replace_extension(".ktx2").string();
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Process wide pool of worker threads for startup work (pipeline builds, texture decoding).
+// Submit returns a future, exceptions thrown by a job are rethrown from future::get().
+// High priority jobs are taken before every queued normal one, for per frame work that the
+// frame waits on while background jobs such as texture decodes are queued.
+class ThreadPool {
+public:
+	enum class Priority { Normal, High };
+
+	static ThreadPool& Instance()
+	{
+		static ThreadPool instance;
+		return instance;
+	}
+
+	template<typename F>
+	auto Submit(F&& job, Priority priority = Priority::Normal) -> std::future<decltype(job())>
+	{
+		using Result = decltype(job());
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+		std::future<Result> future = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			(priority == Priority::High ? m_HighPriorityJobs : m_Jobs).push([task]() { (*task)(); });
+		}
+		m_Condition.notify_one();
+		return future;
+	}
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+	ThreadPool()
+	{
+		uint32_t threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		for (uint32_t i = 0; i < threadCount; ++i) {
+			m_Workers.emplace_back([this]() { WorkerLoop(); });
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Condition.notify_all();
+		for (auto& worker : m_Workers) {
+			worker.join();
+		}
+	}
+
+	void WorkerLoop()
+	{
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Condition.wait(lock, [this]() { return m_Stopping || !m_HighPriorityJobs.empty() || !m_Jobs.empty(); });
+				if (m_Stopping && m_HighPriorityJobs.empty() && m_Jobs.empty()) {
+					return;
+				}
+				std::queue<std::function<void()>>& jobs = m_HighPriorityJobs.empty() ? m_Jobs : m_HighPriorityJobs;
+				job = std::move(jobs.front());
+				jobs.pop();
+			}
+			job();
+		}
+	}
+
+	std::vector<std::thread> m_Workers;
+	std::queue<std::function<void()>> m_Jobs;
+	std::queue<std::function<void()>> m_HighPriorityJobs;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_Stopping = false;
+};
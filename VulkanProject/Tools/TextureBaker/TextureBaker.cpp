@@ -0,0 +1,461 @@
+// Offline texture baker: loads a scene, finds every texture its materials reference and writes a
+// block compressed KTX2 file with a full mip chain next to each one. The renderer picks those up
+// instead of the source image when the device supports BC formats.
+//
+//   albedo           -> BC7 sRGB (alpha kept for masked materials)
+//   normal           -> BC5, xy only, the shader rebuilds z
+//   metal-roughness  -> BC5 with roughness in r and metallic in g, or BC4 when metallic is empty,
+//                       a KTXswizzle entry maps them back to the g/b channels the shader reads
+//
+// Usage: TextureBaker <scene file> [extra albedo textures...]
+#include <vulkan/vulkan.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "bc7enc.h"
+#define RGBCX_IMPLEMENTATION
+#include "rgbcx.h"
+#include "../../Common/Ktx2.h"
+#include "../../Common/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+enum class TextureKind {
+	Albedo,
+	Normal,
+	MetallicRoughness
+};
+
+struct MipLevel {
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> rgba;
+};
+
+struct BakedTexture {
+	uint32_t width;
+	uint32_t height;
+	VkFormat format;
+	uint32_t blockBytes;
+	std::string swizzle;
+	std::vector<std::vector<uint8_t>> levels;
+};
+
+static float SrgbToLinear(uint8_t value)
+{
+	float c = value / 255.0f;
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t LinearToSrgb(float value)
+{
+	float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	return static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+}
+
+static uint8_t ToUnorm8(float value)
+{
+	return static_cast<uint8_t>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+}
+
+// 2x2 box filter, albedo is averaged in linear space and normals are renormalized
+static MipLevel Downsample(const MipLevel& src, TextureKind kind)
+{
+	MipLevel dst{};
+	dst.width = std::max(1u, src.width / 2);
+	dst.height = std::max(1u, src.height / 2);
+	dst.rgba.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+	for (uint32_t y = 0; y < dst.height; ++y) {
+		for (uint32_t x = 0; x < dst.width; ++x) {
+			uint32_t x0 = std::min(x * 2, src.width - 1);
+			uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+			uint32_t y0 = std::min(y * 2, src.height - 1);
+			uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+			const uint8_t* taps[4] = {
+				&src.rgba[(static_cast<size_t>(y0) * src.width + x0) * 4],
+				&src.rgba[(static_cast<size_t>(y0) * src.width + x1) * 4],
+				&src.rgba[(static_cast<size_t>(y1) * src.width + x0) * 4],
+				&src.rgba[(static_cast<size_t>(y1) * src.width + x1) * 4]
+			};
+
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (const uint8_t* tap : taps) {
+				for (int c = 0; c < 4; ++c) {
+					if (kind == TextureKind::Albedo && c < 3) {
+						sum[c] += SrgbToLinear(tap[c]);
+					}
+					else if (kind == TextureKind::Normal && c < 3) {
+						sum[c] += tap[c] / 255.0f * 2.0f - 1.0f;
+					}
+					else {
+						sum[c] += tap[c] / 255.0f;
+					}
+				}
+			}
+
+			uint8_t* out = &dst.rgba[(static_cast<size_t>(y) * dst.width + x) * 4];
+			if (kind == TextureKind::Normal) {
+				float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+				float scale = length > 0.0f ? 1.0f / length : 0.0f;
+				for (int c = 0; c < 3; ++c) {
+					out[c] = ToUnorm8(sum[c] * scale * 0.5f + 0.5f);
+				}
+			}
+			for (int c = 0; c < 4; ++c) {
+				if (kind == TextureKind::Albedo && c < 3) {
+					out[c] = LinearToSrgb(sum[c] * 0.25f);
+				}
+				else if (kind != TextureKind::Normal || c == 3) {
+					out[c] = ToUnorm8(sum[c] * 0.25f);
+				}
+			}
+		}
+	}
+	return dst;
+}
+
+// Encodes one level block by block, edge blocks repeat the last row/column
+template<typename EncodeBlock>
+static std::vector<uint8_t> EncodeLevel(const MipLevel& level, uint32_t blockBytes, EncodeBlock encodeBlock)
+{
+	uint32_t blocksX = (level.width + 3) / 4;
+	uint32_t blocksY = (level.height + 3) / 4;
+	std::vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+
+	uint8_t pixels[16 * 4];
+	for (uint32_t by = 0; by < blocksY; ++by) {
+		for (uint32_t bx = 0; bx < blocksX; ++bx) {
+			for (uint32_t py = 0; py < 4; ++py) {
+				for (uint32_t px = 0; px < 4; ++px) {
+					uint32_t x = std::min(bx * 4 + px, level.width - 1);
+					uint32_t y = std::min(by * 4 + py, level.height - 1);
+					memcpy(&pixels[(py * 4 + px) * 4], &level.rgba[(static_cast<size_t>(y) * level.width + x) * 4], 4);
+				}
+			}
+			encodeBlock(&blocks[(static_cast<size_t>(by) * blocksX + bx) * blockBytes], pixels);
+		}
+	}
+	return blocks;
+}
+
+static BakedTexture Bake(const std::string& path, TextureKind kind)
+{
+	int width, height, channels;
+	unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels) {
+		throw std::runtime_error("failed to load texture image: " + path);
+	}
+
+	MipLevel base{};
+	base.width = static_cast<uint32_t>(width);
+	base.height = static_cast<uint32_t>(height);
+	base.rgba.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(pixels);
+
+	BakedTexture baked{};
+	baked.width = base.width;
+	baked.height = base.height;
+	if (kind == TextureKind::Albedo) {
+		baked.format = VK_FORMAT_BC7_SRGB_BLOCK;
+		baked.blockBytes = 16;
+		baked.swizzle = "rgba";
+	}
+	else if (kind == TextureKind::Normal) {
+		baked.format = VK_FORMAT_BC5_UNORM_BLOCK;
+		baked.blockBytes = 16;
+		baked.swizzle = "rg01";
+	}
+	else {
+		// glTF layout has roughness in g and metallic in b, pack them into r and g
+		bool hasMetallic = false;
+		for (size_t i = 0; i < base.rgba.size(); i += 4) {
+			base.rgba[i + 0] = base.rgba[i + 1];
+			base.rgba[i + 1] = base.rgba[i + 2];
+			base.rgba[i + 2] = 0;
+			base.rgba[i + 3] = 255;
+			hasMetallic |= base.rgba[i + 1] != 0;
+		}
+		baked.format = hasMetallic ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_BC4_UNORM_BLOCK;
+		baked.blockBytes = hasMetallic ? 16 : 8;
+		baked.swizzle = hasMetallic ? "0rg1" : "0r01";
+	}
+
+	bc7enc_compress_block_params bc7Params;
+	bc7enc_compress_block_params_init(&bc7Params);
+
+	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	MipLevel level = std::move(base);
+	for (uint32_t i = 0; i < mipLevels; ++i) {
+		if (i > 0) {
+			level = Downsample(level, kind);
+		}
+
+		if (baked.format == VK_FORMAT_BC7_SRGB_BLOCK) {
+			baked.levels.push_back(EncodeLevel(level, baked.blockBytes, [&bc7Params](uint8_t* block, const uint8_t* pixels) {
+				bc7enc_compress_block(block, pixels, &bc7Params);
+			}));
+		}
+		else if (baked.format == VK_FORMAT_BC5_UNORM_BLOCK) {
+			baked.levels.push_back(EncodeLevel(level, baked.blockBytes, [](uint8_t* block, const uint8_t* pixels) {
+				rgbcx::encode_bc5(block, pixels, 0, 1, 4);
+			}));
+		}
+		else {
+			baked.levels.push_back(EncodeLevel(level, baked.blockBytes, [](uint8_t* block, const uint8_t* pixels) {
+				rgbcx::encode_bc4(block, pixels, 4);
+			}));
+		}
+	}
+	return baked;
+}
+
+template<typename T>
+static void Append(std::vector<uint8_t>& bytes, const T& value)
+{
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(&value);
+	bytes.insert(bytes.end(), data, data + sizeof(T));
+}
+
+static void AlignTo(std::vector<uint8_t>& bytes, size_t alignment)
+{
+	bytes.resize((bytes.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+// Basic data format descriptor for the three BC formats we write
+static std::vector<uint8_t> BuildDataFormatDescriptor(const BakedTexture& baked)
+{
+	const uint32_t KHR_DF_MODEL_BC4 = 131;
+	const uint32_t KHR_DF_MODEL_BC5 = 132;
+	const uint32_t KHR_DF_MODEL_BC7 = 134;
+	const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+	const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+	const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+
+	uint32_t model = KHR_DF_MODEL_BC7;
+	uint32_t sampleCount = 1;
+	if (baked.format == VK_FORMAT_BC5_UNORM_BLOCK) {
+		model = KHR_DF_MODEL_BC5;
+		sampleCount = 2;
+	}
+	else if (baked.format == VK_FORMAT_BC4_UNORM_BLOCK) {
+		model = KHR_DF_MODEL_BC4;
+	}
+	uint32_t transfer = baked.format == VK_FORMAT_BC7_SRGB_BLOCK ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR;
+	uint32_t blockSize = 24 + 16 * sampleCount;
+
+	std::vector<uint8_t> dfd;
+	Append<uint32_t>(dfd, 4 + blockSize);
+	Append<uint32_t>(dfd, 0);                                   // vendorId = Khronos, descriptorType = basic
+	Append<uint32_t>(dfd, 2 | (blockSize << 16));               // versionNumber, descriptorBlockSize
+	Append<uint32_t>(dfd, model | (KHR_DF_PRIMARIES_BT709 << 8) | (transfer << 16));
+	Append<uint32_t>(dfd, 3 | (3 << 8));                        // 4x4x1x1 texel block
+	Append<uint32_t>(dfd, baked.blockBytes);                    // bytesPlane0
+	Append<uint32_t>(dfd, 0);                                   // bytesPlane4-7
+
+	// BC4/BC5 channels are red and green, BC7 has a single colour channel with id 0
+	for (uint32_t sample = 0; sample < sampleCount; ++sample) {
+		uint32_t bitOffset = sample * 64;
+		uint32_t bitLength = baked.blockBytes * 8 / sampleCount - 1;
+		Append<uint32_t>(dfd, bitOffset | (bitLength << 16) | (sample << 24));
+		Append<uint32_t>(dfd, 0);                               // sample position
+		Append<uint32_t>(dfd, 0);                               // sampleLower
+		Append<uint32_t>(dfd, UINT32_MAX);                      // sampleUpper
+	}
+	return dfd;
+}
+
+static std::vector<uint8_t> BuildKeyValueData(const BakedTexture& baked)
+{
+	std::vector<uint8_t> kvd;
+	auto addEntry = [&kvd](const std::string& key, const std::string& value) {
+		uint32_t length = static_cast<uint32_t>(key.size() + 1 + value.size() + 1);
+		Append(kvd, length);
+		kvd.insert(kvd.end(), key.begin(), key.end());
+		kvd.push_back(0);
+		kvd.insert(kvd.end(), value.begin(), value.end());
+		kvd.push_back(0);
+		AlignTo(kvd, 4);
+	};
+
+	// keys are sorted by their byte values
+	addEntry(Ktx2::SWIZZLE_KEY, baked.swizzle);
+	addEntry("KTXwriter", "VulkanProject TextureBaker");
+	return kvd;
+}
+
+static void WriteKtx2(const std::string& path, const BakedTexture& baked)
+{
+	uint32_t levelCount = static_cast<uint32_t>(baked.levels.size());
+	std::vector<uint8_t> dfd = BuildDataFormatDescriptor(baked);
+	std::vector<uint8_t> kvd = BuildKeyValueData(baked);
+
+	Ktx2::Header header{};
+	memcpy(header.identifier, Ktx2::IDENTIFIER, sizeof(Ktx2::IDENTIFIER));
+	header.vkFormat = baked.format;
+	header.typeSize = 1;
+	header.pixelWidth = baked.width;
+	header.pixelHeight = baked.height;
+	header.pixelDepth = 0;
+	header.layerCount = 0;
+	header.faceCount = 1;
+	header.levelCount = levelCount;
+	header.supercompressionScheme = 0;
+	header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2::Header) + levelCount * sizeof(Ktx2::LevelIndex));
+	header.dfdByteLength = static_cast<uint32_t>(dfd.size());
+	header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+	header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+	std::vector<uint8_t> file(header.kvdByteOffset + header.kvdByteLength);
+	memcpy(file.data() + header.dfdByteOffset, dfd.data(), dfd.size());
+	memcpy(file.data() + header.kvdByteOffset, kvd.data(), kvd.size());
+
+	// level data goes smallest mip first, each level aligned to the block size
+	std::vector<Ktx2::LevelIndex> levelIndex(levelCount);
+	for (uint32_t i = levelCount; i-- > 0;) {
+		AlignTo(file, baked.blockBytes);
+		levelIndex[i].byteOffset = file.size();
+		levelIndex[i].byteLength = baked.levels[i].size();
+		levelIndex[i].uncompressedByteLength = baked.levels[i].size();
+		file.insert(file.end(), baked.levels[i].begin(), baked.levels[i].end());
+	}
+
+	memcpy(file.data(), &header, sizeof(header));
+	memcpy(file.data() + sizeof(header), levelIndex.data(), levelIndex.size() * sizeof(Ktx2::LevelIndex));
+
+	// write next to the target and rename so the renderer never sees a half written file
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			throw std::runtime_error("failed to open " + tempPath + " for writing!");
+		}
+		out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+		if (!out) {
+			throw std::runtime_error("failed to write " + tempPath + "!");
+		}
+	}
+	std::filesystem::rename(tempPath, path);
+}
+
+static bool IsUpToDate(const std::string& sourcePath, const std::string& bakedPath)
+{
+	std::error_code error;
+	auto bakedTime = std::filesystem::last_write_time(bakedPath, error);
+	if (error) {
+		return false;
+	}
+	return bakedTime >= std::filesystem::last_write_time(sourcePath);
+}
+
+static void CollectSceneTextures(const std::string& scenePath, std::map<std::string, TextureKind>& textures)
+{
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(scenePath, 0);
+	if (!scene) {
+		throw std::runtime_error("ERROR::ASSIMP::" + std::string(importer.GetErrorString()));
+	}
+
+	// same path resolution as Scene::LoadMeshData so the runtime finds the baked files
+	std::filesystem::path baseDir = std::filesystem::path(scenePath).parent_path();
+	const std::pair<aiTextureType, TextureKind> slots[] = {
+		{ aiTextureType_DIFFUSE, TextureKind::Albedo },
+		{ aiTextureType_NORMALS, TextureKind::Normal },
+		{ aiTextureType_METALNESS, TextureKind::MetallicRoughness }
+	};
+
+	for (unsigned int i = 0; i < scene->mNumMaterials; ++i) {
+		aiMaterial* material = scene->mMaterials[i];
+		for (const auto& slot : slots) {
+			aiString texPath;
+			if (material->GetTexture(slot.first, 0, &texPath) != AI_SUCCESS) {
+				continue;
+			}
+			std::string path = (baseDir / texPath.C_Str()).lexically_normal().string();
+			auto inserted = textures.insert({ path, slot.second });
+			if (!inserted.second && inserted.first->second != slot.second) {
+				std::cerr << "warning: " << path << " is used with different texture kinds, baking it as the first one" << std::endl;
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::cerr << "usage: TextureBaker <scene file> [extra albedo textures...]" << std::endl;
+		return 1;
+	}
+
+	try {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		std::map<std::string, TextureKind> textures;
+		CollectSceneTextures(argv[1], textures);
+		for (int i = 2; i < argc; ++i) {
+			textures.insert({ argv[i], TextureKind::Albedo });
+		}
+
+		bc7enc_compress_block_init();
+		rgbcx::init();
+
+		std::atomic<uint32_t> bakedCount = 0;
+		std::atomic<uint64_t> sourceBytes = 0;
+		std::atomic<uint64_t> bakedBytes = 0;
+		std::vector<std::future<void>> jobs;
+		for (const auto& texture : textures) {
+			std::string sourcePath = texture.first;
+			TextureKind kind = texture.second;
+			std::string bakedPath = Ktx2::GetBakedPath(sourcePath);
+			if (IsUpToDate(sourcePath, bakedPath)) {
+				continue;
+			}
+
+			jobs.push_back(ThreadPool::Instance().Submit([=, &bakedCount, &sourceBytes, &bakedBytes]() {
+				BakedTexture baked = Bake(sourcePath, kind);
+				WriteKtx2(bakedPath, baked);
+
+				uint64_t size = 0;
+				for (const auto& level : baked.levels) {
+					size += level.size();
+				}
+				// what the runtime path would have allocated: RGBA8 plus a third for the mip chain
+				sourceBytes += static_cast<uint64_t>(baked.width) * baked.height * 4 * 4 / 3;
+				bakedBytes += size;
+				++bakedCount;
+			}));
+		}
+
+		uint32_t failedCount = 0;
+		for (auto& job : jobs) {
+			try {
+				job.get();
+			}
+			catch (const std::exception& e) {
+				std::cerr << e.what() << std::endl;
+				++failedCount;
+			}
+		}
+
+		std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+		std::cout << "TextureBaker: baked " << bakedCount << " of " << textures.size() << " textures ("
+			<< textures.size() - jobs.size() << " up to date) in " << time.count() << " ms, "
+			<< sourceBytes / (1024 * 1024) << " MB RGBA8 -> " << bakedBytes / (1024 * 1024) << " MB" << std::endl;
+		return failedCount == 0 ? 0 : 1;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
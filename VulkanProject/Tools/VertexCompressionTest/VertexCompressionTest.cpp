@@ -0,0 +1,89 @@
+// Accuracy test for the CompactVertex encoding: random vertices for meshes of very different
+// sizes go through VertexCompression::Encode/Decode (the same math as LoadVertex in vertex.glsl)
+// and the worst errors are compared against what the bit budget allows.
+//
+// Usage: VertexCompressionTest [vertices per mesh, default 100000]
+#include "../../Vulkan/source/VertexCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+namespace {
+	// half a 16 bit step along each axis
+	constexpr float MAX_RELATIVE_POSITION_ERROR = 1.7320508f / 65535.0f * 1.001f;
+	// octahedral snorm16 stays far below this
+	constexpr float MAX_DIRECTION_ERROR_DEGREES = 0.01f;
+	// half floats keep 11 significant bits
+	constexpr float MAX_RELATIVE_TEXCOORD_ERROR = 1.0f / 2048.0f;
+
+	float AngleDegrees(const glm::vec3& a, const glm::vec3& b)
+	{
+		// acos loses everything below ~0.02 degrees in float, atan2 keeps small angles
+		glm::vec3 na = glm::normalize(a);
+		glm::vec3 nb = glm::normalize(b);
+		return std::atan2(glm::length(glm::cross(na, nb)), glm::dot(na, nb)) * 57.2957795f;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t vertexCount = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 100000;
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	auto randomDirection = [&]() {
+		glm::vec3 direction;
+		do {
+			direction = glm::vec3(unit(random), unit(random), unit(random));
+		} while (glm::length(direction) < 0.01f || glm::length(direction) > 1.0f);
+		return glm::normalize(direction);
+	};
+
+	float positionError = 0.0f;
+	float normalError = 0.0f;
+	float tangentError = 0.0f;
+	float bitangentError = 0.0f;
+	float texCoordError = 0.0f;
+	for (float meshRadius : { 0.01f, 1.0f, 35.0f, 5000.0f }) {
+		MeshHandle mesh{};
+		mesh.boundsCenter = glm::vec3(unit(random), unit(random), unit(random)) * meshRadius * 10.0f;
+		mesh.boundsRadius = meshRadius;
+		glm::vec3 offset = VertexCompression::GetPositionOffset(mesh);
+		glm::vec3 scale = VertexCompression::GetPositionScale(mesh);
+
+		for (uint32_t i = 0; i < vertexCount; ++i) {
+			Vertex vertex{};
+			vertex.pos = mesh.boundsCenter + randomDirection() * meshRadius * std::abs(unit(random));
+			vertex.normal = randomDirection();
+			vertex.tangent = glm::normalize(glm::cross(vertex.normal, randomDirection()));
+			vertex.bitTangent = glm::cross(vertex.normal, vertex.tangent) * (i % 2 ? -1.0f : 1.0f);
+			vertex.texCoord = glm::vec2(unit(random), unit(random)) * 8.0f;
+
+			Vertex decoded = VertexCompression::Decode(VertexCompression::Encode(vertex, offset, scale), offset, scale);
+			positionError = std::max(positionError, glm::length(decoded.pos - vertex.pos) / meshRadius);
+			normalError = std::max(normalError, AngleDegrees(decoded.normal, vertex.normal));
+			tangentError = std::max(tangentError, AngleDegrees(decoded.tangent, vertex.tangent));
+			bitangentError = std::max(bitangentError, AngleDegrees(decoded.bitTangent, vertex.bitTangent));
+			for (int axis = 0; axis < 2; ++axis) {
+				float magnitude = std::max(std::abs(vertex.texCoord[axis]), 1.0f / 1024.0f);
+				texCoordError = std::max(texCoordError, std::abs(decoded.texCoord[axis] - vertex.texCoord[axis]) / magnitude);
+			}
+		}
+	}
+
+	std::cout << sizeof(Vertex) << " -> " << sizeof(CompactVertex) << " bytes per vertex" << std::endl;
+	std::cout << "position  " << positionError << " of the mesh radius (limit " << MAX_RELATIVE_POSITION_ERROR << ")" << std::endl;
+	std::cout << "normal    " << normalError << " degrees" << std::endl;
+	std::cout << "tangent   " << tangentError << " degrees" << std::endl;
+	std::cout << "bitangent " << bitangentError << " degrees" << std::endl;
+	std::cout << "texCoord  " << texCoordError << " relative (limit " << MAX_RELATIVE_TEXCOORD_ERROR << ")" << std::endl;
+
+	bool passed = positionError <= MAX_RELATIVE_POSITION_ERROR &&
+		normalError <= MAX_DIRECTION_ERROR_DEGREES &&
+		tangentError <= MAX_DIRECTION_ERROR_DEGREES &&
+		bitangentError <= MAX_DIRECTION_ERROR_DEGREES * 2.0f &&
+		texCoordError <= MAX_RELATIVE_TEXCOORD_ERROR;
+	std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+	return passed ? 0 : 1;
+}
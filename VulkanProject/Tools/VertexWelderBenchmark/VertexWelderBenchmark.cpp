@@ -0,0 +1,86 @@
+// Micro-benchmark for the import time vertex dedup: the std::unordered_map<Vertex> path that
+// LoadMeshData used to have against VertexWelder, on a synthetic grid expanded to a triangle list
+// the way Assimp hands faces over (every corner repeated).
+//
+// Usage: VertexWelderBenchmark [grid size, default 1024]
+#include "../../Vulkan/source/VertexWelder.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+static std::vector<Vertex> BuildTriangleList(uint32_t gridSize)
+{
+	auto makeVertex = [gridSize](uint32_t x, uint32_t y) {
+		Vertex vertex{};
+		float u = static_cast<float>(x) / gridSize;
+		float v = static_cast<float>(y) / gridSize;
+		vertex.pos = { u * 100.0f, std::sin(u * 20.0f) * std::cos(v * 20.0f), v * 100.0f };
+		vertex.normal = { 0.0f, 1.0f, 0.0f };
+		vertex.texCoord = { u, v };
+		vertex.tangent = { 1.0f, 0.0f, 0.0f };
+		vertex.bitTangent = { 0.0f, 0.0f, 1.0f };
+		return vertex;
+	};
+
+	std::vector<Vertex> corners;
+	corners.reserve(static_cast<size_t>(gridSize) * gridSize * 6);
+	for (uint32_t y = 0; y < gridSize; ++y) {
+		for (uint32_t x = 0; x < gridSize; ++x) {
+			corners.push_back(makeVertex(x, y));
+			corners.push_back(makeVertex(x + 1, y));
+			corners.push_back(makeVertex(x, y + 1));
+			corners.push_back(makeVertex(x + 1, y));
+			corners.push_back(makeVertex(x + 1, y + 1));
+			corners.push_back(makeVertex(x, y + 1));
+		}
+	}
+	return corners;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t gridSize = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 1024;
+	std::vector<Vertex> corners = BuildTriangleList(gridSize);
+	std::cout << corners.size() / 3 << " triangles, " << corners.size() << " corners" << std::endl;
+
+	using Clock = std::chrono::high_resolution_clock;
+
+	// the old path, count() followed by operator[]
+	std::vector<Vertex> mapVertices;
+	std::vector<uint32_t> mapIndices;
+	mapIndices.reserve(corners.size());
+	auto start = Clock::now();
+	{
+		std::unordered_map<Vertex, uint32_t> uniqueVertices;
+		for (const Vertex& vertex : corners) {
+			if (uniqueVertices.count(vertex) == 0) {
+				uniqueVertices[vertex] = static_cast<uint32_t>(mapVertices.size());
+				mapVertices.push_back(vertex);
+			}
+			mapIndices.push_back(uniqueVertices[vertex]);
+		}
+	}
+	std::chrono::duration<double, std::milli> mapTime = Clock::now() - start;
+
+	std::vector<uint32_t> welderIndices;
+	welderIndices.reserve(corners.size());
+	start = Clock::now();
+	VertexWelder welder(corners.size() / 6);
+	for (const Vertex& vertex : corners) {
+		welderIndices.push_back(welder.Weld(vertex));
+	}
+	std::chrono::duration<double, std::milli> welderTime = Clock::now() - start;
+
+	bool identical = mapIndices == welderIndices && mapVertices.size() == welder.GetVertices().size();
+	for (size_t i = 0; identical && i < mapVertices.size(); ++i) {
+		identical = mapVertices[i] == welder.GetVertices()[i];
+	}
+
+	std::cout << "unordered_map: " << mapTime.count() << " ms, " << mapVertices.size() << " unique vertices" << std::endl;
+	std::cout << "VertexWelder:  " << welderTime.count() << " ms, " << welder.GetVertices().size() << " unique vertices" << std::endl;
+	std::cout << "speedup " << mapTime.count() / welderTime.count() << "x, output "
+		<< (identical ? "identical" : "DIFFERS") << std::endl;
+	return identical ? 0 : 1;
+}
@@ -54,6 +54,8 @@ bool VulkanSystem::Initialize(WindowManager* windowManager) {
             m_CommandManager, m_ResourceManager, m_Instance);
 
         m_ResourceManager->SetCommandManager(m_CommandManager);
+        // the graph has to exist before the attachments are allocated, their memory follows its pass order
+        m_Renderer->CreateRenderGraph();
         m_CommandManager->CreateCommandPool();
         m_ResourceManager->Create(m_SwapChain, m_PipelineManager);
         m_CommandManager->CreateCommandBuffers();
@@ -188,6 +190,7 @@ VKAPI_ATTR VkBool32 VKAPI_CALL VulkanSystem::DebugCallback(
 }
 
 void VulkanSystem::Render() {
+    m_Scene->Update();
     m_Renderer->DrawFrame();
 }
 
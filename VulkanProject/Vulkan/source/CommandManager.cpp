@@ -7,11 +7,65 @@
 CommandManager::CommandManager(Device* device) :
 	m_Device(device)
 {
+    m_SecondaryPools.resize(MAX_FRAMES_IN_FLIGHT);
 }
 
 void CommandManager::CleanCommandPool()
 {
     vkDestroyCommandPool(m_Device->GetDevice(), m_CommandPool, nullptr);
+
+    for (auto& framePools : m_SecondaryPools) {
+        for (SecondaryPool& secondary : framePools) {
+            vkDestroyCommandPool(m_Device->GetDevice(), secondary.pool, nullptr);
+        }
+        framePools.clear();
+    }
+}
+
+VkCommandBuffer CommandManager::GetSecondaryCommandBuffer(uint32_t frame, uint32_t index)
+{
+    auto& framePools = m_SecondaryPools[frame];
+    while (framePools.size() <= index) {
+        // the whole pool is reset per frame, its buffer does not need an individual reset
+        SecondaryPool secondary{};
+        secondary.pool = CreateGraphicsCommandPool(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = secondary.pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(m_Device->GetDevice(), &allocInfo, &secondary.commandBuffer) != VK_SUCCESS) {
+            vkDestroyCommandPool(m_Device->GetDevice(), secondary.pool, nullptr);
+            throw std::runtime_error("failed to allocate secondary command buffer!");
+        }
+        framePools.push_back(secondary);
+    }
+    return framePools[index].commandBuffer;
+}
+
+void CommandManager::ResetSecondaryCommandPools(uint32_t frame)
+{
+    for (SecondaryPool& secondary : m_SecondaryPools[frame]) {
+        vkResetCommandPool(m_Device->GetDevice(), secondary.pool, 0);
+    }
+}
+
+VkCommandPool CommandManager::CreateGraphicsCommandPool(VkCommandPoolCreateFlags flags)
+{
+    QueueFamilyIndices queueFamilyIndices = m_Device->FindQueueFamilies(m_Device->GetPhysicalDevice());
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = flags;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+    VkCommandPool commandPool;
+    if (vkCreateCommandPool(m_Device->GetDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create command pool");
+    }
+    return commandPool;
 }
 
 void CommandManager::CleanCommandBuffers()
@@ -68,16 +122,7 @@ VkCommandBuffer CommandManager::BeginSingleTimeCommands()
 
 void CommandManager::CreateCommandPool()
 {
-    QueueFamilyIndices queueFamilyIndices = m_Device->FindQueueFamilies(m_Device->GetPhysicalDevice());
-
-    VkCommandPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-
-    if (vkCreateCommandPool(m_Device->GetDevice(), &poolInfo, nullptr, &m_CommandPool) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create command pool");
-    }
+    m_CommandPool = CreateGraphicsCommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 }
 
 void CommandManager::CreateCommandBuffers()
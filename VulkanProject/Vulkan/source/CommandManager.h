@@ -17,11 +17,25 @@ public:
     VkCommandBuffer BeginSingleTimeCommands();
 
 	std::vector<VkCommandBuffer>& GetCommandBuffers() { return m_CommandBuffers; }
+
+	// Secondary command buffers for parallel recording, each from its own pool so each one can be
+	// recorded on a different thread. A frame's pools are reset together once its fence signaled.
+	// Rendering thread only, pools are created on first use
+	VkCommandBuffer GetSecondaryCommandBuffer(uint32_t frame, uint32_t index);
+	void ResetSecondaryCommandPools(uint32_t frame);
 private:
+	VkCommandPool CreateGraphicsCommandPool(VkCommandPoolCreateFlags flags);
 
 
     VkCommandPool m_CommandPool;
     std::vector<VkCommandBuffer> m_CommandBuffers;
 
+	struct SecondaryPool {
+		VkCommandPool pool;
+		VkCommandBuffer commandBuffer;
+	};
+	// per frame in flight
+	std::vector<std::vector<SecondaryPool>> m_SecondaryPools;
+
 	Device* m_Device;
 };
\ No newline at end of file
@@ -116,6 +116,17 @@ QueueFamilyIndices Device::FindQueueFamilies(VkPhysicalDevice device)
         i++;
     }
 
+    // Prefer a pure DMA family (transfer only), otherwise any family without graphics
+    for (uint32_t family = 0; family < queueFamilyCount; ++family) {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+            continue;
+        }
+        if (!indices.transferFamily.has_value() || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+            indices.transferFamily = family;
+        }
+    }
+
     return indices;
 }
 
@@ -124,6 +135,9 @@ void Device::CreateLogicalDevice()
     QueueFamilyIndices indices = FindQueueFamilies(m_PhysicalDevice);
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    if (indices.transferFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -149,12 +163,43 @@ void Device::CreateLogicalDevice()
     vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
     vulkan12Features.descriptorBindingVariableDescriptorCount = VK_TRUE;
     vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
 
     VkPhysicalDeviceFeatures2 deviceFeatures2{};
     deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
     deviceFeatures2.pNext = &vulkan12Features;
     deviceFeatures2.features.samplerAnisotropy = VK_TRUE;
 
+    // optional, baked BC textures are only loaded when the device can sample them
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+    m_TextureCompressionBCSupported = supportedFeatures.textureCompressionBC == VK_TRUE;
+    deviceFeatures2.features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+    // optional, the GPU-driven path writes multi draw indirect commands with a non zero
+    // firstInstance and a GPU side draw count, otherwise the CPU culls and records every draw.
+    // Its depth pyramid build picks the level's storage image from an array by push constant
+    VkPhysicalDeviceVulkan13Features supportedVulkan13Features{};
+    supportedVulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
+    supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    supportedVulkan12Features.pNext = &supportedVulkan13Features;
+    VkPhysicalDeviceFeatures2 supportedFeatures2{};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &supportedVulkan12Features;
+    vkGetPhysicalDeviceFeatures2(m_PhysicalDevice, &supportedFeatures2);
+    m_DrawIndirectCountSupported = supportedVulkan12Features.drawIndirectCount == VK_TRUE &&
+        supportedFeatures.multiDrawIndirect == VK_TRUE && supportedFeatures.drawIndirectFirstInstance == VK_TRUE &&
+        supportedFeatures.shaderStorageImageArrayDynamicIndexing == VK_TRUE;
+    vulkan12Features.drawIndirectCount = m_DrawIndirectCountSupported;
+    deviceFeatures2.features.multiDrawIndirect = m_DrawIndirectCountSupported;
+    deviceFeatures2.features.drawIndirectFirstInstance = m_DrawIndirectCountSupported;
+    deviceFeatures2.features.shaderStorageImageArrayDynamicIndexing = m_DrawIndirectCountSupported;
+    // optional, lets every pipeline job skip the locking of its own pipeline cache
+    m_PipelineCreationCacheControlSupported = supportedVulkan13Features.pipelineCreationCacheControl == VK_TRUE;
+    vulkan13Features.pipelineCreationCacheControl = supportedVulkan13Features.pipelineCreationCacheControl;
+    std::cout << (m_DrawIndirectCountSupported ? "GPU-driven rendering with indirect count draws" : "No indirect count draws, culling on the CPU") << std::endl;
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pNext = &deviceFeatures2;
@@ -178,6 +223,12 @@ void Device::CreateLogicalDevice()
 
     vkGetDeviceQueue(m_Device, indices.graphicsFamily.value(), 0, &m_GraphicsQueue);
     vkGetDeviceQueue(m_Device, indices.presentFamily.value(), 0, &m_PresentQueue);
+
+    m_GraphicsQueueFamily = indices.graphicsFamily.value();
+    m_TransferQueueFamily = indices.transferFamily.value_or(m_GraphicsQueueFamily);
+    vkGetDeviceQueue(m_Device, m_TransferQueueFamily, 0, &m_TransferQueue);
+    std::cout << (HasDedicatedTransferQueue() ? "Using dedicated transfer queue family " : "No dedicated transfer queue, uploads use graphics family ")
+        << m_TransferQueueFamily << std::endl;
 }
 
 SwapChainSupportDetails Device::QuerySwapChainSupport(VkPhysicalDevice device)
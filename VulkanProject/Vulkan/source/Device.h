@@ -9,6 +9,8 @@ const int MAX_FRAMES_IN_FLIGHT = 2;
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	// only set when the device has a transfer capable family without graphics
+	std::optional<uint32_t> transferFamily;
 
 	bool IsComplete() const{
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -48,6 +50,12 @@ private:
 
 	VkQueue m_GraphicsQueue;
 	VkQueue m_PresentQueue;
+	VkQueue m_TransferQueue = VK_NULL_HANDLE;
+	uint32_t m_GraphicsQueueFamily = 0;
+	uint32_t m_TransferQueueFamily = 0;
+	bool m_TextureCompressionBCSupported = false;
+	bool m_DrawIndirectCountSupported = false;
+	bool m_PipelineCreationCacheControlSupported = false;
 public:
 
 	bool IsSynchronization2Supported() const { return m_Synchronization2Supported; }
@@ -65,4 +73,14 @@ public:
 	VkDevice GetDevice() const { return m_Device; }
 	VkQueue GetGraphicsQueue() const { return m_GraphicsQueue; }
 	VkQueue GetPresentQueue() const { return m_PresentQueue; }
+	// falls back to the graphics queue when there is no dedicated transfer family
+	VkQueue GetTransferQueue() const { return m_TransferQueue; }
+	uint32_t GetGraphicsQueueFamily() const { return m_GraphicsQueueFamily; }
+	uint32_t GetTransferQueueFamily() const { return m_TransferQueueFamily; }
+	bool HasDedicatedTransferQueue() const { return m_TransferQueueFamily != m_GraphicsQueueFamily; }
+	bool IsTextureCompressionBCSupported() const { return m_TextureCompressionBCSupported; }
+	// drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance, all enabled when supported
+	bool IsDrawIndirectCountSupported() const { return m_DrawIndirectCountSupported; }
+	// pipelineCreationCacheControl, enabled when supported, allows externally synchronized pipeline caches
+	bool IsPipelineCreationCacheControlSupported() const { return m_PipelineCreationCacheControlSupported; }
 };
\ No newline at end of file
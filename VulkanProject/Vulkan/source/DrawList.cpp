@@ -0,0 +1,74 @@
+#include "DrawList.h"
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	constexpr uint32_t DEPTH_BITS = 16;
+	constexpr uint32_t DEPTH_SHIFT = 24;
+	constexpr uint32_t MATERIAL_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+}
+
+uint64_t DrawList::MakeKey(bool index32, bool alphaMasked, uint32_t material, float distance)
+{
+	// the bits of a non negative float grow with its value, the top ones are a logarithmic bucket
+	if (!(distance > 0.0f)) {
+		distance = 0.0f;
+	}
+	uint32_t distanceBits;
+	std::memcpy(&distanceBits, &distance, sizeof(distanceBits));
+	uint64_t depthBucket = distanceBits >> (32 - DEPTH_BITS);
+
+	uint64_t key = depthBucket << DEPTH_SHIFT;
+	key |= static_cast<uint64_t>(material & ((1u << MATERIAL_BITS) - 1)) << MATERIAL_SHIFT;
+	if (alphaMasked) {
+		key |= ALPHA_MASK;
+	}
+	if (index32) {
+		key |= INDEX_TYPE_MASK;
+	}
+	return key;
+}
+
+void DrawList::Clear()
+{
+	m_Items.clear();
+	m_Keys.clear();
+}
+
+void DrawList::Add(uint64_t key, const DrawItem& item)
+{
+	if (m_Items.size() >= MAX_DRAWS) {
+		throw std::runtime_error("failed to add draw, draw list is full!");
+	}
+	m_Keys.push_back((key & ~static_cast<uint64_t>(MAX_DRAWS - 1)) | m_Items.size());
+	m_Items.push_back(item);
+}
+
+void DrawList::Sort()
+{
+	size_t count = m_Keys.size();
+	m_Scratch.resize(count);
+
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		std::array<uint32_t, 256> offsets{};
+		for (uint64_t key : m_Keys) {
+			++offsets[(key >> shift) & 0xff];
+		}
+		// one digit for all keys leaves the order as it is
+		if (offsets[(m_Keys.empty() ? 0 : m_Keys[0] >> shift) & 0xff] == count) {
+			continue;
+		}
+
+		uint32_t sum = 0;
+		for (uint32_t& offset : offsets) {
+			uint32_t digitCount = offset;
+			offset = sum;
+			sum += digitCount;
+		}
+		for (uint64_t key : m_Keys) {
+			m_Scratch[offsets[(key >> shift) & 0xff]++] = key;
+		}
+		m_Keys.swap(m_Scratch);
+	}
+}
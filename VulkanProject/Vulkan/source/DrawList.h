@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// One frame's draws of a geometry pass with a 64 bit sort key each. Sorting the keys groups the
+// draws by the state they bind, so recording only has to emit a bind where a key field changes.
+// Key, most significant first:
+//   [63]     index type, the index buffer binding (UINT16 first)
+//   [62]     alpha masked, opaque draws first so they fill the depth before the discarding ones
+//   [61:40]  material, draws sharing textures stay together
+//   [39:24]  depth bucket, front to back within a material
+//   [23:0]   draw index, unique, makes the order stable and points back at the item
+class DrawList
+{
+public:
+	struct DrawItem {
+		uint32_t mesh;
+		uint32_t lod;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	static constexpr uint64_t INDEX_TYPE_MASK = 1ull << 63;
+	static constexpr uint64_t ALPHA_MASK = 1ull << 62;
+	static constexpr uint32_t MATERIAL_BITS = 22;
+	static constexpr uint32_t DRAW_INDEX_BITS = 24;
+	static constexpr uint32_t MAX_DRAWS = 1u << DRAW_INDEX_BITS;
+
+	// distance is the nearest view distance of the draw's instances, negative counts as zero
+	static uint64_t MakeKey(bool index32, bool alphaMasked, uint32_t material, float distance);
+
+	void Clear();
+	// key from MakeKey, the draw index is filled in here. Throws past MAX_DRAWS draws
+	void Add(uint64_t key, const DrawItem& item);
+	// LSD radix sort of the keys, 8 bits per pass, passes whose digit is the same in every key are skipped
+	void Sort();
+
+	uint32_t GetCount() const { return static_cast<uint32_t>(m_Items.size()); }
+	// valid after Sort
+	const DrawItem& GetSorted(uint32_t i) const { return m_Items[m_Keys[i] & (MAX_DRAWS - 1)]; }
+	uint64_t GetSortedKey(uint32_t i) const { return m_Keys[i]; }
+
+private:
+	std::vector<DrawItem> m_Items;
+	std::vector<uint64_t> m_Keys;
+	std::vector<uint64_t> m_Scratch;
+};
@@ -0,0 +1,86 @@
+#include "FrustumCuller.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+// Gribb/Hartmann: the planes are sums and differences of the matrix rows, normalized so the
+// plane equation gives distances that compare against the sphere radius. With [0, 1] depth the
+// near plane is z >= 0, row2 on its own
+std::array<glm::vec4, 6> FrustumCuller::ExtractPlanes(const glm::mat4& m)
+{
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	std::array<glm::vec4, 6> planes = {
+		row3 + row0, row3 - row0,
+		row3 + row1, row3 - row1,
+		row2, row3 - row2
+	};
+	for (glm::vec4& plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return planes;
+}
+
+void FrustumCuller::Resize(uint32_t count)
+{
+	m_Count = count;
+	size_t paddedCount = (static_cast<size_t>(count) + 3) & ~size_t(3);
+	m_CenterX.assign(paddedCount, 0.0f);
+	m_CenterY.assign(paddedCount, 0.0f);
+	m_CenterZ.assign(paddedCount, 0.0f);
+	m_Radius.assign(paddedCount, 0.0f);
+}
+
+void FrustumCuller::SetSphere(uint32_t index, const glm::vec3& center, float radius)
+{
+	m_CenterX[index] = center.x;
+	m_CenterY[index] = center.y;
+	m_CenterZ[index] = center.z;
+	m_Radius[index] = radius;
+}
+
+void FrustumCuller::Cull(const glm::mat4& viewProjection, std::vector<uint32_t>& visible) const
+{
+	std::array<glm::vec4, 6> planes = ExtractPlanes(viewProjection);
+
+#ifdef FRUSTUM_CULLER_SSE
+	for (uint32_t first = 0; first < m_Count; first += 4) {
+		__m128 centerX = _mm_loadu_ps(&m_CenterX[first]);
+		__m128 centerY = _mm_loadu_ps(&m_CenterY[first]);
+		__m128 centerZ = _mm_loadu_ps(&m_CenterZ[first]);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_Radius[first]));
+
+		// a sphere is outside once it is completely behind any one plane
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const glm::vec4& plane : planes) {
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)), _mm_mul_ps(centerY, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 4 && first + lane < m_Count; ++lane) {
+			if (mask & (1 << lane)) {
+				visible.push_back(first + lane);
+			}
+		}
+	}
+#else
+	for (uint32_t i = 0; i < m_Count; ++i) {
+		bool inside = true;
+		for (const glm::vec4& plane : planes) {
+			inside &= plane.x * m_CenterX[i] + plane.y * m_CenterY[i] + plane.z * m_CenterZ[i] + plane.w > -m_Radius[i];
+		}
+		if (inside) {
+			visible.push_back(i);
+		}
+	}
+#endif
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// World space bounding spheres as structure of arrays, tested against the six planes of a view
+// frustum four spheres at a time (SSE, with a scalar fallback on other targets).
+class FrustumCuller
+{
+public:
+	void Resize(uint32_t count);
+	void SetSphere(uint32_t index, const glm::vec3& center, float radius);
+
+	// Appends the index of every sphere that touches the frustum of viewProjection, in ascending
+	// order. Expects a [0, 1] clip space depth, glm::perspective with GLM_FORCE_DEPTH_ZERO_TO_ONE.
+	void Cull(const glm::mat4& viewProjection, std::vector<uint32_t>& visible) const;
+
+	uint32_t GetCount() const { return m_Count; }
+
+	// normalized world space planes, inside where dot(plane.xyz, p) + plane.w > 0
+	static std::array<glm::vec4, 6> ExtractPlanes(const glm::mat4& viewProjection);
+
+private:
+	uint32_t m_Count = 0;
+	// padded to a multiple of 4 so the last group can be loaded whole
+	std::vector<float> m_CenterX;
+	std::vector<float> m_CenterY;
+	std::vector<float> m_CenterZ;
+	std::vector<float> m_Radius;
+};
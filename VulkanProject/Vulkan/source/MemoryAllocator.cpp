@@ -0,0 +1,272 @@
+#include "MemoryAllocator.h"
+#include "Device.h"
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+
+MemoryAllocator::MemoryAllocator(Device* device) :
+	m_Device(device)
+{
+	vkGetPhysicalDeviceMemoryProperties(m_Device->GetPhysicalDevice(), &m_MemoryProperties);
+
+	m_Pools.resize(m_MemoryProperties.memoryTypeCount * 2);
+	for (uint32_t i = 0; i < m_Pools.size(); ++i) {
+		m_Pools[i].memoryType = i / 2;
+	}
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+	if (m_LiveAllocationCount != 0) {
+		std::cerr << "MemoryAllocator: " << m_LiveAllocationCount << " allocations still alive at shutdown" << std::endl;
+	}
+
+	for (auto& pool : m_Pools) {
+		for (auto& block : pool.blocks) {
+			vkFreeMemory(m_Device->GetDevice(), block.memory, nullptr);
+		}
+	}
+}
+
+Allocation MemoryAllocator::AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties)
+{
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 memRequirements{};
+	memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	memRequirements.pNext = &dedicatedRequirements;
+
+	VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.buffer = buffer;
+	vkGetBufferMemoryRequirements2(m_Device->GetDevice(), &requirementsInfo, &memRequirements);
+
+	bool dedicated = dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation;
+	Allocation allocation = Allocate(memRequirements.memoryRequirements, properties, true, dedicated, buffer, VK_NULL_HANDLE);
+
+	if (vkBindBufferMemory(m_Device->GetDevice(), buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+		throw std::runtime_error("failed to bind buffer memory!");
+	}
+	return allocation;
+}
+
+Allocation MemoryAllocator::AllocateImage(VkImage image, VkMemoryPropertyFlags properties)
+{
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 memRequirements{};
+	memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	memRequirements.pNext = &dedicatedRequirements;
+
+	VkImageMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.image = image;
+	vkGetImageMemoryRequirements2(m_Device->GetDevice(), &requirementsInfo, &memRequirements);
+
+	bool dedicated = dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation;
+	Allocation allocation = Allocate(memRequirements.memoryRequirements, properties, false, dedicated, VK_NULL_HANDLE, image);
+
+	if (vkBindImageMemory(m_Device->GetDevice(), image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+		throw std::runtime_error("failed to bind image memory!");
+	}
+	return allocation;
+}
+
+Allocation MemoryAllocator::Allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties,
+	bool linear, bool dedicated, VkBuffer dedicatedBuffer, VkImage dedicatedImage)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	uint32_t memoryType = FindMemoryType(memRequirements.memoryTypeBits, properties);
+	VkDeviceSize nodeSize = std::max(memRequirements.size, memRequirements.alignment);
+
+	if (dedicated || nodeSize > BLOCK_SIZE / 2) {
+		return AllocateDedicated(memRequirements, memoryType, dedicatedBuffer, dedicatedImage);
+	}
+
+	uint32_t poolIndex = memoryType * 2 + (linear ? 0 : 1);
+	Pool& pool = m_Pools[poolIndex];
+	uint32_t order = GetOrder(nodeSize);
+	uint32_t topOrder = GetTopOrder();
+
+	for (uint32_t blockIndex = 0; blockIndex <= pool.blocks.size(); ++blockIndex) {
+		if (blockIndex == pool.blocks.size()) {
+			pool.blocks.push_back(CreateBlock(memoryType));
+		}
+		Block& block = pool.blocks[blockIndex];
+
+		uint32_t freeOrder = order;
+		while (freeOrder <= topOrder && block.freeLists[freeOrder].empty()) {
+			++freeOrder;
+		}
+		if (freeOrder > topOrder) {
+			continue;
+		}
+
+		VkDeviceSize offset = *block.freeLists[freeOrder].begin();
+		block.freeLists[freeOrder].erase(block.freeLists[freeOrder].begin());
+
+		// Split down to the requested order, the upper halves go back on the free lists
+		while (freeOrder > order) {
+			--freeOrder;
+			block.freeLists[freeOrder].insert(offset + (MIN_NODE_SIZE << freeOrder));
+		}
+
+		block.usedBytes += MIN_NODE_SIZE << order;
+		++m_LiveAllocationCount;
+
+		Allocation allocation{};
+		allocation.memory = block.memory;
+		allocation.offset = offset;
+		allocation.size = memRequirements.size;
+		allocation.mappedData = block.mappedData ? static_cast<char*>(block.mappedData) + offset : nullptr;
+		allocation.pool = poolIndex;
+		allocation.block = blockIndex;
+		allocation.order = order;
+		return allocation;
+	}
+
+	throw std::runtime_error("failed to sub-allocate memory!");
+}
+
+Allocation MemoryAllocator::AllocateDedicated(const VkMemoryRequirements& memRequirements, uint32_t memoryType,
+	VkBuffer buffer, VkImage image)
+{
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.buffer = buffer;
+	dedicatedInfo.image = image;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = &dedicatedInfo;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	Allocation allocation{};
+	if (vkAllocateMemory(m_Device->GetDevice(), &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate dedicated memory!");
+	}
+
+	allocation.size = memRequirements.size;
+	allocation.mappedData = MapIfHostVisible(allocation.memory, memoryType);
+	allocation.dedicated = true;
+
+	++m_DeviceAllocationCount;
+	++m_LiveAllocationCount;
+	return allocation;
+}
+
+void MemoryAllocator::Free(Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	if (allocation.dedicated) {
+		vkFreeMemory(m_Device->GetDevice(), allocation.memory, nullptr);
+		--m_DeviceAllocationCount;
+	}
+	else {
+		Block& block = m_Pools[allocation.pool].blocks[allocation.block];
+		uint32_t order = allocation.order;
+		VkDeviceSize offset = allocation.offset;
+		block.usedBytes -= MIN_NODE_SIZE << order;
+
+		// Merge with the buddy for as long as it is free as well
+		while (order < GetTopOrder()) {
+			VkDeviceSize buddy = offset ^ (MIN_NODE_SIZE << order);
+			auto it = block.freeLists[order].find(buddy);
+			if (it == block.freeLists[order].end()) {
+				break;
+			}
+			block.freeLists[order].erase(it);
+			offset = std::min(offset, buddy);
+			++order;
+		}
+		block.freeLists[order].insert(offset);
+	}
+
+	--m_LiveAllocationCount;
+	allocation = Allocation{};
+}
+
+void MemoryAllocator::PrintStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	uint32_t blockCount = 0;
+	VkDeviceSize usedBytes = 0;
+	for (const auto& pool : m_Pools) {
+		blockCount += static_cast<uint32_t>(pool.blocks.size());
+		for (const auto& block : pool.blocks) {
+			usedBytes += block.usedBytes;
+		}
+	}
+
+	std::cout << "MemoryAllocator: " << m_LiveAllocationCount << " allocations in " << m_DeviceAllocationCount
+		<< " vkAllocateMemory calls (" << blockCount << " blocks, " << usedBytes / (1024 * 1024)
+		<< " MB sub-allocated)" << std::endl;
+}
+
+void* MemoryAllocator::MapIfHostVisible(VkDeviceMemory memory, uint32_t memoryType)
+{
+	if (!(m_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+		return nullptr;
+	}
+
+	void* data = nullptr;
+	if (vkMapMemory(m_Device->GetDevice(), memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+		throw std::runtime_error("failed to map memory block!");
+	}
+	return data;
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+MemoryAllocator::Block MemoryAllocator::CreateBlock(uint32_t memoryType)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = BLOCK_SIZE;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	Block block{};
+	if (vkAllocateMemory(m_Device->GetDevice(), &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate memory block!");
+	}
+
+	block.mappedData = MapIfHostVisible(block.memory, memoryType);
+	block.freeLists.resize(GetTopOrder() + 1);
+	block.freeLists[GetTopOrder()].insert(0);
+
+	++m_DeviceAllocationCount;
+	return block;
+}
+
+uint32_t MemoryAllocator::GetTopOrder()
+{
+	return GetOrder(BLOCK_SIZE);
+}
+
+uint32_t MemoryAllocator::GetOrder(VkDeviceSize size)
+{
+	uint32_t order = 0;
+	while ((MIN_NODE_SIZE << order) < size) {
+		++order;
+	}
+	return order;
+}
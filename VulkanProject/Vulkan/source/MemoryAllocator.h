@@ -0,0 +1,75 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <mutex>
+#include <set>
+#include <vector>
+
+class Device;
+
+// A sub-range of a device memory block. Host visible blocks stay mapped for their whole
+// lifetime, so mappedData can be written directly (no vkMapMemory per resource).
+struct Allocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mappedData = nullptr;
+
+	uint32_t pool = 0;
+	uint32_t block = 0;
+	uint32_t order = 0;
+	bool dedicated = false;
+};
+
+// Buddy sub-allocator with one set of blocks per memory type. Buffers and optimal tiling images
+// get separate pools so bufferImageGranularity never has to be checked between neighbours.
+// Allocations above half a block, or that the driver wants dedicated, get their own vkAllocateMemory.
+class MemoryAllocator
+{
+public:
+	MemoryAllocator(Device* device);
+	~MemoryAllocator();
+
+	Allocation AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+	Allocation AllocateImage(VkImage image, VkMemoryPropertyFlags properties);
+	void Free(Allocation& allocation);
+
+	void PrintStats() const;
+
+private:
+	static constexpr VkDeviceSize BLOCK_SIZE = 64ull * 1024 * 1024;
+	static constexpr VkDeviceSize MIN_NODE_SIZE = 256;
+
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mappedData = nullptr;
+		// free node offsets per order, order 0 is MIN_NODE_SIZE and the top order is the whole block
+		std::vector<std::set<VkDeviceSize>> freeLists;
+		VkDeviceSize usedBytes = 0;
+	};
+
+	struct Pool {
+		uint32_t memoryType = 0;
+		std::vector<Block> blocks;
+	};
+
+	Allocation Allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties,
+		bool linear, bool dedicated, VkBuffer dedicatedBuffer, VkImage dedicatedImage);
+	Allocation AllocateDedicated(const VkMemoryRequirements& memRequirements, uint32_t memoryType,
+		VkBuffer buffer, VkImage image);
+	void* MapIfHostVisible(VkDeviceMemory memory, uint32_t memoryType);
+	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	Block CreateBlock(uint32_t memoryType);
+
+	static uint32_t GetTopOrder();
+	static uint32_t GetOrder(VkDeviceSize size);
+
+	VkPhysicalDeviceMemoryProperties m_MemoryProperties{};
+	// pool index = memoryType * 2 + (linear ? 0 : 1)
+	std::vector<Pool> m_Pools;
+
+	uint32_t m_DeviceAllocationCount = 0;
+	uint32_t m_LiveAllocationCount = 0;
+	mutable std::mutex m_Mutex;
+
+	Device* m_Device;
+};
@@ -0,0 +1,634 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+	// weight of normal and UV differences against the geometric error when collapses are ranked,
+	// relative to the mesh radius
+	constexpr float ATTRIBUTE_WEIGHT = 0.05f;
+
+	// Symmetric 4x4 error quadric, weight is the summed triangle area so Evaluate() is a
+	// squared distance
+	struct Quadric {
+		double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double weight = 0;
+
+		void AddPlane(const glm::vec3& normal, float distance, float area)
+		{
+			double x = normal.x, y = normal.y, z = normal.z, d = distance;
+			a00 += area * x * x; a01 += area * x * y; a02 += area * x * z;
+			a11 += area * y * y; a12 += area * y * z; a22 += area * z * z;
+			b0 += area * x * d; b1 += area * y * d; b2 += area * z * d;
+			c += area * d * d;
+			weight += area;
+		}
+
+		Quadric& operator+=(const Quadric& other)
+		{
+			a00 += other.a00; a01 += other.a01; a02 += other.a02;
+			a11 += other.a11; a12 += other.a12; a22 += other.a22;
+			b0 += other.b0; b1 += other.b1; b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+			return *this;
+		}
+
+		float Evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double error = a00 * x * x + a11 * y * y + a22 * z * z
+				+ 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2 * (b0 * x + b1 * y + b2 * z) + c;
+			return weight > 0 ? static_cast<float>(std::max(error, 0.0) / weight) : 0.0f;
+		}
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		float error;
+		float rank;
+	};
+
+	// true when moving from onto to keeps every remaining triangle around from facing the same way
+	bool KeepsOrientation(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+		const uint32_t* triangles, uint32_t triangleCount, uint32_t from, uint32_t to)
+	{
+		for (uint32_t i = 0; i < triangleCount; ++i) {
+			const uint32_t* triangle = &indices[triangles[i] * 3];
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+				continue; // collapses to a degenerate triangle and is removed
+			}
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for (int corner = 0; corner < 3; ++corner) {
+				before[corner] = vertices[triangle[corner]].pos;
+				after[corner] = triangle[corner] == from ? vertices[to].pos : before[corner];
+			}
+			glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if (glm::dot(normalBefore, normalAfter) < 0.25f * glm::length(normalBefore) * glm::length(normalAfter)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// bounding sphere and normal cone of the meshlet's triangles
+	void ComputeMeshletBounds(Meshlet& meshlet, const std::vector<Vertex>& vertices, const uint32_t* indices,
+		const uint32_t* meshletVertices)
+	{
+		glm::vec3 minimum(FLT_MAX);
+		glm::vec3 maximum(-FLT_MAX);
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+			minimum = glm::min(minimum, vertices[meshletVertices[i]].pos);
+			maximum = glm::max(maximum, vertices[meshletVertices[i]].pos);
+		}
+		meshlet.center = (minimum + maximum) * 0.5f;
+		meshlet.radius = 0.0f;
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+			meshlet.radius = std::max(meshlet.radius, glm::length(vertices[meshletVertices[i]].pos - meshlet.center));
+		}
+
+		// the axis is the average triangle normal, the cone opens wide enough to hold all of them.
+		// degenerate triangles keep a zero normal and are skipped
+		std::vector<glm::vec3> normals(meshlet.triangleCount, glm::vec3(0.0f));
+		glm::vec3 axis(0.0f);
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			if (length > 0.0f) {
+				normals[t] = normal / length;
+				axis += normals[t];
+			}
+		}
+
+		meshlet.coneApex = meshlet.center;
+		meshlet.coneAxis = glm::vec3(0.0f);
+		meshlet.coneCutoff = 1.0f;
+		float axisLength = glm::length(axis);
+		if (axisLength == 0.0f) {
+			return;
+		}
+		axis /= axisLength;
+
+		float minimumDot = 1.0f;
+		for (const glm::vec3& normal : normals) {
+			if (normal != glm::vec3(0.0f)) {
+				minimumDot = std::min(minimumDot, glm::dot(normal, axis));
+			}
+		}
+		// a cone that wide almost never culls, leave it disabled
+		if (minimumDot <= 0.1f) {
+			return;
+		}
+
+		// move the apex back along the axis until it is behind every triangle's plane
+		float maximumT = 0.0f;
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+			if (normals[t] == glm::vec3(0.0f)) {
+				continue;
+			}
+			const glm::vec3& p0 = vertices[indices[t * 3]].pos;
+			maximumT = std::max(maximumT, glm::dot(meshlet.center - p0, normals[t]) / glm::dot(axis, normals[t]));
+		}
+
+		meshlet.coneApex = meshlet.center - axis * maximumT;
+		meshlet.coneAxis = axis;
+		meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+	}
+}
+
+namespace MeshOptimizer {
+
+	VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+	{
+		VertexCacheStats stats{};
+		stats.triangles = indices.size() / 3;
+		stats.vertices = vertexCount;
+
+		// FIFO cache: a vertex is a hit while fewer than cacheSize misses happened since its own
+		std::vector<uint64_t> cachedAt(vertexCount, 0);
+		for (uint32_t index : indices) {
+			if (cachedAt[index] == 0 || stats.transformedVertices - cachedAt[index] >= cacheSize) {
+				++stats.transformedVertices;
+				cachedAt[index] = stats.transformedVertices;
+			}
+		}
+		return stats;
+	}
+
+	std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+		std::vector<uint32_t>& clusters, uint32_t cacheSize)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		clusters.clear();
+		if (triangleCount == 0) {
+			return result;
+		}
+
+		// vertex -> triangles adjacency in one flat array
+		std::vector<uint32_t> liveTriangles(vertexCount, 0);
+		for (uint32_t index : indices) {
+			++liveTriangles[index];
+		}
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v) {
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+		}
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; ++t) {
+			for (int corner = 0; corner < 3; ++corner) {
+				adjacency[fill[indices[t * 3 + corner]]++] = static_cast<uint32_t>(t);
+			}
+		}
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnds;
+		std::vector<uint32_t> candidates;
+		uint32_t timestamp = cacheSize + 1;
+		size_t cursor = 0;
+
+		// next vertex with live triangles, from the dead end stack first and then in input order
+		auto skipDeadEnd = [&]() -> int64_t {
+			while (!deadEnds.empty()) {
+				uint32_t vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[vertex] > 0) {
+					return vertex;
+				}
+			}
+			while (cursor < vertexCount) {
+				if (liveTriangles[cursor] > 0) {
+					return static_cast<int64_t>(cursor);
+				}
+				++cursor;
+			}
+			return -1;
+		};
+
+		int64_t fanning = skipDeadEnd();
+		clusters.push_back(0);
+		while (fanning >= 0) {
+			candidates.clear();
+			for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; ++a) {
+				uint32_t triangle = adjacency[a];
+				if (emitted[triangle]) {
+					continue;
+				}
+				for (int corner = 0; corner < 3; ++corner) {
+					uint32_t vertex = indices[triangle * 3 + corner];
+					result.push_back(vertex);
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					--liveTriangles[vertex];
+					if (timestamp - cacheTime[vertex] > cacheSize) {
+						cacheTime[vertex] = timestamp++;
+					}
+				}
+				emitted[triangle] = true;
+			}
+
+			// prefer the candidate that is still in the cache and can be finished before it leaves
+			int64_t next = -1;
+			int64_t bestPriority = -1;
+			for (uint32_t vertex : candidates) {
+				if (liveTriangles[vertex] == 0) {
+					continue;
+				}
+				int64_t priority = 0;
+				if (timestamp - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+					priority = timestamp - cacheTime[vertex];
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					next = vertex;
+				}
+			}
+
+			if (next == -1) {
+				next = skipDeadEnd();
+				if (next >= 0 && result.size() < indices.size()) {
+					clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+				}
+			}
+			fanning = next;
+		}
+		return result;
+	}
+
+	void SplitClusters(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters,
+		float threshold, uint32_t cacheSize)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (triangleCount == 0) {
+			return;
+		}
+		const float splitAcmr = threshold * AnalyzeVertexCache(indices, vertexCount, cacheSize).GetAcmr();
+
+		std::vector<uint32_t> split;
+		split.reserve(clusters.size());
+		// same FIFO simulation as AnalyzeVertexCache, except every cluster starts with a cold cache
+		// since the overdraw order can put any cluster in front of it
+		std::vector<uint64_t> cachedAt(vertexCount, 0);
+		uint64_t transformed = 0;
+
+		for (size_t c = 0; c < clusters.size(); ++c) {
+			uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+			split.push_back(clusters[c]);
+
+			uint64_t clusterStart = transformed;
+			uint32_t clusterTriangles = 0;
+			for (uint32_t t = clusters[c]; t < end; ++t) {
+				for (int corner = 0; corner < 3; ++corner) {
+					uint32_t index = indices[t * 3 + corner];
+					if (cachedAt[index] <= clusterStart || transformed - cachedAt[index] >= cacheSize) {
+						++transformed;
+						cachedAt[index] = transformed;
+					}
+				}
+				++clusterTriangles;
+
+				// the cluster is already as cheap as the whole list, it can end here
+				if (t + 1 < end && transformed - clusterStart <= splitAcmr * clusterTriangles) {
+					split.push_back(t + 1);
+					clusterStart = transformed;
+					clusterTriangles = 0;
+				}
+			}
+		}
+		clusters = std::move(split);
+	}
+
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (clusters.size() < 2) {
+			return;
+		}
+
+		struct Cluster {
+			uint32_t begin;
+			uint32_t end;
+			float sortKey;
+		};
+
+		// area weighted centroid and normal per cluster and for the whole mesh
+		std::vector<Cluster> sorted(clusters.size());
+		std::vector<glm::vec3> centroids(clusters.size(), glm::vec3(0.0f));
+		std::vector<glm::vec3> normals(clusters.size(), glm::vec3(0.0f));
+		glm::vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+
+		for (size_t c = 0; c < clusters.size(); ++c) {
+			sorted[c].begin = clusters[c];
+			sorted[c].end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+			float clusterArea = 0.0f;
+			for (uint32_t t = sorted[c].begin; t < sorted[c].end; ++t) {
+				const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+				const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+				const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+				glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				float area = glm::length(normal);
+				glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+
+				centroids[c] += center * area;
+				normals[c] += normal;
+				clusterArea += area;
+			}
+			meshCentroid += centroids[c];
+			meshArea += clusterArea;
+			centroids[c] = clusterArea > 0.0f ? centroids[c] / clusterArea : centroids[c];
+		}
+		meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : meshCentroid;
+
+		// clusters facing away from the mesh center are the likely occluders, draw those first
+		for (size_t c = 0; c < clusters.size(); ++c) {
+			float normalLength = glm::length(normals[c]);
+			glm::vec3 normal = normalLength > 0.0f ? normals[c] / normalLength : glm::vec3(0.0f);
+			sorted[c].sortKey = glm::dot(centroids[c] - meshCentroid, normal);
+		}
+		std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+			return a.sortKey > b.sortKey;
+		});
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		for (const Cluster& cluster : sorted) {
+			result.insert(result.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+		}
+		indices = std::move(result);
+	}
+
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		const uint32_t UNUSED = UINT32_MAX;
+		std::vector<uint32_t> remap(vertices.size(), UNUSED);
+		std::vector<Vertex> reordered;
+		reordered.reserve(vertices.size());
+
+		for (uint32_t& index : indices) {
+			if (remap[index] == UNUSED) {
+				remap[index] = static_cast<uint32_t>(reordered.size());
+				reordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		// vertices no triangle references are dropped
+		vertices = std::move(reordered);
+	}
+
+	void Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, VertexCacheStats& before, VertexCacheStats& after)
+	{
+		before = AnalyzeVertexCache(indices, vertices.size());
+
+		std::vector<uint32_t> clusters;
+		indices = OptimizeVertexCache(indices, vertices.size(), clusters);
+		SplitClusters(indices, vertices.size(), clusters);
+		OptimizeOverdraw(indices, vertices, clusters);
+		OptimizeVertexFetch(vertices, indices);
+
+		after = AnalyzeVertexCache(indices, vertices.size());
+	}
+
+	void BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets,
+		std::vector<uint32_t>& meshletVertices, std::vector<uint32_t>& meshletTriangles)
+	{
+		const uint8_t UNUSED = 0xff;
+		static_assert(MAX_MESHLET_VERTICES < 0xff, "local indices are stored in 8 bits");
+
+		// local index of every vertex in the meshlet being filled
+		std::vector<uint8_t> localIndices(vertices.size(), UNUSED);
+		Meshlet meshlet{};
+
+		auto flush = [&]() {
+			if (meshlet.triangleCount == 0) {
+				return;
+			}
+			ComputeMeshletBounds(meshlet, vertices, indices.data() + meshlet.indexOffset, meshletVertices.data() + meshlet.vertexOffset);
+			for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+				localIndices[meshletVertices[meshlet.vertexOffset + i]] = UNUSED;
+			}
+			meshlets.push_back(meshlet);
+
+			meshlet = Meshlet{};
+			meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+		};
+
+		meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			uint32_t newVertices = 0;
+			for (int corner = 0; corner < 3; ++corner) {
+				newVertices += localIndices[indices[i + corner]] == UNUSED ? 1 : 0;
+			}
+			if (meshlet.vertexCount + newVertices > MAX_MESHLET_VERTICES || meshlet.triangleCount == MAX_MESHLET_TRIANGLES) {
+				flush();
+			}
+			if (meshlet.triangleCount == 0) {
+				meshlet.indexOffset = static_cast<uint32_t>(i);
+			}
+
+			uint32_t packed = 0;
+			for (int corner = 0; corner < 3; ++corner) {
+				uint32_t vertex = indices[i + corner];
+				if (localIndices[vertex] == UNUSED) {
+					localIndices[vertex] = static_cast<uint8_t>(meshlet.vertexCount++);
+					meshletVertices.push_back(vertex);
+				}
+				packed |= uint32_t(localIndices[vertex]) << (corner * 8);
+			}
+			meshletTriangles.push_back(packed);
+			++meshlet.triangleCount;
+		}
+		flush();
+	}
+
+	std::vector<uint32_t> Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+		size_t targetIndexCount, float targetError, float& resultError)
+	{
+		std::vector<uint32_t> result = indices;
+		resultError = 0.0f;
+		const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+		// vertices sharing a position are a seam, they stay where they are
+		std::vector<bool> locked(vertexCount, false);
+		{
+			std::unordered_map<glm::vec3, uint32_t> firstAtPosition;
+			std::vector<uint32_t> positionIds(vertexCount);
+			firstAtPosition.reserve(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; ++v) {
+				auto inserted = firstAtPosition.emplace(vertices[v].pos, v);
+				positionIds[v] = inserted.first->second;
+				if (!inserted.second) {
+					locked[v] = true;
+					locked[inserted.first->second] = true;
+				}
+			}
+
+			// an edge used by a single triangle is an open border, matched by position so seams
+			// don't look like borders
+			std::unordered_map<uint64_t, uint32_t> edgeUses;
+			edgeUses.reserve(result.size());
+			auto edgeKey = [&](uint32_t a, uint32_t b) {
+				a = positionIds[a];
+				b = positionIds[b];
+				return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+			};
+			for (size_t i = 0; i + 2 < result.size(); i += 3) {
+				for (int corner = 0; corner < 3; ++corner) {
+					++edgeUses[edgeKey(result[i + corner], result[i + (corner + 1) % 3])];
+				}
+			}
+			for (size_t i = 0; i + 2 < result.size(); i += 3) {
+				for (int corner = 0; corner < 3; ++corner) {
+					uint32_t a = result[i + corner];
+					uint32_t b = result[i + (corner + 1) % 3];
+					if (edgeUses[edgeKey(a, b)] == 1) {
+						locked[a] = true;
+						locked[b] = true;
+					}
+				}
+			}
+		}
+
+		float meshRadius = 0.0f;
+		{
+			glm::vec3 minimum(FLT_MAX);
+			glm::vec3 maximum(-FLT_MAX);
+			for (const Vertex& vertex : vertices) {
+				minimum = glm::min(minimum, vertex.pos);
+				maximum = glm::max(maximum, vertex.pos);
+			}
+			meshRadius = vertices.empty() ? 0.0f : glm::length(maximum - minimum) * 0.5f;
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i + 2 < result.size(); i += 3) {
+			const glm::vec3& p0 = vertices[result[i + 0]].pos;
+			const glm::vec3& p1 = vertices[result[i + 1]].pos;
+			const glm::vec3& p2 = vertices[result[i + 2]].pos;
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			if (length == 0.0f) {
+				continue;
+			}
+			normal /= length;
+			for (int corner = 0; corner < 3; ++corner) {
+				quadrics[result[i + corner]].AddPlane(normal, -glm::dot(normal, p0), length * 0.5f);
+			}
+		}
+
+		std::vector<uint32_t> adjacencyOffsets;
+		std::vector<uint32_t> adjacency;
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<bool> touched(vertexCount);
+		std::vector<Collapse> collapses;
+
+		// Each pass ranks every edge, then collapses the cheapest ones whose neighbourhoods don't overlap
+		while (result.size() > targetIndexCount) {
+			const uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3);
+
+			adjacencyOffsets.assign(vertexCount + 1, 0);
+			for (uint32_t index : result) {
+				++adjacencyOffsets[index + 1];
+			}
+			for (uint32_t v = 0; v < vertexCount; ++v) {
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			}
+			adjacency.resize(result.size());
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t t = 0; t < triangleCount; ++t) {
+				for (int corner = 0; corner < 3; ++corner) {
+					adjacency[fill[result[t * 3 + corner]]++] = t;
+				}
+			}
+
+			collapses.clear();
+			for (uint32_t t = 0; t < triangleCount; ++t) {
+				for (int corner = 0; corner < 3; ++corner) {
+					uint32_t from = result[t * 3 + corner];
+					uint32_t to = result[t * 3 + (corner + 1) % 3];
+					if (locked[from]) {
+						continue;
+					}
+					Quadric quadric = quadrics[from];
+					quadric += quadrics[to];
+					float error = std::sqrt(quadric.Evaluate(vertices[to].pos));
+					glm::vec3 normalDelta = vertices[from].normal - vertices[to].normal;
+					glm::vec2 uvDelta = vertices[from].texCoord - vertices[to].texCoord;
+					float attributeError = glm::dot(normalDelta, normalDelta) + glm::dot(uvDelta, uvDelta);
+					collapses.push_back({ from, to, error, error + meshRadius * ATTRIBUTE_WEIGHT * attributeError });
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				return a.rank < b.rank;
+			});
+
+			// a collapse removes two triangles on a closed surface
+			size_t collapseBudget = std::max<size_t>((result.size() - targetIndexCount) / 6, 1);
+			size_t collapsed = 0;
+			for (uint32_t v = 0; v < vertexCount; ++v) {
+				remap[v] = v;
+			}
+			std::fill(touched.begin(), touched.end(), false);
+
+			for (const Collapse& collapse : collapses) {
+				if (collapsed >= collapseBudget || collapse.error > targetError) {
+					break;
+				}
+				if (touched[collapse.from] || touched[collapse.to]) {
+					continue;
+				}
+				const uint32_t* triangles = adjacency.data() + adjacencyOffsets[collapse.from];
+				uint32_t count = adjacencyOffsets[collapse.from + 1] - adjacencyOffsets[collapse.from];
+				if (!KeepsOrientation(vertices, result, triangles, count, collapse.from, collapse.to)) {
+					continue;
+				}
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to] += quadrics[collapse.from];
+				resultError = std::max(resultError, collapse.error);
+				++collapsed;
+
+				// the flip test above assumed the neighbours stay put for the rest of the pass
+				for (uint32_t i = 0; i < count; ++i) {
+					for (int corner = 0; corner < 3; ++corner) {
+						touched[result[triangles[i] * 3 + corner]] = true;
+					}
+				}
+			}
+
+			if (collapsed == 0) {
+				break;
+			}
+
+			size_t write = 0;
+			for (size_t i = 0; i + 2 < result.size(); i += 3) {
+				uint32_t a = remap[result[i + 0]];
+				uint32_t b = remap[result[i + 1]];
+				uint32_t c = remap[result[i + 2]];
+				if (a != b && b != c && a != c) {
+					result[write++] = a;
+					result[write++] = b;
+					result[write++] = c;
+				}
+			}
+			result.resize(write);
+		}
+		return result;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ResourceManager.h"
+
+// Import time reordering of a mesh's triangles and vertices, run once per mesh before the scene is
+// merged and cached:
+//   1. vertex cache order (Tipsify, Sander et al. 2007)
+//   2. overdraw order: the Tipsify clusters, split further where the vertex cache allows it, sorted
+//      so outward facing ones are drawn first
+//   3. vertex fetch order: vertices renumbered in first use order so vertex pulling reads
+//      the vertex buffer front to back
+namespace MeshOptimizer {
+
+	// post transform cache size the reordering targets and the statistics simulate (FIFO)
+	constexpr uint32_t CACHE_SIZE = 16;
+	// clusters for the overdraw order may cost at most this factor of the Tipsify order's ACMR
+	constexpr float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+	struct VertexCacheStats {
+		uint64_t transformedVertices = 0;
+		uint64_t triangles = 0;
+		uint64_t vertices = 0;
+
+		// average cache miss ratio, transformed vertices per triangle (0.5 is the ideal for grids)
+		float GetAcmr() const { return triangles ? static_cast<float>(transformedVertices) / triangles : 0.0f; }
+		// average transform to vertex ratio, 1.0 means every vertex is shaded exactly once
+		float GetAtvr() const { return vertices ? static_cast<float>(transformedVertices) / vertices : 0.0f; }
+
+		VertexCacheStats& operator+=(const VertexCacheStats& other)
+		{
+			transformedVertices += other.transformedVertices;
+			triangles += other.triangles;
+			vertices += other.vertices;
+			return *this;
+		}
+	};
+
+	VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+	// Returns the reordered indices, clusters receives the first triangle of every cluster
+	// (a new cluster starts wherever Tipsify had to jump to a dead end)
+	std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+		std::vector<uint32_t>& clusters, uint32_t cacheSize = CACHE_SIZE);
+
+	// Splits the clusters further at the triangles where the ACMR of the cluster so far is at most
+	// threshold times the ACMR of the whole index list (Sander et al. 2007, linear clustering), so
+	// the overdraw order gets more clusters to sort without undoing the vertex cache order
+	void SplitClusters(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters,
+		float threshold = OVERDRAW_ACMR_THRESHOLD, uint32_t cacheSize = CACHE_SIZE);
+
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters);
+
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// All three passes, indices are local to vertices
+	void Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, VertexCacheStats& before, VertexCacheStats& after);
+
+	// Quadric edge collapse (Garland and Heckbert 1997) that only rewrites the index list, every
+	// collapse moves a vertex onto one of its neighbours so the vertex buffer is shared with the
+	// full resolution mesh. Vertices on open borders and on attribute seams (more than one vertex
+	// at a position) never move; normal and UV differences make a collapse more expensive.
+	// Stops at targetIndexCount or when the next collapse would move the surface further than
+	// targetError, resultError receives the largest distance actually moved.
+	std::vector<uint32_t> Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+		size_t targetIndexCount, float targetError, float& resultError);
+
+	// Splits the (already optimized) triangle list into meshlets in index order, so every meshlet
+	// is also a contiguous index range. All offsets and vertex indices are local to this mesh.
+	void BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets,
+		std::vector<uint32_t>& meshletVertices, std::vector<uint32_t>& meshletTriangles);
+}
@@ -1,16 +1,23 @@
 #pragma once
 #include "PipelineManager.h"
+#include <algorithm>
 #include <array>
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include "SwapChain.h"
 #include "ResourceManager.h"
 #include "Device.h"
+#include "../../Common/ThreadPool.h"
 
 PipelineManager::PipelineManager(Device* device, ResourceManager* resourceManager, SwapChain* swapChain) : m_Device(device),
 m_ResourceManager(resourceManager),
 m_SwapChain(swapChain)
 {
+    m_PipelineCacheData = LoadPipelineCache();
+
     VkPipelineCacheCreateInfo pipelineCacheInfo{};
     pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
     pipelineCacheInfo.pNext = nullptr;
@@ -25,21 +32,37 @@ m_SwapChain(swapChain)
     CreateUniversalDescriptorSetLayout();
     CreateGBufferDescriptorSetLayout();
     CreateDepthPrepassDescriptorSetLayout();
-
-    CreateDepthPrepassPipeline();
-    CreateGBufferPipeline();
+    CreateDepthPyramidDescriptorSetLayout();
     CreateLightingDescriptorSetLayout();
-    CreateLightingPipeline();
     CreateToneMappingDescriptorSetLayout();
-    CreateToneMappingPipeline();
 
+    // Every pipeline is built on a worker thread into its own externally synchronized cache,
+    // the caches are merged into m_PipelineCache once all jobs finished (WaitForPipelines)
+    m_PipelineStart = std::chrono::high_resolution_clock::now();
+
+    SubmitPipelineJob("depth prepass", &PipelineManager::CreateDepthPrepassPipeline);
+    SubmitPipelineJob("gbuffer", &PipelineManager::CreateGBufferPipeline);
+    SubmitPipelineJob("lighting", &PipelineManager::CreateLightingPipeline);
+    SubmitPipelineJob("tonemapping", &PipelineManager::CreateToneMappingPipeline);
+    if (m_Device->IsDrawIndirectCountSupported()) {
+        SubmitPipelineJob("culling", &PipelineManager::CreateCullingPipelines);
+    }
 }
 
 PipelineManager::~PipelineManager()
 {
+    // a failed startup can get here with jobs still in flight, they must not outlive the members they write
+    for (auto& job : m_PipelineJobs) {
+        if (job.result.valid()) {
+            job.result.wait();
+        }
+        vkDestroyPipelineCache(m_Device->GetDevice(), job.cache, nullptr);
+    }
+
     vkDestroyDescriptorSetLayout(m_Device->GetDevice(), m_UniversalDescriptorSetLayout, nullptr);
     vkDestroyDescriptorSetLayout(m_Device->GetDevice(), m_GBufferDescriptorSetLayout, nullptr);
     vkDestroyDescriptorSetLayout(m_Device->GetDevice(), m_DepthPrepassDescriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_Device->GetDevice(), m_DepthPyramidDescriptorSetLayout, nullptr);
 
     SavePipelineCache();
 	vkDestroyPipelineCache(m_Device->GetDevice(), m_PipelineCache, nullptr);
@@ -59,9 +82,15 @@ PipelineManager::~PipelineManager()
     vkDestroyPipelineLayout(m_Device->GetDevice(), m_ToneMappingPipelineLayout, nullptr);
     vkDestroyDescriptorSetLayout(m_Device->GetDevice(), m_ToneMappingDescriptorSetLayout, nullptr);
 
+    vkDestroyPipeline(m_Device->GetDevice(), m_CullPipeline, nullptr);
+    vkDestroyPipeline(m_Device->GetDevice(), m_CompactPipeline, nullptr);
+    vkDestroyPipelineLayout(m_Device->GetDevice(), m_CullingPipelineLayout, nullptr);
+    vkDestroyPipeline(m_Device->GetDevice(), m_DepthPyramidPipeline, nullptr);
+    vkDestroyPipelineLayout(m_Device->GetDevice(), m_DepthPyramidPipelineLayout, nullptr);
+
 }
 
-void PipelineManager::CreateDepthPrepassPipeline()
+void PipelineManager::CreateDepthPrepassPipeline(VkPipelineCache pipelineCache)
 {
 	auto vertShaderCode = readFile("CustomShaders/depthPrepass.vert.spv");
 
@@ -130,11 +159,6 @@ void PipelineManager::CreateDepthPrepassPipeline()
 	colorBlending.attachmentCount = 0; // No color attachments in depth prepass
 	colorBlending.pAttachments = nullptr;
 
-	VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(PushConstantData);
-
 	std::vector<VkDynamicState> dynamicStates = {
 		VK_DYNAMIC_STATE_VIEWPORT,
 		VK_DYNAMIC_STATE_SCISSOR
@@ -154,8 +178,9 @@ void PipelineManager::CreateDepthPrepassPipeline()
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(depthSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = depthSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    // per mesh data comes from the mesh draw buffer, draws can be recorded without state changes
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
 	if (vkCreatePipelineLayout(m_Device->GetDevice(), &pipelineLayoutInfo, nullptr, &m_DepthPrepassPipelineLayout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create pipeline layout!");
@@ -188,7 +213,7 @@ void PipelineManager::CreateDepthPrepassPipeline()
     pipelineInfo.subpass = 0;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	if (vkCreateGraphicsPipelines(m_Device->GetDevice(), m_PipelineCache, 1, &pipelineInfo, nullptr, &m_DepthPrepassPipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(m_Device->GetDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &m_DepthPrepassPipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline");
 	}
 
@@ -196,7 +221,7 @@ void PipelineManager::CreateDepthPrepassPipeline()
 	vkDestroyShaderModule(m_Device->GetDevice(), vertShaderModule, nullptr);
 }
 
-void PipelineManager::CreateGBufferPipeline()
+void PipelineManager::CreateGBufferPipeline(VkPipelineCache pipelineCache)
 {
     auto vertShaderCode = readFile("CustomShaders/gbuffer.vert.spv");
     auto fragShaderCode = readFile("CustomShaders/gbuffer.frag.spv");
@@ -293,11 +318,6 @@ void PipelineManager::CreateGBufferPipeline()
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(PushConstantData);
-
     std::array<VkDescriptorSetLayout, 2> gbufferSetLayouts = {
     m_UniversalDescriptorSetLayout,
     m_GBufferDescriptorSetLayout
@@ -307,8 +327,8 @@ void PipelineManager::CreateGBufferPipeline()
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(gbufferSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = gbufferSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
     if (vkCreatePipelineLayout(m_Device->GetDevice(), &pipelineLayoutInfo, nullptr, &m_GBufferPipelineLayout) != VK_SUCCESS)
     {
@@ -346,7 +366,7 @@ void PipelineManager::CreateGBufferPipeline()
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(m_Device->GetDevice(), m_PipelineCache, 1, &pipelineInfo, nullptr, &m_GBufferPipeline) != VK_SUCCESS)
+    if (vkCreateGraphicsPipelines(m_Device->GetDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &m_GBufferPipeline) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create G-Buffer pipeline!");
     }
@@ -355,7 +375,7 @@ void PipelineManager::CreateGBufferPipeline()
     vkDestroyShaderModule(m_Device->GetDevice(), vertShaderModule, nullptr);
 }
 
-void PipelineManager::CreateLightingPipeline()
+void PipelineManager::CreateLightingPipeline(VkPipelineCache pipelineCache)
 {
     auto vertShaderCode = readFile("CustomShaders/lighting.vert.spv");
     auto fragShaderCode = readFile("CustomShaders/lighting.frag.spv");
@@ -481,7 +501,7 @@ void PipelineManager::CreateLightingPipeline()
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(m_Device->GetDevice(), m_PipelineCache, 1, &pipelineInfo, nullptr, &m_LightingPipeline) != VK_SUCCESS)
+    if (vkCreateGraphicsPipelines(m_Device->GetDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &m_LightingPipeline) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create Lighting pipeline!");
     }
@@ -490,7 +510,7 @@ void PipelineManager::CreateLightingPipeline()
     vkDestroyShaderModule(m_Device->GetDevice(), vertShaderModule, nullptr);
 }
 
-void PipelineManager::CreateToneMappingPipeline()
+void PipelineManager::CreateToneMappingPipeline(VkPipelineCache pipelineCache)
 {
     auto vertShaderCode = readFile("CustomShaders/tonemapping.vert.spv");
     auto fragShaderCode = readFile("CustomShaders/tonemapping.frag.spv");
@@ -618,7 +638,7 @@ void PipelineManager::CreateToneMappingPipeline()
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(m_Device->GetDevice(), m_PipelineCache, 1, &pipelineInfo, nullptr, &m_ToneMappingPipeline) != VK_SUCCESS)
+    if (vkCreateGraphicsPipelines(m_Device->GetDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &m_ToneMappingPipeline) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create ToneMapping pipeline!");
     }
@@ -627,6 +647,65 @@ void PipelineManager::CreateToneMappingPipeline()
     vkDestroyShaderModule(m_Device->GetDevice(), vertShaderModule, nullptr);
 }
 
+void PipelineManager::CreateCullingPipelines(VkPipelineCache pipelineCache)
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullPushConstants);
+
+    // the late phase of cull.comp also samples the depth pyramid in set 1
+    std::array<VkDescriptorSetLayout, 2> cullingSetLayouts = { m_UniversalDescriptorSetLayout, m_DepthPyramidDescriptorSetLayout };
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(cullingSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = cullingSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(m_Device->GetDevice(), &pipelineLayoutInfo, nullptr, &m_CullingPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling pipeline layout!");
+    }
+
+    VkPushConstantRange pyramidPushConstantRange{};
+    pyramidPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pyramidPushConstantRange.offset = 0;
+    pyramidPushConstantRange.size = sizeof(DepthPyramidPushConstants);
+
+    VkPipelineLayoutCreateInfo pyramidLayoutInfo{};
+    pyramidLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pyramidLayoutInfo.setLayoutCount = 1;
+    pyramidLayoutInfo.pSetLayouts = &m_DepthPyramidDescriptorSetLayout;
+    pyramidLayoutInfo.pushConstantRangeCount = 1;
+    pyramidLayoutInfo.pPushConstantRanges = &pyramidPushConstantRange;
+
+    if (vkCreatePipelineLayout(m_Device->GetDevice(), &pyramidLayoutInfo, nullptr, &m_DepthPyramidPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+    }
+
+    auto createComputePipeline = [&](const char* path, VkPipelineLayout layout, VkPipeline& pipeline) {
+        VkShaderModule shaderModule = CreateShaderModule(readFile(path));
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = shaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = layout;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        if (vkCreateComputePipelines(m_Device->GetDevice(), pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error(std::string("failed to create compute pipeline ") + path + "!");
+        }
+
+        vkDestroyShaderModule(m_Device->GetDevice(), shaderModule, nullptr);
+    };
+    createComputePipeline("CustomShaders/cull.comp.spv", m_CullingPipelineLayout, m_CullPipeline);
+    createComputePipeline("CustomShaders/compact.comp.spv", m_CullingPipelineLayout, m_CompactPipeline);
+    createComputePipeline("CustomShaders/depthPyramid.comp.spv", m_DepthPyramidPipelineLayout, m_DepthPyramidPipeline);
+}
+
 void PipelineManager::CreateUniversalDescriptorSetLayout()
 {
     std::vector<VkDescriptorSetLayoutBinding> universalBindings;
@@ -636,11 +715,13 @@ void PipelineManager::CreateUniversalDescriptorSetLayout()
     uboLayoutBinding.binding = 0;
     uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    // the occlusion test of cull.comp projects the bounds with the camera matrices
+    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr;
     universalBindings.push_back(uboLayoutBinding);
     universalBindingFlags.push_back(0);
 
+    // position stream
     VkDescriptorSetLayoutBinding vertexBufferLayoutBinding{};
     vertexBufferLayoutBinding.binding = 1;
     vertexBufferLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -659,6 +740,23 @@ void PipelineManager::CreateUniversalDescriptorSetLayout()
     universalBindings.push_back(materialBufferLayoutBinding);
     universalBindingFlags.push_back(0);
 
+    // texture coordinate and tangent frame streams, next to the positions at binding 1, the
+    // per instance transforms and material indices at binding 5, the culled instance list at 6 and
+    // the per mesh draw data at 7. The culling compute pass reads and writes 5 to 10, 8 and 9 are
+    // its draw counts and indirect commands, 10 the per instance visibility of the last late phase
+    for (uint32_t binding : { 3u, 4u, 5u, 6u, 7u, 8u, 9u, 10u }) {
+        VkDescriptorSetLayoutBinding streamLayoutBinding{};
+        streamLayoutBinding.binding = binding;
+        streamLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        streamLayoutBinding.descriptorCount = 1;
+        streamLayoutBinding.stageFlags = binding < 5 ? VK_SHADER_STAGE_VERTEX_BIT
+            : binding < 8 ? VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT
+            : VK_SHADER_STAGE_COMPUTE_BIT;
+        streamLayoutBinding.pImmutableSamplers = nullptr;
+        universalBindings.push_back(streamLayoutBinding);
+        universalBindingFlags.push_back(0);
+    }
+
     VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
     bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
     bindingFlagsInfo.bindingCount = static_cast<uint32_t>(universalBindings.size());
@@ -738,6 +836,48 @@ void PipelineManager::CreateDepthPrepassDescriptorSetLayout()
     }
 }
 
+void PipelineManager::CreateDepthPyramidDescriptorSetLayout()
+{
+    // depth image, the whole pyramid for texelFetch and one storage image per level
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[0].pImmutableSamplers = nullptr;
+
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].pImmutableSamplers = nullptr;
+
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[2].descriptorCount = MAX_DEPTH_PYRAMID_LEVELS;
+    bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[2].pImmutableSamplers = nullptr;
+
+    // smaller swapchains have fewer levels
+    std::array<VkDescriptorBindingFlags, 3> bindingFlags = { 0, 0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(m_Device->GetDevice(), &layoutInfo, nullptr, &m_DepthPyramidDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create depth pyramid descriptor set layout!");
+    }
+}
+
 void PipelineManager::CreateToneMappingDescriptorSetLayout()
 {
     std::array<VkDescriptorSetLayoutBinding, 1> bindings = {};
@@ -808,6 +948,106 @@ void PipelineManager::CreateLightingDescriptorSetLayout()
     }
 }
 
+void PipelineManager::SubmitPipelineJob(const char* name, void (PipelineManager::* createPipeline)(VkPipelineCache))
+{
+    VkPipelineCacheCreateInfo pipelineCacheInfo{};
+    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    // one job uses the cache, the merge in WaitForPipelines only runs after it finished
+    if (m_Device->IsPipelineCreationCacheControlSupported()) {
+        pipelineCacheInfo.flags = VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT;
+    }
+    pipelineCacheInfo.initialDataSize = m_PipelineCacheData.size();
+    pipelineCacheInfo.pInitialData = m_PipelineCacheData.empty() ? nullptr : m_PipelineCacheData.data();
+
+    PipelineJob job{};
+    job.name = name;
+    if (vkCreatePipelineCache(m_Device->GetDevice(), &pipelineCacheInfo, nullptr, &job.cache) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline cache!");
+    }
+
+    VkPipelineCache cache = job.cache;
+    job.result = ThreadPool::Instance().Submit([this, createPipeline, cache]() {
+        auto start = std::chrono::high_resolution_clock::now();
+        (this->*createPipeline)(cache);
+        std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+        return time.count();
+    });
+    m_PipelineJobs.push_back(std::move(job));
+}
+
+void PipelineManager::WaitForPipelines()
+{
+    if (m_PipelineJobs.empty()) {
+        return;
+    }
+
+    double longestJob = 0.0;
+    std::vector<VkPipelineCache> caches;
+    for (auto& job : m_PipelineJobs) {
+        double time = job.result.get();
+        longestJob = std::max(longestJob, time);
+        caches.push_back(job.cache);
+        std::cout << "  " << job.name << " pipeline: " << time << " ms" << std::endl;
+    }
+
+    if (vkMergePipelineCaches(m_Device->GetDevice(), m_PipelineCache, static_cast<uint32_t>(caches.size()), caches.data()) != VK_SUCCESS) {
+        std::cerr << "Failed to merge pipeline caches, the saved cache will be incomplete" << std::endl;
+    }
+    for (auto& job : m_PipelineJobs) {
+        vkDestroyPipelineCache(m_Device->GetDevice(), job.cache, nullptr);
+    }
+    m_PipelineJobs.clear();
+
+    std::chrono::duration<double, std::milli> pipelineTime = std::chrono::high_resolution_clock::now() - m_PipelineStart;
+    std::cout << "Pipeline build (" << (m_PipelineCacheData.empty() ? "cold" : "warm") << " cache): "
+        << pipelineTime.count() << " ms since submit, longest job " << longestJob << " ms" << std::endl;
+    m_PipelineCacheData.clear();
+}
+
+std::vector<uint8_t> PipelineManager::LoadPipelineCache()
+{
+    std::ifstream file(PIPELINE_CACHE_FILE, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "No pipeline cache found, building pipelines cold" << std::endl;
+        return {};
+    }
+
+    size_t fileSize = (size_t)file.tellg();
+    std::vector<uint8_t> cacheData(fileSize);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(cacheData.data()), fileSize);
+
+    if (!file || fileSize < sizeof(VkPipelineCacheHeaderVersionOne)) {
+        std::cerr << "Pipeline cache file is truncated, ignoring it" << std::endl;
+        return {};
+    }
+
+    // The driver is allowed to reject foreign data on its own, but some don't, so check the
+    // header before handing the blob over
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, cacheData.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_Device->GetPhysicalDevice(), &properties);
+
+    if (header.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) || header.headerSize > fileSize ||
+        header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+        std::cerr << "Pipeline cache has an unknown header, ignoring it" << std::endl;
+        return {};
+    }
+    if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID) {
+        std::cerr << "Pipeline cache was written by a different device, ignoring it" << std::endl;
+        return {};
+    }
+    if (memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        std::cerr << "Pipeline cache was written by a different driver version, ignoring it" << std::endl;
+        return {};
+    }
+
+    std::cout << "Loaded pipeline cache from " << PIPELINE_CACHE_FILE << " (" << fileSize << " bytes)" << std::endl;
+    return cacheData;
+}
+
 void PipelineManager::SavePipelineCache()
 {
     size_t cacheSize;
@@ -825,10 +1065,12 @@ void PipelineManager::SavePipelineCache()
         std::cerr << "Failed to retrieve pipeline cache data: " << result << std::endl;
         return;
     }
-    const std::string cacheFileName = "pipeline_cache_data.bin";
-    FILE* outputFile = fopen(cacheFileName.c_str(), "wb");
+
+    // Write next to the real file and rename over it, so a crash mid-write never leaves a torn cache
+    const std::string tempFileName = std::string(PIPELINE_CACHE_FILE) + ".tmp";
+    FILE* outputFile = fopen(tempFileName.c_str(), "wb");
     if (!outputFile) {
-        std::cerr << "Failed to open pipeline cache file for writing: " << cacheFileName << std::endl;
+        std::cerr << "Failed to open pipeline cache file for writing: " << tempFileName << std::endl;
         return;
     }
     size_t written = fwrite(cacheData.data(), 1, cacheSize, outputFile);
@@ -837,9 +1079,18 @@ void PipelineManager::SavePipelineCache()
 
     if (written != cacheSize) {
         std::cerr << "Failed to write complete pipeline cache. " << "Wrote " << written << " of " << cacheSize << " bytes." << std::endl;
+        std::filesystem::remove(tempFileName);
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempFileName, PIPELINE_CACHE_FILE, error);
+    if (error) {
+        std::cerr << "Failed to replace pipeline cache file: " << error.message() << std::endl;
+        std::filesystem::remove(tempFileName, error);
     }
     else {
-        std::cout << "Successfully saved pipeline cache to " << cacheFileName << " (" << cacheSize << " bytes)" << std::endl;
+        std::cout << "Successfully saved pipeline cache to " << PIPELINE_CACHE_FILE << " (" << cacheSize << " bytes)" << std::endl;
     }
 }
 
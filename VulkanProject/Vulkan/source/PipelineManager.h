@@ -1,6 +1,8 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include <chrono>
 #include <fstream>
+#include <future>
 #include <vector>
 
 struct TonemappingPushConstants {
@@ -40,44 +42,76 @@ public:
 	VkDescriptorSetLayout GetUniversalDescriptorSetLayout() const { return m_UniversalDescriptorSetLayout; }
 	VkDescriptorSetLayout GetGBufferDescriptorSetLayout() const { return m_GBufferDescriptorSetLayout; }
 	VkDescriptorSetLayout GetDepthPrepassDescriptorSetLayout() const { return m_DepthPrepassDescriptorSetLayout; }
+	VkDescriptorSetLayout GetDepthPyramidDescriptorSetLayout() const { return m_DepthPyramidDescriptorSetLayout; }
 
-	void CreateDepthPrepassPipeline();
+	void CreateDepthPrepassPipeline(VkPipelineCache pipelineCache);
 	VkPipeline GetDepthPrepassPipeline() const { return m_DepthPrepassPipeline; }
 	VkPipelineLayout GetDepthPrepassPipelineLayout() const { return m_DepthPrepassPipelineLayout; }
 
-	void CreateGBufferPipeline();
+	void CreateGBufferPipeline(VkPipelineCache pipelineCache);
 	VkPipeline GetGBufferPipeline() const { return m_GBufferPipeline; }
 	VkPipelineLayout GetGBufferPipelineLayout() const { return m_GBufferPipelineLayout; }
 
-	void CreateLightingPipeline();
+	void CreateLightingPipeline(VkPipelineCache pipelineCache);
 	VkDescriptorSetLayout& GetLightingDescriptorSetLayout() { return m_LightingDescriptorSetLayout; }
 	VkPipeline GetLightingPipeline() const { return m_LightingPipeline; }
 	VkPipelineLayout GetLightingPipelineLayout() const { return m_LightingPipelineLayout; }
 
-	void CreateToneMappingPipeline();
+	void CreateToneMappingPipeline(VkPipelineCache pipelineCache);
 	VkDescriptorSetLayout& GetToneMappingDescriptorSetLayout() { return m_ToneMappingDescriptorSetLayout; }
 	VkPipeline GetToneMappingPipeline() const { return m_ToneMappingPipeline; }
 	VkPipelineLayout GetToneMappingPipelineLayout() const { return m_ToneMappingPipelineLayout; }
 
+	// instance culling (cull.comp), draw compaction (compact.comp) and the depth pyramid build
+	// (depthPyramid.comp) of the GPU-driven path, only created when the device supports indirect
+	// count draws
+	void CreateCullingPipelines(VkPipelineCache pipelineCache);
+	VkPipeline GetCullPipeline() const { return m_CullPipeline; }
+	VkPipeline GetCompactPipeline() const { return m_CompactPipeline; }
+	VkPipelineLayout GetCullingPipelineLayout() const { return m_CullingPipelineLayout; }
+	VkPipeline GetDepthPyramidPipeline() const { return m_DepthPyramidPipeline; }
+	VkPipelineLayout GetDepthPyramidPipelineLayout() const { return m_DepthPyramidPipelineLayout; }
+
 	VkShaderModule CreateShaderModule(const std::vector<uint32_t>& code);
+
+	// Blocks until the pipeline jobs started by the constructor are done. Must be called before
+	// any Get*Pipeline handle is used.
+	void WaitForPipelines();
 private:
+	struct PipelineJob {
+		const char* name;
+		VkPipelineCache cache;
+		std::future<double> result;
+	};
+
+	void SubmitPipelineJob(const char* name, void (PipelineManager::* createPipeline)(VkPipelineCache));
+
 	//(set 0 in both pipelines)
 	void CreateUniversalDescriptorSetLayout();
 	//(set 1 in main pipeline)  
 	void CreateGBufferDescriptorSetLayout();
 	//(set 1 in depth pipeline)
 	void CreateDepthPrepassDescriptorSetLayout();
+	//(set 0 in the depth pyramid build, set 1 in the culling pipelines)
+	void CreateDepthPyramidDescriptorSetLayout();
 
 	void CreateToneMappingDescriptorSetLayout();
 
 	void CreateLightingDescriptorSetLayout();
+	std::vector<uint8_t> LoadPipelineCache();
 	void SavePipelineCache();
 
+	static constexpr const char* PIPELINE_CACHE_FILE = "pipeline_cache_data.bin";
+
 
 	VkPipelineCache m_PipelineCache;
+	std::vector<uint8_t> m_PipelineCacheData;
+	std::vector<PipelineJob> m_PipelineJobs;
+	std::chrono::high_resolution_clock::time_point m_PipelineStart;
 	VkDescriptorSetLayout m_UniversalDescriptorSetLayout;
 	VkDescriptorSetLayout m_GBufferDescriptorSetLayout;
 	VkDescriptorSetLayout m_DepthPrepassDescriptorSetLayout;
+	VkDescriptorSetLayout m_DepthPyramidDescriptorSetLayout;
 	VkPipeline m_GBufferPipeline;
 	VkPipelineLayout m_GBufferPipelineLayout;
 
@@ -92,6 +126,12 @@ private:
 	VkPipeline m_DepthPrepassPipeline;
 	VkPipelineLayout m_DepthPrepassPipelineLayout;
 
+	VkPipeline m_CullPipeline = VK_NULL_HANDLE;
+	VkPipeline m_CompactPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout m_CullingPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_DepthPyramidPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout m_DepthPyramidPipelineLayout = VK_NULL_HANDLE;
+
 	std::vector<VkDescriptorSetLayoutBinding> m_Bindings{};
 	std::vector<VkDescriptorBindingFlags> m_BindingFlags{};
 
@@ -0,0 +1,337 @@
+#include "RenderGraph.h"
+#include "ResourceManager.h"
+#include <stdexcept>
+#include <iostream>
+
+RenderGraphResource RenderGraph::ImportImage(const std::string& name, Image* image, VkPipelineStageFlags2 acquireStage)
+{
+	ResourceNode resource{};
+	resource.name = name;
+	resource.image = image;
+	resource.acquireStage = acquireStage;
+	m_Resources.push_back(resource);
+	return static_cast<RenderGraphResource>(m_Resources.size() - 1);
+}
+
+void RenderGraph::SetImage(RenderGraphResource resource, Image* image)
+{
+	m_Resources[resource].image = image;
+}
+
+void RenderGraph::ExportImage(RenderGraphResource resource, RenderGraphUsage finalUsage)
+{
+	m_Resources[resource].exported = true;
+	m_Resources[resource].finalUsage = finalUsage;
+	m_Compiled = false;
+}
+
+void RenderGraph::AddPass(const std::string& name,
+	const std::vector<std::pair<RenderGraphResource, RenderGraphUsage>>& reads,
+	const std::vector<std::pair<RenderGraphResource, RenderGraphUsage>>& writes,
+	std::function<void(VkCommandBuffer)> execute, bool sideEffects)
+{
+	PassNode pass{};
+	pass.name = name;
+	pass.reads = reads;
+	pass.writes = writes;
+	pass.execute = std::move(execute);
+	pass.sideEffects = sideEffects;
+	m_Passes.push_back(std::move(pass));
+	m_Compiled = false;
+}
+
+void RenderGraph::Compile()
+{
+	// Walk the passes backwards starting from the exported resources, a pass survives only
+	// if it writes something a later surviving pass (or the outside world) still needs
+	std::vector<bool> needed(m_Resources.size(), false);
+	for (size_t i = 0; i < m_Resources.size(); ++i) {
+		needed[i] = m_Resources[i].exported;
+	}
+
+	uint32_t culledCount = 0;
+	for (auto pass = m_Passes.rbegin(); pass != m_Passes.rend(); ++pass) {
+		bool contributes = pass->sideEffects;
+		for (const auto& [resource, usage] : pass->writes) {
+			contributes |= needed[resource];
+		}
+
+		pass->culled = !contributes;
+		if (pass->culled) {
+			std::cout << "RenderGraph: culled pass " << pass->name << std::endl;
+			++culledCount;
+			continue;
+		}
+
+		// A clearing write ends the dependency chain, a loading write keeps the previous writer alive
+		for (const auto& [resource, usage] : pass->writes) {
+			needed[resource] = !GetUsageInfo(usage).discard;
+		}
+		for (const auto& [resource, usage] : pass->reads) {
+			needed[resource] = true;
+		}
+	}
+
+	std::cout << "RenderGraph: compiled " << m_Passes.size() - culledCount << " passes ("
+		<< culledCount << " culled)" << std::endl;
+	m_Compiled = true;
+	m_LoggedStats = false;
+}
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+{
+	if (!m_Compiled) {
+		Compile();
+	}
+
+	m_LastBarrierBatchCount = 0;
+	m_LastImageBarrierCount = 0;
+
+	std::vector<bool> firstUse(m_Resources.size(), true);
+	std::vector<VkImageMemoryBarrier2> barriers;
+	barriers.reserve(m_Resources.size());
+
+	for (auto& pass : m_Passes) {
+		if (pass.culled) {
+			continue;
+		}
+
+		for (const auto& [resource, usage] : pass.reads) {
+			AppendBarrier(barriers, m_Resources[resource], GetUsageInfo(usage), firstUse[resource]);
+			firstUse[resource] = false;
+		}
+		for (const auto& [resource, usage] : pass.writes) {
+			AppendBarrier(barriers, m_Resources[resource], GetUsageInfo(usage), firstUse[resource]);
+			firstUse[resource] = false;
+		}
+		FlushBarriers(commandBuffer, barriers);
+
+		pass.execute(commandBuffer);
+	}
+
+	for (size_t i = 0; i < m_Resources.size(); ++i) {
+		if (m_Resources[i].exported) {
+			AppendBarrier(barriers, m_Resources[i], GetUsageInfo(m_Resources[i].finalUsage), firstUse[i]);
+		}
+	}
+	FlushBarriers(commandBuffer, barriers);
+
+	if (!m_LoggedStats) {
+		std::cout << "RenderGraph: " << m_LastImageBarrierCount << " image barriers in "
+			<< m_LastBarrierBatchCount << " batches per frame" << std::endl;
+		m_LoggedStats = true;
+	}
+}
+
+std::vector<RenderGraphLifetime> RenderGraph::GetTransientLifetimes()
+{
+	if (!m_Compiled) {
+		Compile();
+	}
+
+	const uint32_t unused = UINT32_MAX;
+	std::vector<RenderGraphLifetime> lifetimes(m_Resources.size(), RenderGraphLifetime{ nullptr, unused, 0 });
+	std::vector<bool> transient(m_Resources.size(), true);
+
+	uint32_t passIndex = 0;
+	for (const auto& pass : m_Passes) {
+		if (pass.culled) {
+			continue;
+		}
+
+		auto touch = [&](RenderGraphResource resource, RenderGraphUsage usage) {
+			RenderGraphLifetime& lifetime = lifetimes[resource];
+			if (lifetime.firstPass == unused) {
+				lifetime.firstPass = passIndex;
+				transient[resource] = GetUsageInfo(usage).discard;
+			}
+			lifetime.lastPass = passIndex;
+		};
+		for (const auto& [resource, usage] : pass.reads) {
+			touch(resource, usage);
+		}
+		for (const auto& [resource, usage] : pass.writes) {
+			touch(resource, usage);
+		}
+		++passIndex;
+	}
+
+	std::vector<RenderGraphLifetime> result;
+	for (size_t i = 0; i < m_Resources.size(); ++i) {
+		const ResourceNode& resource = m_Resources[i];
+		if (resource.exported || resource.acquireStage != VK_PIPELINE_STAGE_2_NONE || !transient[i]) {
+			continue;
+		}
+
+		RenderGraphLifetime lifetime = lifetimes[i];
+		lifetime.image = resource.image;
+		if (lifetime.firstPass == unused) {
+			// Only touched by culled passes, keep it alive for the whole frame so it never aliases
+			lifetime.firstPass = 0;
+			lifetime.lastPass = passIndex;
+		}
+		result.push_back(lifetime);
+	}
+	return result;
+}
+
+void RenderGraph::SetAliasDependencies(const std::vector<std::pair<Image*, Image*>>& aliases)
+{
+	for (auto& resource : m_Resources) {
+		resource.aliases.clear();
+	}
+
+	for (const auto& [earlier, later] : aliases) {
+		RenderGraphResource earlierResource = FindResource(earlier);
+		RenderGraphResource laterResource = FindResource(later);
+		m_Resources[laterResource].aliases.push_back(earlierResource);
+		// next frame the earlier image reuses the memory while the later one may still be read
+		m_Resources[earlierResource].aliases.push_back(laterResource);
+	}
+}
+
+RenderGraphResource RenderGraph::FindResource(const Image* image) const
+{
+	for (size_t i = 0; i < m_Resources.size(); ++i) {
+		if (m_Resources[i].image == image) {
+			return static_cast<RenderGraphResource>(i);
+		}
+	}
+	throw std::runtime_error("image is not imported into the render graph!");
+}
+
+RenderGraph::UsageInfo RenderGraph::GetUsageInfo(RenderGraphUsage usage)
+{
+	switch (usage) {
+	case RenderGraphUsage::ColorAttachment:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, true };
+	case RenderGraphUsage::DepthAttachment:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true };
+	case RenderGraphUsage::DepthAttachmentLoad:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, false };
+	case RenderGraphUsage::SampledFragment:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+			VK_ACCESS_2_SHADER_READ_BIT, false };
+	case RenderGraphUsage::DepthSampledFragment:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+			VK_ACCESS_2_SHADER_READ_BIT, false };
+	case RenderGraphUsage::DepthSampledCompute:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			VK_ACCESS_2_SHADER_READ_BIT, false };
+	case RenderGraphUsage::StorageCompute:
+		return { VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, true };
+	case RenderGraphUsage::Present:
+		// The present engine is synchronized by the render finished semaphore, which is signaled
+		// at color attachment output, so the transition only has to complete before that stage
+		return { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_2_NONE, false };
+	}
+	throw std::runtime_error("unknown render graph usage!");
+}
+
+bool RenderGraph::IsWriteAccess(VkAccessFlags2 access)
+{
+	const VkAccessFlags2 writeMask = VK_ACCESS_2_SHADER_WRITE_BIT |
+		VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_2_TRANSFER_WRITE_BIT |
+		VK_ACCESS_2_MEMORY_WRITE_BIT;
+	return (access & writeMask) != 0;
+}
+
+VkImageAspectFlags RenderGraph::GetAspectMask(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+void RenderGraph::AppendBarrier(std::vector<VkImageMemoryBarrier2>& barriers, ResourceNode& resource,
+	const UsageInfo& usage, bool firstUse)
+{
+	Image& image = *resource.image;
+
+	VkPipelineStageFlags2 srcStage = image.lastStage;
+	VkAccessFlags2 srcAccess = image.lastAccess;
+	if (firstUse && resource.acquireStage != VK_PIPELINE_STAGE_2_NONE) {
+		// Chain onto the semaphore wait instead of whatever happened to the image last frame
+		srcStage = resource.acquireStage;
+		srcAccess = VK_ACCESS_2_NONE;
+	}
+	if (firstUse) {
+		// The memory may still be in use by an aliased image, earlier in this frame or later in the last one
+		for (RenderGraphResource alias : resource.aliases) {
+			srcStage |= m_Resources[alias].image->lastStage;
+			srcAccess |= m_Resources[alias].image->lastAccess;
+		}
+	}
+
+	VkImageLayout oldLayout = (firstUse && usage.discard) ? VK_IMAGE_LAYOUT_UNDEFINED : image.currentLayout;
+
+	// Read after read in the same layout needs no barrier, just widen the tracked scope so the
+	// next writer waits for every reader
+	if (oldLayout == usage.layout && !IsWriteAccess(srcAccess) && !IsWriteAccess(usage.access)) {
+		image.lastStage |= usage.stage;
+		image.lastAccess |= usage.access;
+		return;
+	}
+
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = srcStage;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstStageMask = usage.stage;
+	barrier.dstAccessMask = usage.access;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = usage.layout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image.image;
+	barrier.subresourceRange.aspectMask = GetAspectMask(image.format);
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+	barriers.push_back(barrier);
+
+	image.currentLayout = usage.layout;
+	image.lastStage = usage.stage;
+	image.lastAccess = usage.access;
+}
+
+void RenderGraph::FlushBarriers(VkCommandBuffer commandBuffer, std::vector<VkImageMemoryBarrier2>& barriers)
+{
+	if (barriers.empty()) {
+		return;
+	}
+
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+	dependencyInfo.pImageMemoryBarriers = barriers.data();
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+	++m_LastBarrierBatchCount;
+	m_LastImageBarrierCount += static_cast<uint32_t>(barriers.size());
+	barriers.clear();
+}
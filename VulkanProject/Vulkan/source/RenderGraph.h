@@ -0,0 +1,107 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct Image;
+
+// How a pass touches an image. Each usage maps to a fixed layout/stage/access triple,
+// the graph derives every barrier from these instead of hand-written transitions.
+enum class RenderGraphUsage {
+	ColorAttachment,        // written as a color attachment, previous contents discarded (LOAD_OP_CLEAR)
+	DepthAttachment,        // written as a depth attachment, previous contents discarded (LOAD_OP_CLEAR)
+	DepthAttachmentLoad,    // depth tested against / written on top of existing contents (LOAD_OP_LOAD)
+	SampledFragment,        // sampled in a fragment shader
+	DepthSampledFragment,   // depth sampled read-only in a fragment shader
+	DepthSampledCompute,    // depth sampled read-only in a compute shader
+	StorageCompute,         // written and read by compute shaders in GENERAL layout, previous contents discarded
+	Present                 // handed to the presentation engine
+};
+
+using RenderGraphResource = uint32_t;
+
+// Pass interval (in compiled pass order) during which an internal image holds live data
+struct RenderGraphLifetime {
+	Image* image;
+	uint32_t firstPass;
+	uint32_t lastPass;
+};
+
+class RenderGraph
+{
+public:
+	RenderGraph() = default;
+	~RenderGraph() = default;
+
+	// acquireStage is the stage an external semaphore wait (e.g. swapchain acquire) is tied to,
+	// the first barrier on the resource each frame chains onto that stage instead of tracked state
+	RenderGraphResource ImportImage(const std::string& name, Image* image, VkPipelineStageFlags2 acquireStage = VK_PIPELINE_STAGE_2_NONE);
+	void SetImage(RenderGraphResource resource, Image* image);
+
+	// Resources that leave the graph (e.g. the swapchain image). Passes that do not contribute to an
+	// exported resource are culled at Compile().
+	void ExportImage(RenderGraphResource resource, RenderGraphUsage finalUsage);
+
+	// sideEffects keeps a pass that also writes memory the graph does not track (e.g. buffers read
+	// by a later pass) from being culled when none of its image writes are needed
+	void AddPass(const std::string& name,
+		const std::vector<std::pair<RenderGraphResource, RenderGraphUsage>>& reads,
+		const std::vector<std::pair<RenderGraphResource, RenderGraphUsage>>& writes,
+		std::function<void(VkCommandBuffer)> execute, bool sideEffects = false);
+
+	void Compile();
+	void Execute(VkCommandBuffer commandBuffer);
+
+	// Internal images whose contents never outlive the frame (first use discards, not exported),
+	// these are the candidates for memory aliasing
+	std::vector<RenderGraphLifetime> GetTransientLifetimes();
+	// (earlier, later) pairs of images sharing memory. The relation is symmetric: the first barrier
+	// on either image waits for the last use of the other, the later one's use this frame and the
+	// earlier one's from the previous frame
+	void SetAliasDependencies(const std::vector<std::pair<Image*, Image*>>& aliases);
+
+private:
+	struct UsageInfo {
+		VkImageLayout layout;
+		VkPipelineStageFlags2 stage;
+		VkAccessFlags2 access;
+		bool discard;
+	};
+
+	struct ResourceNode {
+		std::string name;
+		Image* image = nullptr;
+		VkPipelineStageFlags2 acquireStage = VK_PIPELINE_STAGE_2_NONE;
+		bool exported = false;
+		RenderGraphUsage finalUsage = RenderGraphUsage::Present;
+		std::vector<RenderGraphResource> aliases;
+	};
+
+	struct PassNode {
+		std::string name;
+		std::vector<std::pair<RenderGraphResource, RenderGraphUsage>> reads;
+		std::vector<std::pair<RenderGraphResource, RenderGraphUsage>> writes;
+		std::function<void(VkCommandBuffer)> execute;
+		bool sideEffects = false;
+		bool culled = false;
+	};
+
+	static UsageInfo GetUsageInfo(RenderGraphUsage usage);
+	static bool IsWriteAccess(VkAccessFlags2 access);
+	static VkImageAspectFlags GetAspectMask(VkFormat format);
+
+	void AppendBarrier(std::vector<VkImageMemoryBarrier2>& barriers, ResourceNode& resource,
+		const UsageInfo& usage, bool firstUse);
+	void FlushBarriers(VkCommandBuffer commandBuffer, std::vector<VkImageMemoryBarrier2>& barriers);
+
+	std::vector<ResourceNode> m_Resources;
+	std::vector<PassNode> m_Passes;
+	bool m_Compiled = false;
+
+	RenderGraphResource FindResource(const Image* image) const;
+
+	uint32_t m_LastBarrierBatchCount = 0;
+	uint32_t m_LastImageBarrierCount = 0;
+	bool m_LoggedStats = false;
+};
@@ -5,9 +5,13 @@
 #include "CommandManager.h"
 #include "ResourceManager.h"
 #include "Instance.h"
+#include "../../Common/ThreadPool.h"
 
 #include <array>
+#include <cfloat>
 #include <chrono>
+#include <cmath>
+#include <iostream>
 #include <GLFW/glfw3.h>
 #include <algorithm>
 #include "../../Window/InputManager.h"
@@ -35,6 +39,7 @@ Renderer::~Renderer()
         vkDestroyFence(m_Device->GetDevice(), m_InFlightFences[i], nullptr);
     }
 
+    delete m_RenderGraph;
 }
 
 void Renderer::UpdatePushConstants(VkCommandBuffer commandBuffer)
@@ -67,8 +72,9 @@ float Renderer::UpdateUniformBuffer(uint32_t currentImage)
         ubo.CameraManagerPosition = cameraPosition;
     }
 
+    const float fieldOfView = glm::radians(45.0f);
     ubo.proj = glm::perspective(
-        glm::radians(45.0f),
+        fieldOfView,
         m_SwapChain->GetSwapChainExtent().width / (float)m_SwapChain->GetSwapChainExtent().height,
         0.1f,
         50.0f
@@ -79,8 +85,148 @@ float Renderer::UpdateUniformBuffer(uint32_t currentImage)
 
     memcpy(m_ResourceManager->GetUniformBuffersMapped()[currentImage], &ubo, sizeof(ubo));
 
+    float pixelsPerUnit = m_SwapChain->GetSwapChainExtent().height / (2.0f * std::tan(fieldOfView * 0.5f));
+    if (m_Device->IsDrawIndirectCountSupported()) {
+        // culling and LOD selection run in RecordCulling, the CPU only hands over the camera
+        std::array<glm::vec4, 6> planes = FrustumCuller::ExtractPlanes(ubo.proj * ubo.view);
+        std::copy(planes.begin(), planes.end(), m_CullPushConstants.frustumPlanes);
+        m_CullPushConstants.cameraPosition = ubo.CameraManagerPosition;
+        m_CullPushConstants.pixelsPerUnit = pixelsPerUnit;
+        m_CullPushConstants.lodErrorPixels = LOD_ERROR_PIXELS;
+        m_CullPushConstants.instanceCount = static_cast<uint32_t>(m_ResourceManager->GetInstances().size());
+        m_CullPushConstants.meshCount = static_cast<uint32_t>(m_ResourceManager->GetMeshes().size());
+        m_CullPushConstants.phase = 0;
+        return deltaTime;
+    }
+
+    CullInstances(ubo.proj * ubo.view, deltaTime);
+    SelectMeshLods(ubo.CameraManagerPosition, pixelsPerUnit);
+    BuildDrawList();
+
     return deltaTime;
 }
+
+void Renderer::CullInstances(const glm::mat4& viewProjection, float deltaTime)
+{
+    const auto& meshes = m_ResourceManager->GetMeshes();
+    const auto& instances = m_ResourceManager->GetInstances();
+
+    // world bounds only change with the instance transforms
+    if (m_CulledInstanceVersion != m_ResourceManager->GetInstanceVersion()) {
+        m_FrustumCuller.Resize(static_cast<uint32_t>(instances.size()));
+        for (uint32_t i = 0; i < instances.size(); ++i) {
+            const MeshHandle& mesh = meshes[instances[i].meshIndex];
+            const glm::mat4& model = instances[i].model;
+            float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+            m_FrustumCuller.SetSphere(i, glm::vec3(model * glm::vec4(mesh.boundsCenter, 1.0f)), mesh.boundsRadius * scale);
+        }
+        m_CulledInstanceVersion = m_ResourceManager->GetInstanceVersion();
+    }
+
+    m_VisibleInstances.clear();
+    m_FrustumCuller.Cull(viewProjection, m_VisibleInstances);
+
+    // instances are grouped by mesh and the list is in instance order, so it is grouped as well
+    m_MeshVisibleFirst.assign(meshes.size(), 0);
+    m_MeshVisibleCount.assign(meshes.size(), 0);
+    uint32_t visibleMeshes = 0;
+    for (uint32_t i = 0; i < m_VisibleInstances.size(); ++i) {
+        uint32_t mesh = instances[m_VisibleInstances[i]].meshIndex;
+        if (m_MeshVisibleCount[mesh]++ == 0) {
+            m_MeshVisibleFirst[mesh] = i;
+            ++visibleMeshes;
+        }
+    }
+
+    m_CullingReportTime += deltaTime;
+    if (m_CullingReportTime >= 1.0f) {
+        m_CullingReportTime = 0.0f;
+        std::cout << "Frustum culling: " << instances.size() - m_VisibleInstances.size() << " of " << instances.size()
+            << " instances culled, " << visibleMeshes << " of " << meshes.size() << " meshes drawn" << std::endl;
+    }
+}
+
+void Renderer::SelectMeshLods(const glm::vec3& cameraPosition, float pixelsPerUnit)
+{
+    const auto& meshes = m_ResourceManager->GetMeshes();
+    const auto& instances = m_ResourceManager->GetInstances();
+    m_MeshLods.assign(meshes.size(), 0);
+    m_MeshDistances.assign(meshes.size(), FLT_MAX);
+
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const MeshHandle& mesh = meshes[i];
+
+        // the visible instances share one draw, so the closest one (largest scale / distance) decides
+        float projectedScale = 0.0f;
+        float& nearestDistance = m_MeshDistances[i];
+        for (uint32_t visible = 0; visible < m_MeshVisibleCount[i]; ++visible) {
+            const glm::mat4& model = instances[m_VisibleInstances[m_MeshVisibleFirst[i] + visible]].model;
+            // errors and radius are in mesh space, the largest axis scale is the conservative one
+            float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+            glm::vec3 center = glm::vec3(model * glm::vec4(mesh.boundsCenter, 1.0f));
+            float distance = glm::length(center - cameraPosition) - mesh.boundsRadius * scale;
+            nearestDistance = std::min(nearestDistance, distance);
+            if (distance <= 0.0f) {
+                projectedScale = FLT_MAX;
+                break;
+            }
+            projectedScale = std::max(projectedScale, scale / distance);
+        }
+
+        uint32_t lod = 0;
+        while (lod + 1 < mesh.lodCount && mesh.lods[lod + 1].error * projectedScale * pixelsPerUnit <= LOD_ERROR_PIXELS) {
+            ++lod;
+        }
+        m_MeshLods[i] = lod;
+    }
+}
+
+void Renderer::BuildDrawList()
+{
+    const auto& meshes = m_ResourceManager->GetMeshes();
+    const auto& instances = m_ResourceManager->GetInstances();
+    const auto& materials = m_ResourceManager->GetMaterials();
+
+    m_DrawList.Clear();
+    for (uint32_t i = 0; i < meshes.size(); ++i) {
+        const MeshHandle& mesh = meshes[i];
+        if (m_MeshVisibleCount[i] == 0) {
+            continue;
+        }
+
+        // one material per imported mesh, so any instance's is the mesh's
+        uint32_t material = instances[mesh.firstInstance].materialIndex;
+        bool alphaMasked = material < materials.size() && materials[material].hasAlphaMask != 0;
+        uint64_t key = DrawList::MakeKey(mesh.indexType == VK_INDEX_TYPE_UINT32, alphaMasked, material, m_MeshDistances[i]);
+
+        DrawList::DrawItem item{};
+        item.mesh = i;
+        item.lod = m_MeshLods[i];
+        item.firstInstance = m_MeshVisibleFirst[i];
+        item.instanceCount = m_MeshVisibleCount[i];
+        m_DrawList.Add(key, item);
+    }
+    m_DrawList.Sort();
+}
+
+void Renderer::BindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline)
+{
+    vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+    ++m_BindCounts.pipelines;
+}
+
+void Renderer::BindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+    uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* descriptorSets)
+{
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, firstSet, setCount, descriptorSets, 0, nullptr);
+    m_BindCounts.descriptorSets += setCount;
+}
+
+void Renderer::BindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType)
+{
+    vkCmdBindIndexBuffer(commandBuffer, m_ResourceManager->GetIndexBuffer(indexType), 0, indexType);
+    ++m_BindCounts.indexBuffers;
+}
 void Renderer::DrawFrame()
 {
 
@@ -97,9 +243,16 @@ void Renderer::DrawFrame()
     }
 
     vkResetFences(m_Device->GetDevice(), 1, &m_InFlightFences[m_CurrentFrame]);
+    m_CommandManager->ResetSecondaryCommandPools(m_CurrentFrame);
+    // this frame's descriptor sets are idle now, textures that became resident get swapped in here
+    m_ResourceManager->UpdateTextureStreaming(m_CurrentFrame);
     vkResetCommandBuffer(m_CommandManager->GetCommandBuffers()[m_CurrentFrame], 0);
 
     float deltaTime = UpdateUniformBuffer(m_CurrentFrame);
+    m_ResourceManager->UpdateInstanceBuffer(m_CurrentFrame);
+    if (!m_Device->IsDrawIndirectCountSupported()) {
+        m_ResourceManager->UpdateVisibleInstanceBuffer(m_CurrentFrame, m_VisibleInstances);
+    }
 
     RecordDeferredCommandBuffer(m_CommandManager->GetCommandBuffers()[m_CurrentFrame], imageIndex, deltaTime);
 
@@ -108,12 +261,19 @@ void Renderer::DrawFrame()
 	cmdBufferSubmitInfo.commandBuffer = m_CommandManager->GetCommandBuffers()[m_CurrentFrame];
 	cmdBufferSubmitInfo.deviceMask = 0;
 
-	VkSemaphoreSubmitInfo waitSemaphoreSubmitInfo{};
-	waitSemaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-	waitSemaphoreSubmitInfo.semaphore = m_ImageAvailableSemaphores[m_CurrentFrame];
-	waitSemaphoreSubmitInfo.stageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	waitSemaphoreSubmitInfo.deviceIndex = 0;
-	waitSemaphoreSubmitInfo.value = 0;
+	VkSemaphoreSubmitInfo waitSemaphoreSubmitInfos[2]{};
+	waitSemaphoreSubmitInfos[0].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	waitSemaphoreSubmitInfos[0].semaphore = m_ImageAvailableSemaphores[m_CurrentFrame];
+	waitSemaphoreSubmitInfos[0].stageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	waitSemaphoreSubmitInfos[0].deviceIndex = 0;
+	waitSemaphoreSubmitInfos[0].value = 0;
+
+	// geometry and placeholder textures, the first frames wait for them on the GPU instead of the CPU
+	waitSemaphoreSubmitInfos[1].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	waitSemaphoreSubmitInfos[1].semaphore = m_ResourceManager->GetUploadTimeline();
+	waitSemaphoreSubmitInfos[1].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	waitSemaphoreSubmitInfos[1].deviceIndex = 0;
+	waitSemaphoreSubmitInfos[1].value = m_ResourceManager->GetRequiredUploadValue();
 
 	VkSemaphoreSubmitInfo signalSemaphoreSubmitInfo{};
 	signalSemaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
@@ -125,8 +285,8 @@ void Renderer::DrawFrame()
 	VkSubmitInfo2 submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
     submitInfo.flags = 0;
-	submitInfo.waitSemaphoreInfoCount = 1;
-	submitInfo.pWaitSemaphoreInfos = &waitSemaphoreSubmitInfo;
+	submitInfo.waitSemaphoreInfoCount = 2;
+	submitInfo.pWaitSemaphoreInfos = waitSemaphoreSubmitInfos;
 	submitInfo.commandBufferInfoCount = 1;
 	submitInfo.pCommandBufferInfos = &cmdBufferSubmitInfo;
 	submitInfo.signalSemaphoreInfoCount = 1;
@@ -204,7 +364,7 @@ void Renderer::RecreateSwapChain()
 
 }
 
-void Renderer::RenderDepthPrepass(VkCommandBuffer commandBuffer)
+void Renderer::RenderDepthPrepass(VkCommandBuffer commandBuffer, uint32_t phase)
 {
 
     // Depth-only attachment
@@ -213,70 +373,28 @@ void Renderer::RenderDepthPrepass(VkCommandBuffer commandBuffer)
     depthAttachment.imageView = m_ResourceManager->GetDepthImageView();
     depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.loadOp = phase == 0 ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 
+    // only the CPU path records chunks, it has no late phase
+    bool secondaries = WaitParallelRecording(GEOMETRY_PASS_DEPTH_PREPASS);
+
     VkRenderingInfo renderInfo{};
     renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderInfo.flags = secondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
     renderInfo.renderArea = { {0, 0}, m_SwapChain->GetSwapChainExtent() };
     renderInfo.layerCount = 1;
     renderInfo.pDepthAttachment = &depthAttachment;
 
     vkCmdBeginRendering(commandBuffer, &renderInfo);
 
-    // Set viewport and scissor
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(m_SwapChain->GetSwapChainExtent().width);
-    viewport.height = static_cast<float>(m_SwapChain->GetSwapChainExtent().height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = m_SwapChain->GetSwapChainExtent();
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-    // Bind depth prepass pipeline
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        m_PipelineManager->GetDepthPrepassPipeline());
-
-    // Draw all objects
-    vkCmdBindIndexBuffer(commandBuffer, m_ResourceManager->GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-
-    const auto& meshes = m_ResourceManager->GetMeshes();
-    const auto& pushConstants = m_ResourceManager->GetPushConstants();
-
-    for (size_t i = 0; i < meshes.size(); ++i) {
-        const auto& mesh = meshes[i];
-
-        if (i < pushConstants.size()) {
-            vkCmdPushConstants(
-                commandBuffer,
-                m_PipelineManager->GetDepthPrepassPipelineLayout(),
-                VK_SHADER_STAGE_VERTEX_BIT,
-                0,
-                sizeof(PushConstantData),
-                &pushConstants[i]
-            );
-        }
-
-        auto universalDescriptors = m_ResourceManager->GetUniversalDescriptorSet(m_CurrentFrame);
-        auto depthDescriptors = m_ResourceManager->GetDepthPrepassDescriptorSet(m_CurrentFrame);
-
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-            m_PipelineManager->GetDepthPrepassPipelineLayout(), 0, 1,
-            &universalDescriptors, 0, nullptr);
-
-        if (m_ResourceManager->HasAlphaTextures()) {
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                m_PipelineManager->GetDepthPrepassPipelineLayout(), 1, 1,
-                &depthDescriptors, 0, nullptr);
-        }
-
-        vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+    if (secondaries) {
+        const auto& chunks = m_ParallelRecordings[GEOMETRY_PASS_DEPTH_PREPASS].commandBuffers;
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(chunks.size()), chunks.data());
+    }
+    else {
+        RecordGeometryPassState(commandBuffer, GEOMETRY_PASS_DEPTH_PREPASS);
+        RecordMeshDraws(commandBuffer, phase);
     }
 
     vkCmdEndRendering(commandBuffer);
@@ -307,17 +425,89 @@ void Renderer::RenderGBufferPass(VkCommandBuffer commandBuffer)
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 
+    bool secondaries = WaitParallelRecording(GEOMETRY_PASS_GBUFFER);
+
     VkRenderingInfo renderInfo{};
     renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderInfo.flags = secondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
     renderInfo.renderArea = { {0,0},m_SwapChain->GetSwapChainExtent() };
     renderInfo.layerCount = 1;
-    renderInfo.colorAttachmentCount = 2;
     renderInfo.colorAttachmentCount = colorAttachments.size();
     renderInfo.pColorAttachments = colorAttachments.data();
     renderInfo.pDepthAttachment = &depthAttachment;
 
     vkCmdBeginRendering(commandBuffer, &renderInfo);
 
+    if (secondaries) {
+        const auto& chunks = m_ParallelRecordings[GEOMETRY_PASS_GBUFFER].commandBuffers;
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(chunks.size()), chunks.data());
+    }
+    else {
+        RecordGeometryPassState(commandBuffer, GEOMETRY_PASS_GBUFFER);
+        // the depth is final after both depth prepasses, so both phases are drawn with depth EQUAL
+        RecordMeshDraws(commandBuffer, 0);
+        if (m_Device->IsDrawIndirectCountSupported()) {
+            RecordMeshDraws(commandBuffer, 1);
+        }
+    }
+
+    vkCmdEndRendering(commandBuffer);
+
+}
+
+void Renderer::RecordMeshDraws(VkCommandBuffer commandBuffer, uint32_t phase)
+{
+    if (m_Device->IsDrawIndirectCountSupported()) {
+        // RecordCulling wrote the phase's commands and their counts, one indirect count draw per index type
+        VkBuffer drawCommandBuffer = m_ResourceManager->GetDrawCommandBuffer(m_CurrentFrame);
+        VkBuffer drawCountBuffer = m_ResourceManager->GetDrawCountBuffer(m_CurrentFrame);
+        uint32_t maxDrawCount = m_ResourceManager->GetMaxDrawCount();
+        uint32_t countOffset = phase * (DRAW_COUNT_HEADER + maxDrawCount);
+        const VkIndexType indexTypes[] = { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 };
+        for (uint32_t i = 0; i < 2; ++i) {
+            VkBuffer indexBuffer = m_ResourceManager->GetIndexBuffer(indexTypes[i]);
+            if (indexBuffer == VK_NULL_HANDLE) {
+                continue;
+            }
+            BindIndexBuffer(commandBuffer, indexTypes[i]);
+            vkCmdDrawIndexedIndirectCount(commandBuffer,
+                drawCommandBuffer, sizeof(VkDrawIndexedIndirectCommand) * maxDrawCount * (phase * 2 + i),
+                drawCountBuffer, sizeof(uint32_t) * (countOffset + i),
+                maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+            ++m_BindCounts.draws;
+        }
+        return;
+    }
+
+    RecordDrawRange(commandBuffer, 0, m_DrawList.GetCount());
+}
+
+void Renderer::RecordDrawRange(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t endDraw)
+{
+    // sorted by BuildDrawList, the index buffer is only bound where the key's index type changes.
+    // Pipeline and sets are per pass and materials are bindless, so nothing else changes per draw
+    const auto& meshes = m_ResourceManager->GetMeshes();
+    uint64_t boundIndexType = ~0ull;
+
+    for (uint32_t i = firstDraw; i < endDraw; ++i) {
+        const DrawList::DrawItem& draw = m_DrawList.GetSorted(i);
+        const MeshHandle& mesh = meshes[draw.mesh];
+
+        uint64_t indexType = m_DrawList.GetSortedKey(i) & DrawList::INDEX_TYPE_MASK;
+        if (indexType != boundIndexType) {
+            BindIndexBuffer(commandBuffer, mesh.indexType);
+            boundIndexType = indexType;
+        }
+
+        // indices are local to the mesh, vertexOffset makes gl_VertexIndex global for vertex pulling
+        const MeshLod& lod = mesh.lods[draw.lod];
+        vkCmdDrawIndexed(commandBuffer, lod.indexCount, draw.instanceCount, lod.indexOffset, static_cast<int32_t>(mesh.vertexOffset), draw.firstInstance);
+        ++m_BindCounts.draws;
+    }
+}
+
+void Renderer::RecordGeometryPassState(VkCommandBuffer commandBuffer, GeometryPass pass)
+{
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
@@ -332,45 +522,259 @@ void Renderer::RenderGBufferPass(VkCommandBuffer commandBuffer)
     scissor.extent = m_SwapChain->GetSwapChainExtent();
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+    auto universalDescriptors = m_ResourceManager->GetUniversalDescriptorSet(m_CurrentFrame);
+
+    if (pass == GEOMETRY_PASS_DEPTH_PREPASS) {
+        BindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_PipelineManager->GetDepthPrepassPipeline());
+
+        auto depthDescriptors = m_ResourceManager->GetDepthPrepassDescriptorSet(m_CurrentFrame);
+
+        BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_PipelineManager->GetDepthPrepassPipelineLayout(), 0, 1,
+            &universalDescriptors);
+
+        if (m_ResourceManager->HasAlphaTextures()) {
+            BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                m_PipelineManager->GetDepthPrepassPipelineLayout(), 1, 1,
+                &depthDescriptors);
+        }
+        return;
+    }
+
+    BindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
         m_PipelineManager->GetGBufferPipeline());
 
-    vkCmdBindIndexBuffer(commandBuffer, m_ResourceManager->GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    auto gBufferDescriptors = m_ResourceManager->GetGBufferDescriptorSet(m_CurrentFrame);
 
-    const auto& meshes = m_ResourceManager->GetMeshes();
-    const auto& pushConstants = m_ResourceManager->GetPushConstants();
+    BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        m_PipelineManager->GetGBufferPipelineLayout(), 0, 1,
+        &universalDescriptors);
 
-    for (size_t i = 0; i < meshes.size(); ++i) {
-        const auto& mesh = meshes[i];
-
-        if (i < pushConstants.size()) {
-            vkCmdPushConstants(
-                commandBuffer,
-                m_PipelineManager->GetGBufferPipelineLayout(),
-                VK_SHADER_STAGE_VERTEX_BIT,
-                0,
-                sizeof(PushConstantData),
-                &pushConstants[i]
-            );
+    // Bind GBuffer-specific descriptor set (Set 1)
+    BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        m_PipelineManager->GetGBufferPipelineLayout(), 1, 1,
+        &gBufferDescriptors);
+}
+
+void Renderer::StartParallelRecording()
+{
+    for (ParallelRecording& recording : m_ParallelRecordings) {
+        recording.commandBuffers.clear();
+    }
+
+    // the GPU-driven path has a handful of indirect draws, nothing to split
+    uint32_t drawCount = m_DrawList.GetCount();
+    if (m_Device->IsDrawIndirectCountSupported() || drawCount < 2 * MIN_DRAWS_PER_RECORDING_CHUNK) {
+        return;
+    }
+
+    // both passes' chunks are in flight at once, so each pass gets about half of the workers
+    uint32_t threadCount = std::max(1u, ThreadPool::Instance().GetThreadCount() / GEOMETRY_PASS_COUNT);
+    uint32_t chunkCount = std::min(threadCount, drawCount / MIN_DRAWS_PER_RECORDING_CHUNK);
+    uint32_t secondaryIndex = 0;
+
+    for (uint32_t pass = 0; pass < GEOMETRY_PASS_COUNT; ++pass) {
+        ParallelRecording& recording = m_ParallelRecordings[pass];
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+            uint32_t firstDraw = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * chunk / chunkCount);
+            uint32_t endDraw = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * (chunk + 1) / chunkCount);
+            // every buffer comes from its own pool, so the jobs never share one
+            VkCommandBuffer commandBuffer = m_CommandManager->GetSecondaryCommandBuffer(m_CurrentFrame, secondaryIndex++);
+            recording.commandBuffers.push_back(commandBuffer);
+            // high priority, the frame waits on these and must not queue behind streaming texture decodes
+            recording.jobs.push_back(ThreadPool::Instance().Submit([this, pass, commandBuffer, firstDraw, endDraw]() {
+                RecordDrawChunk(static_cast<GeometryPass>(pass), commandBuffer, firstDraw, endDraw);
+            }, ThreadPool::Priority::High));
         }
+    }
+}
 
-        auto universalDescriptors = m_ResourceManager->GetUniversalDescriptorSet(m_CurrentFrame);
-        auto gBufferDescriptors = m_ResourceManager->GetGBufferDescriptorSet(m_CurrentFrame);
+bool Renderer::WaitParallelRecording(GeometryPass pass)
+{
+    ParallelRecording& recording = m_ParallelRecordings[pass];
+    // every job has to be done with its buffer before an error leaves the frame
+    for (std::future<void>& job : recording.jobs) {
+        job.wait();
+    }
+    std::vector<std::future<void>> jobs = std::move(recording.jobs);
+    recording.jobs.clear();
+    for (std::future<void>& job : jobs) {
+        job.get();
+    }
+    return !recording.commandBuffers.empty();
+}
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-            m_PipelineManager->GetGBufferPipelineLayout(), 0, 1,
-            &universalDescriptors, 0, nullptr);
+void Renderer::RecordDrawChunk(GeometryPass pass, VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t endDraw)
+{
+    // attachment formats of the pass's vkCmdBeginRendering
+    std::array<VkFormat, 3> colorFormats = {
+        m_ResourceManager->GetGBuffer().albedo.format,
+        m_ResourceManager->GetGBuffer().normal.format,
+        m_ResourceManager->GetGBuffer().pbr.format
+    };
+
+    VkCommandBufferInheritanceRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    renderingInfo.colorAttachmentCount = pass == GEOMETRY_PASS_GBUFFER ? static_cast<uint32_t>(colorFormats.size()) : 0;
+    renderingInfo.pColorAttachmentFormats = pass == GEOMETRY_PASS_GBUFFER ? colorFormats.data() : nullptr;
+    renderingInfo.depthAttachmentFormat = m_ResourceManager->GetDepthImage().format;
+    renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+    renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.pNext = &renderingInfo;
 
-        // Bind GBuffer-specific descriptor set (Set 1)
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-            m_PipelineManager->GetGBufferPipelineLayout(), 1, 1,
-            &gBufferDescriptors, 0, nullptr);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-        vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, mesh.indexOffset, 0, 0);
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording secondary command buffer!");
     }
 
-    vkCmdEndRendering(commandBuffer);
+    RecordGeometryPassState(commandBuffer, pass);
+    RecordDrawRange(commandBuffer, firstDraw, endDraw);
 
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record secondary command buffer!");
+    }
+}
+
+void Renderer::RecordCulling(VkCommandBuffer commandBuffer, uint32_t phase)
+{
+    VkBuffer drawCountBuffer = m_ResourceManager->GetDrawCountBuffer(m_CurrentFrame);
+    VkBuffer drawCommandBuffer = m_ResourceManager->GetDrawCommandBuffer(m_CurrentFrame);
+    VkBuffer visibleInstanceBuffer = m_ResourceManager->GetVisibleInstanceBuffer(m_CurrentFrame);
+
+    // buffers are not tracked by the render graph, these barriers are all the culling needs
+    auto bufferBarrier = [](VkBuffer buffer, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+                            VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+        VkBufferMemoryBarrier2 barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+        barrier.srcStageMask = srcStage;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = dstStage;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        return barrier;
+    };
+    auto pipelineBarrier = [commandBuffer](const VkBufferMemoryBarrier2* barriers, uint32_t count) {
+        VkDependencyInfo dependencyInfo{};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependencyInfo.bufferMemoryBarrierCount = count;
+        dependencyInfo.pBufferMemoryBarriers = barriers;
+        vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+    };
+
+    if (phase == 0) {
+        // both phases' counts at once, the late phase only starts after the early one's barriers
+        vkCmdFillBuffer(commandBuffer, drawCountBuffer, 0, VK_WHOLE_SIZE, 0);
+        std::array<VkBufferMemoryBarrier2, 2> clearBarriers = {
+            bufferBarrier(drawCountBuffer,
+                VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT),
+            // written by the previous frame's late phase
+            bufferBarrier(m_ResourceManager->GetInstanceVisibilityBuffer(),
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT)
+        };
+        pipelineBarrier(clearBarriers.data(), static_cast<uint32_t>(clearBarriers.size()));
+    }
+
+    // both passes share the layout, so the sets and push constants stay bound across the pipelines
+    std::array<VkDescriptorSet, 2> cullingDescriptors = {
+        m_ResourceManager->GetUniversalDescriptorSet(m_CurrentFrame),
+        m_ResourceManager->GetDepthPyramidDescriptorSet()
+    };
+    BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        m_PipelineManager->GetCullingPipelineLayout(), 0, static_cast<uint32_t>(cullingDescriptors.size()),
+        cullingDescriptors.data());
+    CullPushConstants pushConstants = m_CullPushConstants;
+    pushConstants.phase = phase;
+    vkCmdPushConstants(commandBuffer, m_PipelineManager->GetCullingPipelineLayout(),
+        VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+
+    BindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineManager->GetCullPipeline());
+    vkCmdDispatch(commandBuffer, (m_CullPushConstants.instanceCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+    VkBufferMemoryBarrier2 countBarrier = bufferBarrier(drawCountBuffer,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    pipelineBarrier(&countBarrier, 1);
+
+    BindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineManager->GetCompactPipeline());
+    vkCmdDispatch(commandBuffer, (m_ResourceManager->GetMaxDrawCount() + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+    std::array<VkBufferMemoryBarrier2, 3> drawBarriers = {
+        bufferBarrier(drawCountBuffer,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT),
+        bufferBarrier(drawCommandBuffer,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT),
+        bufferBarrier(visibleInstanceBuffer,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT)
+    };
+    pipelineBarrier(drawBarriers.data(), static_cast<uint32_t>(drawBarriers.size()));
+}
+
+void Renderer::RenderOcclusionCulling(VkCommandBuffer commandBuffer)
+{
+    Image& depthPyramid = m_ResourceManager->GetDepthPyramid();
+    VkDescriptorSet pyramidDescriptors = m_ResourceManager->GetDepthPyramidDescriptorSet();
+
+    BindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineManager->GetDepthPyramidPipeline());
+    BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        m_PipelineManager->GetDepthPyramidPipelineLayout(), 0, 1,
+        &pyramidDescriptors);
+
+    for (uint32_t level = 0; level < depthPyramid.mipLevels; ++level) {
+        DepthPyramidPushConstants pushConstants{};
+        pushConstants.level = level;
+        vkCmdPushConstants(commandBuffer, m_PipelineManager->GetDepthPyramidPipelineLayout(),
+            VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidPushConstants), &pushConstants);
+
+        uint32_t width = std::max(1u, depthPyramid.extent.width >> level);
+        uint32_t height = std::max(1u, depthPyramid.extent.height >> level);
+        vkCmdDispatch(commandBuffer,
+            (width + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE,
+            (height + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE, 1);
+
+        // the next level and the late culling phase read this one, the render graph already put
+        // the whole pyramid in GENERAL
+        VkImageMemoryBarrier2 barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = depthPyramid.image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = level;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        VkDependencyInfo dependencyInfo{};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependencyInfo.imageMemoryBarrierCount = 1;
+        dependencyInfo.pImageMemoryBarriers = &barrier;
+        vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+    }
+
+    RecordCulling(commandBuffer, 1);
 }
 
 void Renderer::RenderLightingPass(VkCommandBuffer commandBuffer)
@@ -409,12 +813,13 @@ void Renderer::RenderLightingPass(VkCommandBuffer commandBuffer)
     scissor.extent = m_SwapChain->GetSwapChainExtent();
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineManager->GetLightingPipeline());
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+    BindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineManager->GetLightingPipeline());
+    BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
         m_PipelineManager->GetLightingPipelineLayout(), 0, 1,
-        &m_ResourceManager->GetLightingDescriptorSet(), 0, nullptr);
+        &m_ResourceManager->GetLightingDescriptorSet());
 
     vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    ++m_BindCounts.draws;
 
     vkCmdEndRendering(commandBuffer);
 }
@@ -467,16 +872,76 @@ void Renderer::RenderToneMapping(VkCommandBuffer commandBuffer, uint32_t imageIn
         sizeof(TonemappingPushConstants),
         &pushConstants);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineManager->GetToneMappingPipeline());
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+    BindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineManager->GetToneMappingPipeline());
+    BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
         m_PipelineManager->GetToneMappingPipelineLayout(), 0, 1,
-        &m_ResourceManager->GetToneMappingDescriptorSet(), 0, nullptr);
+        &m_ResourceManager->GetToneMappingDescriptorSet());
 
     vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    ++m_BindCounts.draws;
 
     vkCmdEndRendering(commandBuffer);
 }
 
+void Renderer::CreateRenderGraph()
+{
+    m_RenderGraph = new RenderGraph();
+
+    RenderGraphResource depth = m_RenderGraph->ImportImage("depth", &m_ResourceManager->GetDepthImage());
+    RenderGraphResource albedo = m_RenderGraph->ImportImage("albedo", &m_ResourceManager->GetGBuffer().albedo);
+    RenderGraphResource normal = m_RenderGraph->ImportImage("normal", &m_ResourceManager->GetGBuffer().normal);
+    RenderGraphResource pbr = m_RenderGraph->ImportImage("pbr", &m_ResourceManager->GetGBuffer().pbr);
+    RenderGraphResource hdr = m_RenderGraph->ImportImage("hdr", &m_ResourceManager->GetHdrBuffer().image);
+    // The swapchain image changes every frame, it is rebound in RecordDeferredCommandBuffer
+    m_SwapChainResource = m_RenderGraph->ImportImage("swapchain", m_SwapChain->GetSwapChainImages()[0],
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    m_RenderGraph->AddPass("depth prepass", {},
+        { { depth, RenderGraphUsage::DepthAttachment } },
+        [this](VkCommandBuffer commandBuffer) { RenderDepthPrepass(commandBuffer, 0); });
+
+    if (m_Device->IsDrawIndirectCountSupported()) {
+        // Two phase occlusion culling: the depth prepass above drew last frame's visible instances,
+        // the rest is tested against the pyramid of that depth and drawn on top of it
+        RenderGraphResource depthPyramid = m_RenderGraph->ImportImage("depth pyramid", &m_ResourceManager->GetDepthPyramid());
+
+        // nothing reads the pyramid after the pass, it is kept for the late draws it writes
+        m_RenderGraph->AddPass("occlusion culling",
+            { { depth, RenderGraphUsage::DepthSampledCompute } },
+            { { depthPyramid, RenderGraphUsage::StorageCompute } },
+            [this](VkCommandBuffer commandBuffer) { RenderOcclusionCulling(commandBuffer); }, true);
+
+        m_RenderGraph->AddPass("late depth prepass", {},
+            { { depth, RenderGraphUsage::DepthAttachmentLoad } },
+            [this](VkCommandBuffer commandBuffer) { RenderDepthPrepass(commandBuffer, 1); });
+    }
+
+    m_RenderGraph->AddPass("gbuffer", {},
+        { { depth, RenderGraphUsage::DepthAttachmentLoad },
+          { albedo, RenderGraphUsage::ColorAttachment },
+          { normal, RenderGraphUsage::ColorAttachment },
+          { pbr, RenderGraphUsage::ColorAttachment } },
+        [this](VkCommandBuffer commandBuffer) { RenderGBufferPass(commandBuffer); });
+
+    m_RenderGraph->AddPass("lighting",
+        { { albedo, RenderGraphUsage::SampledFragment },
+          { normal, RenderGraphUsage::SampledFragment },
+          { pbr, RenderGraphUsage::SampledFragment },
+          { depth, RenderGraphUsage::DepthSampledFragment } },
+        { { hdr, RenderGraphUsage::ColorAttachment } },
+        [this](VkCommandBuffer commandBuffer) { RenderLightingPass(commandBuffer); });
+
+    m_RenderGraph->AddPass("tonemapping",
+        { { hdr, RenderGraphUsage::SampledFragment } },
+        { { m_SwapChainResource, RenderGraphUsage::ColorAttachment } },
+        [this](VkCommandBuffer commandBuffer) { RenderToneMapping(commandBuffer, m_ImageIndex, m_DeltaTime); });
+
+    m_RenderGraph->ExportImage(m_SwapChainResource, RenderGraphUsage::Present);
+    m_RenderGraph->Compile();
+
+    m_ResourceManager->SetRenderGraph(m_RenderGraph);
+}
+
 void Renderer::RecordDeferredCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, float deltaTime)
 {
     VkCommandBufferBeginInfo beginInfo{};
@@ -488,127 +953,29 @@ void Renderer::RecordDeferredCommandBuffer(VkCommandBuffer commandBuffer, uint32
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
-    m_ResourceManager->TransitionImageLayout(m_ResourceManager->GetDepthImage(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                                             VK_PIPELINE_STAGE_2_NONE,
-                                             VK_ACCESS_2_NONE,
-                                             VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT,
-		                                     VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
-    );
-
-    RenderDepthPrepass(commandBuffer);
-
-    m_ResourceManager->TransitionImageLayoutInline(
-        commandBuffer,
-        m_ResourceManager->GetGBuffer().albedo,
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        VK_PIPELINE_STAGE_2_NONE,
-        VK_ACCESS_2_NONE,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
-    );
-
-    m_ResourceManager->TransitionImageLayoutInline(
-        commandBuffer,
-        m_ResourceManager->GetGBuffer().normal,
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        VK_PIPELINE_STAGE_2_NONE,
-        VK_ACCESS_2_NONE,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
-    );
-
-    m_ResourceManager->TransitionImageLayoutInline(
-        commandBuffer,
-        m_ResourceManager->GetGBuffer().pbr,
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        VK_PIPELINE_STAGE_2_NONE,
-        VK_ACCESS_2_NONE,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
-    );
-
-    RenderGBufferPass(commandBuffer);
-
-    m_ResourceManager->TransitionImageLayoutInline(
-        commandBuffer,
-        m_ResourceManager->GetGBuffer().albedo,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-        VK_ACCESS_2_SHADER_READ_BIT
-    );
-
-    m_ResourceManager->TransitionImageLayoutInline(
-        commandBuffer,
-        m_ResourceManager->GetGBuffer().normal,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-        VK_ACCESS_2_SHADER_READ_BIT
-    );
-
-    m_ResourceManager->TransitionImageLayoutInline(
-        commandBuffer,
-        m_ResourceManager->GetGBuffer().pbr,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-        VK_ACCESS_2_SHADER_READ_BIT
-    );
-
-    m_ResourceManager->TransitionImageLayoutInline(
-        commandBuffer,
-        m_ResourceManager->GetDepthImage(),
-        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
-        VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
-        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-        VK_ACCESS_2_SHADER_READ_BIT
-    );
-
-    m_ResourceManager->TransitionImageLayoutInline(
-        commandBuffer,
-        m_ResourceManager->GetHdrBuffer().image,
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        VK_PIPELINE_STAGE_2_NONE,
-        VK_ACCESS_2_NONE,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
-    );
-
-
-    RenderLightingPass(commandBuffer);
-
-    m_ResourceManager->TransitionImageLayoutInline(
-        commandBuffer,
-        m_ResourceManager->GetHdrBuffer().image,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-        VK_ACCESS_2_SHADER_READ_BIT
-    );
-
-    m_ResourceManager->TransitionImageLayout(*m_SwapChain->GetSwapChainImages()[imageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        VK_PIPELINE_STAGE_2_NONE,
-        VK_ACCESS_2_NONE,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
-    );
-
-    RenderToneMapping(commandBuffer, imageIndex,deltaTime);
+    m_ImageIndex = imageIndex;
+    m_DeltaTime = deltaTime;
+    m_BindCounts.Reset();
+    m_RenderGraph->SetImage(m_SwapChainResource, m_SwapChain->GetSwapChainImages()[imageIndex]);
+    StartParallelRecording();
+    if (m_Device->IsDrawIndirectCountSupported()) {
+        RecordCulling(commandBuffer, 0);
+    }
+    m_RenderGraph->Execute(commandBuffer);
+    // a pass the graph skipped leaves its chunks behind, they still must not outlive the frame
+    for (uint32_t pass = 0; pass < GEOMETRY_PASS_COUNT; ++pass) {
+        WaitParallelRecording(static_cast<GeometryPass>(pass));
+    }
 
-    m_ResourceManager->TransitionImageLayout(*m_SwapChain->GetSwapChainImages()[imageIndex], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        VK_PIPELINE_STAGE_2_NONE,
-        VK_ACCESS_2_NONE
-    );
+    m_BindReportTime += deltaTime;
+    if (m_BindReportTime >= 1.0f) {
+        m_BindReportTime = 0.0f;
+        std::cout << "Commands per frame: " << m_BindCounts.pipelines.load() << " pipeline binds, " << m_BindCounts.descriptorSets.load()
+            << " descriptor set binds, " << m_BindCounts.indexBuffers.load() << " index buffer binds, " << m_BindCounts.draws.load() << " draws, "
+            << m_ParallelRecordings[GEOMETRY_PASS_GBUFFER].commandBuffers.size() << " recording chunks per geometry pass" << std::endl;
+    }
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
-}
\ No newline at end of file
+}
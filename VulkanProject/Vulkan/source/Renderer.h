@@ -1,6 +1,14 @@
 #include "GLFW/glfw3.h"
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <atomic>
+#include <future>
+#include "RenderGraph.h"
+// first, its GLM_FORCE_DEPTH_ZERO_TO_ONE has to come before any other glm include
+#include "ResourceManager.h"
+#include "FrustumCuller.h"
+#include "DrawList.h"
+#include <glm/glm.hpp>
 
 class CameraManager;
 class Device;
@@ -19,6 +27,7 @@ public:
 	float UpdateUniformBuffer(uint32_t currentImage);
 	void DrawFrame();
 	void CreateSyncObjects();
+	void CreateRenderGraph();
 	void RecreateSwapChain();
 
 	void SetCamera(CameraManager* camera) { m_Camera = camera; }
@@ -30,11 +39,55 @@ public:
 private:
 
 
-	void RenderDepthPrepass(VkCommandBuffer commandBuffer);
+	// phase 0 clears the depth, phase 1 (late culling phase, GPU-driven path) draws on top of it
+	void RenderDepthPrepass(VkCommandBuffer commandBuffer, uint32_t phase);
 	void RenderGBufferPass(VkCommandBuffer commandBuffer);
 	void RenderLightingPass(VkCommandBuffer commandBuffer);
 	void RenderToneMapping(VkCommandBuffer commandBuffer, uint32_t imageIndex, float deltaTime);
 	void RecordDeferredCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, float deltaTime);
+	// the geometry passes' draws after their pipeline and sets are bound, indirect count draws of
+	// one culling phase on the GPU-driven path, one instanced draw per visible mesh otherwise
+	void RecordMeshDraws(VkCommandBuffer commandBuffer, uint32_t phase);
+
+	// CPU path: large draw lists are split into chunks recorded into secondary command buffers on
+	// the thread pool, while this thread records the rest of the frame. The passes execute them in
+	// chunk order, so the draw order is the sorted one either way
+	enum GeometryPass : uint32_t { GEOMETRY_PASS_DEPTH_PREPASS, GEOMETRY_PASS_GBUFFER, GEOMETRY_PASS_COUNT };
+	void StartParallelRecording();
+	// waits for the pass's chunks and rethrows their errors, false when the pass records its draws inline
+	bool WaitParallelRecording(GeometryPass pass);
+	void RecordDrawChunk(GeometryPass pass, VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t endDraw);
+	// viewport, scissor, pipeline and sets of a geometry pass, secondaries inherit none of them
+	void RecordGeometryPassState(VkCommandBuffer commandBuffer, GeometryPass pass);
+	// the sorted draws [firstDraw, endDraw) of the CPU path's draw list
+	void RecordDrawRange(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t endDraw);
+	// GPU-driven path: culls the instances, picks their LODs and writes the phase's indirect draws.
+	// The early phase is recorded ahead of the render graph passes, the late one by the occlusion
+	// culling pass
+	void RecordCulling(VkCommandBuffer commandBuffer, uint32_t phase);
+	// builds the depth pyramid from the early depth prepass, then runs the late culling phase
+	void RenderOcclusionCulling(VkCommandBuffer commandBuffer);
+	// CPU path: visible instance list and per mesh ranges in it, reports the culled counts once a second
+	void CullInstances(const glm::mat4& viewProjection, float deltaTime);
+	// picks the coarsest LOD per mesh whose error projects to at most LOD_ERROR_PIXELS over its
+	// visible instances, pixelsPerUnit is the projected size of one unit at distance one
+	void SelectMeshLods(const glm::vec3& cameraPosition, float pixelsPerUnit);
+	// CPU path: one draw per visible mesh, sorted by state, material and distance
+	void BuildDrawList();
+
+	// every bind and draw of the frame goes through these so they can be counted
+	void BindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+	void BindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+		uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* descriptorSets);
+	void BindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType);
+
+	static constexpr float LOD_ERROR_PIXELS = 1.0f;
+	// local_size_x of cull.comp and compact.comp
+	static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+	// local_size_x and local_size_y of depthPyramid.comp
+	static constexpr uint32_t DEPTH_PYRAMID_WORKGROUP_SIZE = 8;
+	// fewer draws per chunk cost more in per secondary state than they save
+	static constexpr uint32_t MIN_DRAWS_PER_RECORDING_CHUNK = 256;
 
 	std::vector<VkSemaphore> m_ImageAvailableSemaphores;
 	std::vector<VkSemaphore> m_RenderFinishedSemaphores;
@@ -52,4 +105,43 @@ private:
 	Instance* m_Instance;
 	CameraManager* m_Camera = nullptr;
 	float m_LastFrameTime = 0.0f;
+
+	RenderGraph* m_RenderGraph = nullptr;
+	RenderGraphResource m_SwapChainResource = 0;
+	uint32_t m_ImageIndex = 0;
+	float m_DeltaTime = 0.0f;
+	// LOD drawn for every mesh this frame, the same in every pass so the depth prepass matches
+	std::vector<uint32_t> m_MeshLods;
+	// distance to the nearest visible instance's bounds per mesh, the depth of its sort key
+	std::vector<float> m_MeshDistances;
+	DrawList m_DrawList;
+
+	// commands recorded this frame, reported once a second. Atomic since chunks are recorded in parallel
+	struct BindCounts {
+		std::atomic<uint32_t> pipelines = 0;
+		std::atomic<uint32_t> descriptorSets = 0;
+		std::atomic<uint32_t> indexBuffers = 0;
+		std::atomic<uint32_t> draws = 0;
+
+		void Reset() { pipelines = 0; descriptorSets = 0; indexBuffers = 0; draws = 0; }
+	};
+	BindCounts m_BindCounts;
+
+	struct ParallelRecording {
+		// in draw order, empty when the pass records inline this frame
+		std::vector<VkCommandBuffer> commandBuffers;
+		std::vector<std::future<void>> jobs;
+	};
+	ParallelRecording m_ParallelRecordings[GEOMETRY_PASS_COUNT];
+	float m_BindReportTime = 0.0f;
+
+	// world bounding spheres of the instances, rebuilt when an instance moves
+	FrustumCuller m_FrustumCuller;
+	uint64_t m_CulledInstanceVersion = 0;
+	// this frame's visible instances grouped by mesh, each mesh draws its range of them
+	std::vector<uint32_t> m_VisibleInstances;
+	std::vector<uint32_t> m_MeshVisibleFirst;
+	std::vector<uint32_t> m_MeshVisibleCount;
+	float m_CullingReportTime = 0.0f;
+	CullPushConstants m_CullPushConstants{};
 };
\ No newline at end of file
@@ -5,6 +5,10 @@
 #include "SwapChain.h"
 #include "CommandManager.h"
 #include "PipelineManager.h"
+#include "RenderGraph.h"
+#include "TransientAllocator.h"
+#include "UploadBatcher.h"
+#include "VertexCompression.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -12,164 +16,493 @@
 #include <unordered_map>
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include "../../Common/ThreadPool.h"
+#include "../../Common/Ktx2.h"
 
 void ResourceManager::CreateDepthResources(SwapChain* swapChain)
 {
     VkFormat depthFormat = FindDepthFormat();
-    CreateImage(swapChain->GetSwapChainExtent().width, swapChain->GetSwapChainExtent().height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_DepthImage, m_DepthImageMemory);
-    m_DepthImageView = CreateImageView(m_DepthImage.image, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-    TransitionImageLayout(m_DepthImage, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                          VK_PIPELINE_STAGE_2_NONE,
-                          VK_ACCESS_2_NONE,
-                          VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
-                          VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
-    );
+    CreateAttachmentImage(swapChain->GetSwapChainExtent().width, swapChain->GetSwapChainExtent().height, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, m_DepthImage);
 }
 
+void ResourceManager::CreateDepthPyramid(VkExtent2D extent)
+{
+    // only the occlusion culling of the GPU-driven path reads it
+    if (!m_Device->IsDrawIndirectCountSupported()) {
+        return;
+    }
+
+    // the mip sizes round down, the build reduces every texel's whole footprint in the level
+    // above (up to 3x3 texels) so the farthest depth stays conservative anyway
+    uint32_t width = std::max(1u, (extent.width + 1) / 2);
+    uint32_t height = std::max(1u, (extent.height + 1) / 2);
+    uint32_t levelCount = 1;
+    while ((std::max(width, height) >> levelCount) > 0 && levelCount < MAX_DEPTH_PYRAMID_LEVELS) {
+        ++levelCount;
+    }
+
+    m_DepthPyramid.format = VK_FORMAT_R32_SFLOAT;
+    CreateAttachmentImage(width, height, m_DepthPyramid.format,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        m_DepthPyramid, levelCount);
 
-void ResourceManager::CreateTextureImage(const std::string& path, VkFormat format, std::vector<Texture>& textureContainer)
+    // only read with texelFetch, the sampler just has to exist
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(m_Device->GetDevice(), &samplerInfo, nullptr, &m_DepthPyramidSampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid sampler!");
+    }
+}
+
+void ResourceManager::CleanupDepthPyramid()
 {
+    if (m_DepthPyramid.image == VK_NULL_HANDLE) {
+        return;
+    }
 
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
-    if (!pixels) {
-        throw std::runtime_error("failed to load texture image!");
+    for (VkImageView levelView : m_DepthPyramidLevelViews) {
+        vkDestroyImageView(m_Device->GetDevice(), levelView, nullptr);
+    }
+    m_DepthPyramidLevelViews.clear();
+    vkDestroyImageView(m_Device->GetDevice(), m_DepthPyramidView, nullptr);
+    vkDestroySampler(m_Device->GetDevice(), m_DepthPyramidSampler, nullptr);
+    vkDestroyImage(m_Device->GetDevice(), m_DepthPyramid.image, nullptr);
+    m_DepthPyramid.image = VK_NULL_HANDLE;
+}
+
+void ResourceManager::AllocateTransientAttachments()
+{
+    std::vector<RenderGraphLifetime> lifetimes;
+    if (m_RenderGraph) {
+        lifetimes = m_RenderGraph->GetTransientLifetimes();
+    }
+
+    // Without a render graph every attachment is assumed to live for the whole frame
+    std::vector<Image*> attachments = { &m_DepthImage, &m_GBuffer.albedo, &m_GBuffer.normal, &m_GBuffer.pbr, &m_HdrBuffer.image };
+    if (m_DepthPyramid.image != VK_NULL_HANDLE) {
+        attachments.push_back(&m_DepthPyramid);
     }
-    else {
-		std::cout << "loaded texture: " << path << std::endl;
+    for (Image* attachment : attachments) {
+        bool found = std::any_of(lifetimes.begin(), lifetimes.end(),
+            [attachment](const RenderGraphLifetime& lifetime) { return lifetime.image == attachment; });
+        if (!found) {
+            lifetimes.push_back({ attachment, 0, UINT32_MAX });
+        }
     }
 
-    textureContainer.push_back(Texture{});
-    int currentTextureIndex = static_cast<int>(textureContainer.size() - 1);
+    m_TransientAllocator->Allocate(lifetimes);
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    if (m_RenderGraph) {
+        m_RenderGraph->SetAliasDependencies(m_TransientAllocator->GetAliases());
+    }
+}
+
+void ResourceManager::CreateAttachmentViews()
+{
+    m_DepthImageView = CreateImageView(m_DepthImage.image, m_DepthImage.format, VK_IMAGE_ASPECT_DEPTH_BIT);
 
-    void* data;
-    vkMapMemory(m_Device->GetDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(m_Device->GetDevice(), stagingBufferMemory);
-    stbi_image_free(pixels);
+    m_GBuffer.albedoImageView = CreateImageView(m_GBuffer.albedo.image,
+                                                m_GBuffer.albedo.format,
+                                                VK_IMAGE_ASPECT_COLOR_BIT);
 
-    textureContainer[currentTextureIndex].image.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+    m_GBuffer.normalImageView = CreateImageView(m_GBuffer.normal.image,
+                                                m_GBuffer.normal.format,
+                                                VK_IMAGE_ASPECT_COLOR_BIT);
 
-    CreateImage(texWidth, texHeight, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureContainer[currentTextureIndex].image, textureContainer[currentTextureIndex].imageMemory);
+    m_GBuffer.pbrImageView = CreateImageView(m_GBuffer.pbr.image,
+                                             m_GBuffer.pbr.format,
+                                             VK_IMAGE_ASPECT_COLOR_BIT);
 
-    TransitionImageLayout(textureContainer[currentTextureIndex].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                          VK_PIPELINE_STAGE_2_NONE,
-                          VK_ACCESS_2_NONE,
-                          VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                          VK_ACCESS_2_TRANSFER_WRITE_BIT
-        );
-    CopyBufferToImage(stagingBuffer, textureContainer[currentTextureIndex].image.image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+    m_HdrBuffer.imageView = CreateImageView(m_HdrBuffer.image.image,
+                                            m_HdrBuffer.image.format,
+                                            VK_IMAGE_ASPECT_COLOR_BIT);
 
-    textureContainer[currentTextureIndex].image.format = format;
+    if (m_DepthPyramid.image == VK_NULL_HANDLE) {
+        return;
+    }
 
-    vkDestroyBuffer(m_Device->GetDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), stagingBufferMemory, nullptr);
+    m_DepthPyramidView = CreateImageView(m_DepthPyramid.image, m_DepthPyramid.format,
+                                         VK_IMAGE_ASPECT_COLOR_BIT, m_DepthPyramid.mipLevels);
+
+    m_DepthPyramidLevelViews.resize(m_DepthPyramid.mipLevels);
+    for (uint32_t level = 0; level < m_DepthPyramid.mipLevels; ++level) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_DepthPyramid.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = m_DepthPyramid.format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(m_Device->GetDevice(), &viewInfo, nullptr, &m_DepthPyramidLevelViews[level]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid level view!");
+        }
+    }
+}
 
-    GenerateMipmaps(textureContainer[currentTextureIndex].image.image, textureContainer[currentTextureIndex].image.format, texWidth, texHeight, textureContainer[currentTextureIndex].image.mipLevels);
 
+void ResourceManager::CreatePlaceholderTextures()
+{
+    // opaque so alpha tested materials don't vanish while their real texture streams in
+    const uint8_t defaultPixel[4] = { 128, 128, 128, 255 };
+    const uint8_t flatNormalPixel[4] = { 128, 128, 255, 255 };
 
+    std::pair<Texture*, const uint8_t*> placeholders[] = {
+        { &m_DefaultTexture, defaultPixel },
+        { &m_FlatNormalTexture, flatNormalPixel }
+    };
+    for (auto& placeholder : placeholders) {
+        Texture& texture = *placeholder.first;
+        texture.image.mipLevels = 1;
+        CreateImage(1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.imageAllocation);
+        m_UploadBatcher->UploadImage(texture.image, placeholder.second, 4, 1, 1);
+        CreateTextureImageView(texture);
+        CreateTextureSampler(texture);
+    }
 }
 
-void ResourceManager::GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
+void ResourceManager::StartTextureStreaming()
+{
+    m_StreamingStart = std::chrono::high_resolution_clock::now();
+
+    // Texture slots exist from the start so descriptor indices never change, the images are
+    // created once the size is known after decoding
+    m_Textures.resize(m_TexturePaths.size());
+    m_AlphaTextures.resize(m_AlphaTexturePaths.size());
+
+    m_StreamedTextures.clear();
+    m_StreamedTextures.reserve(m_TexturePaths.size() + m_AlphaTexturePaths.size());
+    for (uint32_t i = 0; i < m_TexturePaths.size(); ++i) {
+        StreamedTexture texture{};
+        texture.path = m_TexturePaths[i].first;
+        texture.format = m_TexturePaths[i].second;
+        texture.alpha = false;
+        texture.index = i;
+        m_StreamedTextures.push_back(std::move(texture));
+    }
+    for (uint32_t i = 0; i < m_AlphaTexturePaths.size(); ++i) {
+        StreamedTexture texture{};
+        texture.path = m_AlphaTexturePaths[i].first;
+        texture.format = m_AlphaTexturePaths[i].second;
+        texture.alpha = true;
+        texture.index = i;
+        m_StreamedTextures.push_back(std::move(texture));
+    }
 
-    VkFormatProperties formatProperties;
-    vkGetPhysicalDeviceFormatProperties(m_Device->GetPhysicalDevice(), imageFormat, &formatProperties);
-    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-        throw std::runtime_error("texture image format does not support linear blitting!");
+    for (const auto& material : m_Materials) {
+        m_NormalTextureIndices.insert(material.normalTextureIndex);
     }
 
-    VkCommandBuffer commandBuffer = m_CommandManager->BeginSingleTimeCommands();
+    m_PendingTextureWrites.assign(MAX_FRAMES_IN_FLIGHT, {});
+    m_NextTextureDecode = 0;
+    m_NextTextureUpload = 0;
+    m_NextTextureResident = 0;
+    SubmitTextureDecodes();
+}
 
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.image = image;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.subresourceRange.levelCount = 1;
-
-    int32_t mipWidth = texWidth;
-    int32_t mipHeight = texHeight;
-
-    for (uint32_t i = 1; i < mipLevels; i++) {
-        barrier.subresourceRange.baseMipLevel = i - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        VkImageBlit blit{};
-        blit.srcOffsets[0] = { 0, 0, 0 };
-        blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.srcSubresource.mipLevel = i - 1;
-        blit.srcSubresource.baseArrayLayer = 0;
-        blit.srcSubresource.layerCount = 1;
-        blit.dstOffsets[0] = { 0, 0, 0 };
-        blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.dstSubresource.mipLevel = i;
-        blit.dstSubresource.baseArrayLayer = 0;
-        blit.dstSubresource.layerCount = 1;
-
-        vkCmdBlitImage(commandBuffer,
-            image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1, &blit,
-            VK_FILTER_LINEAR);
-
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        if (mipWidth > 1) mipWidth /= 2;
-        if (mipHeight > 1) mipHeight /= 2;
-    }
-
-    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    vkCmdPipelineBarrier(commandBuffer,
-        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier);
+void ResourceManager::SubmitTextureDecodes()
+{
+    // Keep a bounded window of decodes in flight so peak memory doesn't hold every decoded image at once
+    const size_t maxInFlight = static_cast<size_t>(ThreadPool::Instance().GetThreadCount()) * 2;
+    const bool loadBaked = m_Device->IsTextureCompressionBCSupported();
+    while (m_NextTextureDecode < m_StreamedTextures.size() && m_NextTextureDecode - m_NextTextureUpload < maxInFlight) {
+        StreamedTexture& stream = m_StreamedTextures[m_NextTextureDecode];
+        std::string path = stream.path;
+        stream.decoded = ThreadPool::Instance().Submit([path, loadBaked]() { return DecodeTexture(path, loadBaked); });
+        ++m_NextTextureDecode;
+    }
+}
 
-    m_CommandManager->EndSingleTimeCommands(commandBuffer);
+void ResourceManager::DrainTextureDecodes(size_t first)
+{
+    for (size_t i = first; i < m_NextTextureDecode; ++i) {
+        std::future<DecodedTexture>& pending = m_StreamedTextures[i].decoded;
+        if (!pending.valid()) {
+            continue;
+        }
+        try {
+            DecodedTexture decoded = pending.get();
+            stbi_image_free(decoded.pixels);
+        }
+        catch (const std::exception&) {
+        }
+    }
 }
 
-void ResourceManager::CreateTextureImageView(std::vector<Texture>& textureContainer)
+void ResourceManager::UpdateTextureStreaming(uint32_t currentFrame)
 {
-    for (auto& texture : textureContainer)
-    {
-        texture.imageView = CreateImageView(texture.image.image, texture.image.format, VK_IMAGE_ASPECT_COLOR_BIT,texture.image.mipLevels);
+    if (m_NextTextureResident < m_StreamedTextures.size()) {
+        // Upload whatever finished decoding, in order and within a per frame budget, never blocking the frame
+        VkDeviceSize uploadedBytes = 0;
+        while (m_NextTextureUpload < m_NextTextureDecode && uploadedBytes < TEXTURE_UPLOAD_BUDGET) {
+            StreamedTexture& stream = m_StreamedTextures[m_NextTextureUpload];
+            if (stream.decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                break;
+            }
+
+            DecodedTexture decoded;
+            try {
+                decoded = stream.decoded.get();
+                uploadedBytes += decoded.compressedFormat != VK_FORMAT_UNDEFINED ? decoded.blocks.size() : static_cast<VkDeviceSize>(decoded.width) * decoded.height * 4;
+                Texture& texture = stream.alpha ? m_AlphaTextures[stream.index] : m_Textures[stream.index];
+                stream.uploadValue = UploadTexture(decoded, stream.format, texture);
+            }
+            catch (...) {
+                // the decodes behind this one still return stb allocations nobody would free
+                stbi_image_free(decoded.pixels);
+                DrainTextureDecodes(m_NextTextureUpload + 1);
+                throw;
+            }
+            ++m_NextTextureUpload;
+        }
+        SubmitTextureDecodes();
+        m_UploadBatcher->Flush();
+
+        // Upload values only grow, so residency is checked front to back
+        while (m_NextTextureResident < m_NextTextureUpload &&
+            m_UploadBatcher->IsComplete(m_StreamedTextures[m_NextTextureResident].uploadValue)) {
+            m_StreamedTextures[m_NextTextureResident].resident = true;
+            for (auto& pendingWrites : m_PendingTextureWrites) {
+                pendingWrites.push_back(static_cast<uint32_t>(m_NextTextureResident));
+            }
+            ++m_NextTextureResident;
+        }
+
+        if (m_NextTextureResident == m_StreamedTextures.size()) {
+            std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - m_StreamingStart;
+            std::cout << "Texture streaming finished: " << m_StreamedTextures.size() << " textures resident after "
+                << time.count() << " ms" << std::endl;
+            m_UploadBatcher->WaitIdle();
+            m_MemoryAllocator->PrintStats();
+        }
     }
+
+    WriteStreamedTextureDescriptors(currentFrame);
 }
 
-void ResourceManager::CreateTextureSampler(std::vector<Texture>& textureContainer)
+void ResourceManager::WriteStreamedTextureDescriptors(uint32_t currentFrame)
+{
+    std::vector<uint32_t>& pendingWrites = m_PendingTextureWrites[currentFrame];
+    if (pendingWrites.empty()) {
+        return;
+    }
+
+    // this frame's sets are not in use anymore, its fence was waited on before we got here
+    std::vector<VkDescriptorImageInfo> imageInfos(pendingWrites.size());
+    std::vector<VkWriteDescriptorSet> writes(pendingWrites.size());
+    for (size_t i = 0; i < pendingWrites.size(); ++i) {
+        const StreamedTexture& stream = m_StreamedTextures[pendingWrites[i]];
+        const Texture& texture = stream.alpha ? m_AlphaTextures[stream.index] : m_Textures[stream.index];
+
+        imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfos[i].imageView = texture.imageView;
+        imageInfos[i].sampler = texture.sampler;
+
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = stream.alpha ? m_DepthPrepassDescriptorSets[currentFrame] : m_GBufferDescriptorSets[currentFrame];
+        writes[i].dstBinding = 0;
+        writes[i].dstArrayElement = stream.index;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[i].descriptorCount = 1;
+        writes[i].pImageInfo = &imageInfos[i];
+    }
+
+    vkUpdateDescriptorSets(m_Device->GetDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    pendingWrites.clear();
+}
+
+const Texture& ResourceManager::GetBoundTexture(bool alpha, uint32_t index) const
+{
+    size_t streamIndex = alpha ? m_TexturePaths.size() + index : index;
+    if (streamIndex < m_StreamedTextures.size() && m_StreamedTextures[streamIndex].resident) {
+        return alpha ? m_AlphaTextures[index] : m_Textures[index];
+    }
+    if (!alpha && m_NormalTextureIndices.count(index)) {
+        return m_FlatNormalTexture;
+    }
+    return m_DefaultTexture;
+}
+
+VkSemaphore ResourceManager::GetUploadTimeline() const
+{
+    return m_UploadBatcher->GetTimeline();
+}
+
+DecodedTexture ResourceManager::DecodeTexture(const std::string& path, bool loadBaked)
+{
+    DecodedTexture decoded{};
+    decoded.path = path;
+    if (loadBaked && LoadBakedTexture(path, decoded)) {
+        return decoded;
+    }
+
+    int texChannels;
+    decoded.pixels = stbi_load(path.c_str(), &decoded.width, &decoded.height, &texChannels, STBI_rgb_alpha);
+    if (!decoded.pixels) {
+        throw std::runtime_error("failed to load texture image: " + path);
+    }
+    return decoded;
+}
+
+static VkComponentSwizzle ParseSwizzle(char channel)
+{
+    switch (channel) {
+    case 'r': return VK_COMPONENT_SWIZZLE_R;
+    case 'g': return VK_COMPONENT_SWIZZLE_G;
+    case 'b': return VK_COMPONENT_SWIZZLE_B;
+    case 'a': return VK_COMPONENT_SWIZZLE_A;
+    case '0': return VK_COMPONENT_SWIZZLE_ZERO;
+    case '1': return VK_COMPONENT_SWIZZLE_ONE;
+    default: return VK_COMPONENT_SWIZZLE_IDENTITY;
+    }
+}
+
+bool ResourceManager::LoadBakedTexture(const std::string& path, DecodedTexture& decoded)
+{
+    std::string bakedPath = Ktx2::GetBakedPath(path);
+    std::ifstream file(bakedPath, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+
+    // anything unexpected falls back to decoding the source image
+    Ktx2::Header header{};
+    if (data.size() < sizeof(header)) {
+        std::cerr << "ignoring " << bakedPath << ": truncated" << std::endl;
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+
+    VkFormat format = static_cast<VkFormat>(header.vkFormat);
+    bool supportedFormat = format == VK_FORMAT_BC7_SRGB_BLOCK || format == VK_FORMAT_BC7_UNORM_BLOCK ||
+        format == VK_FORMAT_BC5_UNORM_BLOCK || format == VK_FORMAT_BC4_UNORM_BLOCK;
+    size_t levelIndexEnd = sizeof(header) + static_cast<size_t>(header.levelCount) * sizeof(Ktx2::LevelIndex);
+    if (!Ktx2::HasIdentifier(header) || !supportedFormat || header.supercompressionScheme != 0 ||
+        header.levelCount == 0 || header.layerCount > 1 || header.faceCount != 1 || header.pixelDepth > 1 ||
+        levelIndexEnd > data.size()) {
+        std::cerr << "ignoring " << bakedPath << ": unsupported KTX2 layout" << std::endl;
+        return false;
+    }
+
+    std::vector<Ktx2::LevelIndex> levelIndex(header.levelCount);
+    memcpy(levelIndex.data(), data.data() + sizeof(header), levelIndex.size() * sizeof(Ktx2::LevelIndex));
+
+    // level data is stored smallest mip first, keep only that range
+    uint64_t dataBegin = UINT64_MAX;
+    for (const auto& level : levelIndex) {
+        if (level.byteOffset + level.byteLength > data.size()) {
+            std::cerr << "ignoring " << bakedPath << ": truncated" << std::endl;
+            return false;
+        }
+        dataBegin = std::min(dataBegin, level.byteOffset);
+    }
+    decoded.blocks.assign(data.begin() + dataBegin, data.end());
+
+    decoded.levels.resize(header.levelCount);
+    for (uint32_t i = 0; i < header.levelCount; ++i) {
+        VkBufferImageCopy& region = decoded.levels[i];
+        region = VkBufferImageCopy{};
+        region.bufferOffset = levelIndex[i].byteOffset - dataBegin;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { std::max(1u, header.pixelWidth >> i), std::max(1u, header.pixelHeight >> i), 1 };
+    }
+
+    // key/value entries: uint32 length, "key\0value\0", padded to 4 bytes
+    size_t kvdOffset = header.kvdByteOffset;
+    size_t kvdEnd = std::min(data.size(), kvdOffset + header.kvdByteLength);
+    while (kvdOffset + sizeof(uint32_t) <= kvdEnd) {
+        uint32_t length;
+        memcpy(&length, data.data() + kvdOffset, sizeof(length));
+        const char* entry = data.data() + kvdOffset + sizeof(uint32_t);
+        if (length == 0 || kvdOffset + sizeof(uint32_t) + length > kvdEnd) {
+            break;
+        }
+        std::string key(entry, strnlen(entry, length));
+        if (key == Ktx2::SWIZZLE_KEY && length >= key.size() + 5) {
+            const char* swizzle = entry + key.size() + 1;
+            decoded.swizzle = { ParseSwizzle(swizzle[0]), ParseSwizzle(swizzle[1]), ParseSwizzle(swizzle[2]), ParseSwizzle(swizzle[3]) };
+        }
+        kvdOffset += (sizeof(uint32_t) + length + 3) & ~size_t(3);
+    }
+
+    decoded.width = static_cast<int>(header.pixelWidth);
+    decoded.height = static_cast<int>(header.pixelHeight);
+    decoded.compressedFormat = format;
+    return true;
+}
+
+uint64_t ResourceManager::UploadTexture(DecodedTexture& decoded, VkFormat format, Texture& texture)
+{
+    int texWidth = decoded.width;
+    int texHeight = decoded.height;
+    VkDeviceSize imageSize = texWidth * texHeight * 4;
+    if (decoded.compressedFormat != VK_FORMAT_UNDEFINED) {
+        std::cout << "loaded baked texture: " << decoded.path << std::endl;
+
+        // the baked format wins over the requested one, the mip chain comes with the file
+        texture.image.mipLevels = static_cast<uint32_t>(decoded.levels.size());
+        texture.swizzle = decoded.swizzle;
+        CreateImage(texWidth, texHeight, decoded.compressedFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.imageAllocation);
+
+        uint64_t uploadValue = m_UploadBatcher->UploadCompressedImage(texture.image, decoded.blocks.data(), decoded.blocks.size(), decoded.levels);
+        decoded.blocks = {};
+
+        CreateTextureImageView(texture);
+        CreateTextureSampler(texture);
+        return uploadValue;
+    }
+
+    std::cout << "loaded texture: " << decoded.path << std::endl;
+
+    texture.image.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+
+    CreateImage(texWidth, texHeight, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.imageAllocation);
+
+    // copy and mip chain are recorded into the current upload batch, nothing waits on the GPU here
+    uint64_t uploadValue = m_UploadBatcher->UploadImage(texture.image, decoded.pixels, imageSize, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+    stbi_image_free(decoded.pixels);
+    decoded.pixels = nullptr;
+
+    CreateTextureImageView(texture);
+    CreateTextureSampler(texture);
+    return uploadValue;
+}
+
+void ResourceManager::CreateTextureImageView(Texture& texture)
+{
+    texture.imageView = CreateImageView(texture.image.image, texture.image.format, VK_IMAGE_ASPECT_COLOR_BIT, texture.image.mipLevels, texture.swizzle);
+}
+
+void ResourceManager::CreateTextureSampler(Texture& texture)
 {
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -192,85 +525,84 @@ void ResourceManager::CreateTextureSampler(std::vector<Texture>& textureContaine
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
 
-    for (auto& texture : textureContainer)
-    {
-
-        samplerInfo.maxLod = static_cast<float>(texture.image.mipLevels);
-        if (vkCreateSampler(m_Device->GetDevice(), &samplerInfo, nullptr, &texture.sampler) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create texture sampler!");
-        }
+    samplerInfo.maxLod = static_cast<float>(texture.image.mipLevels);
+    if (vkCreateSampler(m_Device->GetDevice(), &samplerInfo, nullptr, &texture.sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
     }
 }
 
-void ResourceManager::CreateVertexBuffer()
+void ResourceManager::CreateMaterialBuffer()
 {
-    VkDeviceSize bufferSize = sizeof(m_Vertices[0]) * m_Vertices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    VkDeviceSize bufferSize = sizeof(GpuMaterial) * m_Materials.size();
 
+    CreateBuffer(bufferSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_MaterialBuffer,
+        m_MaterialBufferAllocation);
 
-    void* data;
-    vkMapMemory(m_Device->GetDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, m_Vertices.data(), (size_t)bufferSize);
-    vkUnmapMemory(m_Device->GetDevice(), stagingBufferMemory);
-
-    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VertexBuffer, m_VertexBufferMemory);
-    CopyBuffer(stagingBuffer, m_VertexBuffer, bufferSize);
-    vkDestroyBuffer(m_Device->GetDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), stagingBufferMemory, nullptr);
+    m_UploadBatcher->UploadBuffer(m_MaterialBuffer, m_Materials.data(), bufferSize);
 }
 
-void ResourceManager::CreateMaterialBuffer()
+void ResourceManager::CreateIndexBuffer()
 {
-    VkDeviceSize bufferSize = sizeof(GpuMaterial) * m_Meshes.size();
+    // one buffer per index type, a scene without large meshes has no 32 bit buffer at all
+    if (!m_Indices.empty()) {
+        VkDeviceSize bufferSize = sizeof(m_Indices[0]) * m_Indices.size();
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer,
-        stagingBufferMemory);
+        CreateBuffer(bufferSize,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_IndexBuffer,
+            m_IndexBufferAllocation);
 
-    void* data;
-    vkMapMemory(m_Device->GetDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-    for (size_t i = 0; i < m_Meshes.size(); ++i) {
-        memcpy(static_cast<char*>(data) + i * sizeof(m_Meshes[0].material), &m_Meshes[i].material, sizeof(m_Meshes[0].material));
+        m_UploadBatcher->UploadBuffer(m_IndexBuffer, m_Indices.data(), bufferSize);
     }
-    vkUnmapMemory(m_Device->GetDevice(), stagingBufferMemory);
 
-    CreateBuffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_MaterialBuffer,
-        m_MaterialBufferMemory);
+    if (!m_Indices16.empty()) {
+        VkDeviceSize bufferSize = sizeof(m_Indices16[0]) * m_Indices16.size();
+
+        CreateBuffer(bufferSize,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_Index16Buffer,
+            m_Index16BufferAllocation);
 
-    CopyBuffer(stagingBuffer, m_MaterialBuffer, bufferSize);
+        m_UploadBatcher->UploadBuffer(m_Index16Buffer, m_Indices16.data(), bufferSize);
+    }
 
-    vkDestroyBuffer(m_Device->GetDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), stagingBufferMemory, nullptr);
+    std::cout << "Indices: " << m_Indices16.size() << " 16 bit, " << m_Indices.size() << " 32 bit" << std::endl;
 }
 
-void ResourceManager::CreateIndexBuffer()
+void ResourceManager::CreateMeshletBuffers()
 {
-    VkDeviceSize bufferSize = sizeof(m_Indices[0]) * m_Indices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    // buffers can't be empty, a scene without meshlets still gets one element each
+    VkDeviceSize meshletSize = sizeof(Meshlet) * std::max<size_t>(m_Meshlets.size(), 1);
+    VkDeviceSize vertexSize = sizeof(uint32_t) * std::max<size_t>(m_MeshletVertices.size(), 1);
+    VkDeviceSize triangleSize = sizeof(uint32_t) * std::max<size_t>(m_MeshletTriangles.size(), 1);
 
-    void* data;
-    vkMapMemory(m_Device->GetDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, m_Indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(m_Device->GetDevice(), stagingBufferMemory);
+    CreateBuffer(meshletSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_MeshletBuffer,
+        m_MeshletBufferAllocation);
+    CreateBuffer(vertexSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_MeshletVertexBuffer,
+        m_MeshletVertexBufferAllocation);
+    CreateBuffer(triangleSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_MeshletTriangleBuffer,
+        m_MeshletTriangleBufferAllocation);
 
-    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_IndexBuffer, m_IndexBufferMemory);
-    CopyBuffer(stagingBuffer, m_IndexBuffer, bufferSize);
-    vkDestroyBuffer(m_Device->GetDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), stagingBufferMemory, nullptr);
+    if (m_Meshlets.empty()) {
+        return;
+    }
+    m_UploadBatcher->UploadBuffer(m_MeshletBuffer, m_Meshlets.data(), meshletSize);
+    m_UploadBatcher->UploadBuffer(m_MeshletVertexBuffer, m_MeshletVertices.data(), vertexSize);
+    m_UploadBatcher->UploadBuffer(m_MeshletTriangleBuffer, m_MeshletTriangles.data(), triangleSize);
 }
 
 void ResourceManager::CreateUniformBuffers()
@@ -278,56 +610,169 @@ void ResourceManager::CreateUniformBuffers()
     VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
     m_UniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    m_UniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    m_UniformBuffersAllocation.resize(MAX_FRAMES_IN_FLIGHT);
     m_UniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_UniformBuffers[i], m_UniformBuffersMemory[i]);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_UniformBuffers[i], m_UniformBuffersAllocation[i]);
 
-        vkMapMemory(m_Device->GetDevice(), m_UniformBuffersMemory[i], 0, bufferSize, 0, &m_UniformBuffersMapped[i]);
+        m_UniformBuffersMapped[i] = m_UniformBuffersAllocation[i].mappedData;
     }
 }
 
-void ResourceManager::CreateLightingUniformBuffer()
+void ResourceManager::CreateInstanceBuffers()
 {
-    VkDeviceSize bufferSize = sizeof(LightingSSBO) * m_Lights.size();
+    // buffers can't be empty, an empty scene still gets room for one instance
+    VkDeviceSize bufferSize = sizeof(MeshInstance) * std::max<size_t>(m_Instances.size(), 1);
+
+    m_InstanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_InstanceBuffersAllocation.resize(MAX_FRAMES_IN_FLIGHT);
+    m_InstanceBufferVersions.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+    // every instance visible at most, until the first frame culls them
+    VkDeviceSize visibleBufferSize = sizeof(uint32_t) * std::max<size_t>(m_Instances.size(), 1);
+    std::vector<uint32_t> allInstances(m_Instances.size());
+    for (uint32_t i = 0; i < allInstances.size(); ++i) {
+        allInstances[i] = i;
+    }
+    m_VisibleInstanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_VisibleInstanceBuffersAllocation.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_InstanceBuffers[i], m_InstanceBuffersAllocation[i]);
+        UpdateInstanceBuffer(static_cast<uint32_t>(i));
+        if (m_Device->IsDrawIndirectCountSupported()) {
+            // only the culling compute pass writes it, every frame before the draws
+            CreateBuffer(visibleBufferSize * MAX_MESH_LODS * CULL_PHASES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VisibleInstanceBuffers[i], m_VisibleInstanceBuffersAllocation[i]);
+            continue;
+        }
+        CreateBuffer(visibleBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_VisibleInstanceBuffers[i], m_VisibleInstanceBuffersAllocation[i]);
+        UpdateVisibleInstanceBuffer(static_cast<uint32_t>(i), allInstances);
+    }
+
+    uint32_t drawnMeshes = 0;
+    for (const auto& mesh : m_Meshes) {
+        drawnMeshes += mesh.instanceCount > 0;
+    }
+    std::cout << m_Instances.size() << " instances of " << drawnMeshes << " meshes" << std::endl;
+}
+
+void ResourceManager::CreateMeshDrawBuffer()
+{
+    std::vector<MeshDrawData> meshDraws(m_Meshes.size());
+    for (size_t i = 0; i < m_Meshes.size(); ++i) {
+        const MeshHandle& mesh = m_Meshes[i];
+        MeshDrawData& draw = meshDraws[i];
+        draw.boundsCenter = mesh.boundsCenter;
+        draw.boundsRadius = mesh.boundsRadius;
+        draw.positionOffset = VertexCompression::GetPositionOffset(mesh);
+        draw.positionScale = VertexCompression::GetPositionScale(mesh);
+        draw.lodCount = mesh.lodCount;
+        draw.vertexOffset = mesh.vertexOffset;
+        draw.firstInstance = mesh.firstInstance;
+        draw.instanceCount = mesh.instanceCount;
+        draw.index16 = mesh.indexType == VK_INDEX_TYPE_UINT16 ? 1 : 0;
+        draw.padding = 0;
+        for (uint32_t lod = 0; lod < MAX_MESH_LODS; ++lod) {
+            bool valid = lod < mesh.lodCount;
+            draw.lodIndexOffsets[lod] = valid ? mesh.lods[lod].indexOffset : 0;
+            draw.lodIndexCounts[lod] = valid ? mesh.lods[lod].indexCount : 0;
+            draw.lodErrors[lod] = valid ? mesh.lods[lod].error : 0.0f;
+        }
+    }
+
+    // buffers can't be empty, a scene without meshes still gets one element
+    VkDeviceSize bufferSize = sizeof(MeshDrawData) * std::max<size_t>(meshDraws.size(), 1);
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
     CreateBuffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer,
-        stagingBufferMemory);
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_MeshDrawBuffer,
+        m_MeshDrawBufferAllocation);
 
-    void* data;
-    vkMapMemory(m_Device->GetDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, m_Lights.data(), bufferSize);
-    vkUnmapMemory(m_Device->GetDevice(), stagingBufferMemory);
+    if (meshDraws.empty()) {
+        return;
+    }
+    m_UploadBatcher->UploadBuffer(m_MeshDrawBuffer, meshDraws.data(), sizeof(MeshDrawData) * meshDraws.size());
+}
+
+void ResourceManager::CreateDrawCommandBuffers()
+{
+    // the CPU path never touches them, but the universal set needs valid buffers at bindings 8 to 10
+    VkDeviceSize countSize = sizeof(uint32_t) * (DRAW_COUNT_HEADER + GetMaxDrawCount()) * CULL_PHASES;
+    VkDeviceSize commandSize = sizeof(VkDrawIndexedIndirectCommand) * 2 * std::max<size_t>(GetMaxDrawCount(), 1) * CULL_PHASES;
+
+    m_DrawCountBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_DrawCountBuffersAllocation.resize(MAX_FRAMES_IN_FLIGHT);
+    m_DrawCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_DrawCommandBuffersAllocation.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        CreateBuffer(countSize,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_DrawCountBuffers[i],
+            m_DrawCountBuffersAllocation[i]);
+        CreateBuffer(commandSize,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_DrawCommandBuffers[i],
+            m_DrawCommandBuffersAllocation[i]);
+    }
+
+    // nothing counts as visible before the first frame, so its early phase draws nothing and the
+    // late phase tests every instance against an empty depth pyramid
+    std::vector<uint32_t> visibility(std::max<size_t>(m_Instances.size(), 1), 0);
+    VkDeviceSize visibilitySize = sizeof(uint32_t) * visibility.size();
+    CreateBuffer(visibilitySize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_InstanceVisibilityBuffer,
+        m_InstanceVisibilityBufferAllocation);
+    m_UploadBatcher->UploadBuffer(m_InstanceVisibilityBuffer, visibility.data(), visibilitySize);
+}
+
+void ResourceManager::UpdateInstanceBuffer(uint32_t currentFrame)
+{
+    if (m_InstanceBufferVersions[currentFrame] == m_InstanceVersion) {
+        return;
+    }
+    memcpy(m_InstanceBuffersAllocation[currentFrame].mappedData, m_Instances.data(), sizeof(MeshInstance) * m_Instances.size());
+    m_InstanceBufferVersions[currentFrame] = m_InstanceVersion;
+}
+
+void ResourceManager::UpdateVisibleInstanceBuffer(uint32_t currentFrame, const std::vector<uint32_t>& visibleInstances)
+{
+    memcpy(m_VisibleInstanceBuffersAllocation[currentFrame].mappedData, visibleInstances.data(), sizeof(uint32_t) * visibleInstances.size());
+}
+
+void ResourceManager::CreateLightingUniformBuffer()
+{
+    VkDeviceSize bufferSize = sizeof(LightingSSBO) * m_Lights.size();
 
     CreateBuffer(bufferSize,
         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         m_LightingBuffer,
-        m_LightingBufferMemory);
-
-    CopyBuffer(stagingBuffer, m_LightingBuffer, bufferSize);
+        m_LightingBufferAllocation);
 
-    vkDestroyBuffer(m_Device->GetDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), stagingBufferMemory, nullptr);
+    m_UploadBatcher->UploadBuffer(m_LightingBuffer, m_Lights.data(), bufferSize);
 }
 
 void ResourceManager::CreateDescriptorPools() {
 
     uint32_t totalUniformBuffers = MAX_FRAMES_IN_FLIGHT + 1;
-    uint32_t totalStorageBuffers = MAX_FRAMES_IN_FLIGHT * 2;
-    uint32_t totalCombinedImageSamplers = (MAX_FRAMES_IN_FLIGHT + 5000) + 2;
+    // positions, texture coordinates, tangent frames, materials, instances, visible instances,
+    // mesh draw data, draw counts, draw commands and instance visibility per frame
+    uint32_t totalStorageBuffers = MAX_FRAMES_IN_FLIGHT * 10;
+    // the depth pyramid set samples the depth image and the pyramid
+    uint32_t totalCombinedImageSamplers = (MAX_FRAMES_IN_FLIGHT + 5000) + 2 + 2;
 
     totalUniformBuffers += 2;
     totalStorageBuffers += 2;
     totalCombinedImageSamplers += 10;
 
-    std::array<VkDescriptorPoolSize, 4> poolSizes{};
+    std::array<VkDescriptorPoolSize, 5> poolSizes{};
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[0].descriptorCount = totalUniformBuffers;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -336,13 +781,15 @@ void ResourceManager::CreateDescriptorPools() {
     poolSizes[2].descriptorCount = totalStorageBuffers;
     poolSizes[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[3].descriptorCount = totalCombinedImageSamplers;
+    poolSizes[4].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[4].descriptorCount = MAX_DEPTH_PYRAMID_LEVELS;
     
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT + 8);
+    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT + 9);
     
     if (vkCreateDescriptorPool(m_Device->GetDevice(), &poolInfo, nullptr, &m_DescriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
@@ -354,7 +801,7 @@ void ResourceManager::CreateDescriptorSets(PipelineManager* pipelineManager) {
         std::vector<VkDescriptorSetLayout> universalLayouts(MAX_FRAMES_IN_FLIGHT, pipelineManager->GetUniversalDescriptorSetLayout());
 
         m_UniversalDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             VkDescriptorSetAllocateInfo allocInfo{};
             allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
             allocInfo.descriptorPool = m_DescriptorPool;
@@ -379,7 +826,7 @@ void ResourceManager::CreateDescriptorSets(PipelineManager* pipelineManager) {
         variableCountInfo.pDescriptorCounts = &textureCount;
 
         m_GBufferDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             VkDescriptorSetAllocateInfo allocInfo{};
             allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
             allocInfo.pNext = &variableCountInfo;
@@ -404,7 +851,7 @@ void ResourceManager::CreateDescriptorSets(PipelineManager* pipelineManager) {
     variableCountInfo.pDescriptorCounts = &alphaTextureCount;
 
     m_DepthPrepassDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.pNext = &variableCountInfo;
@@ -417,7 +864,7 @@ void ResourceManager::CreateDescriptorSets(PipelineManager* pipelineManager) {
         }
     }
     // Update all descriptor sets
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         //Update Universal Descriptor Set
         {
             VkDescriptorBufferInfo uboInfo{};
@@ -425,17 +872,57 @@ void ResourceManager::CreateDescriptorSets(PipelineManager* pipelineManager) {
             uboInfo.offset = 0;
             uboInfo.range = sizeof(UniformBufferObject);
 
-            VkDescriptorBufferInfo vertexBufferInfo{};
-            vertexBufferInfo.buffer = m_VertexBuffer;
-            vertexBufferInfo.offset = 0;
-            vertexBufferInfo.range = VK_WHOLE_SIZE;
+            VkDescriptorBufferInfo positionBufferInfo{};
+            positionBufferInfo.buffer = m_PositionBuffer;
+            positionBufferInfo.offset = 0;
+            positionBufferInfo.range = VK_WHOLE_SIZE;
 
             VkDescriptorBufferInfo materialBufferInfo{};
             materialBufferInfo.buffer = m_MaterialBuffer;
             materialBufferInfo.offset = 0;
             materialBufferInfo.range = VK_WHOLE_SIZE;
 
-            std::array<VkWriteDescriptorSet, 3> universalWrites{};
+            VkDescriptorBufferInfo texCoordBufferInfo{};
+            texCoordBufferInfo.buffer = m_TexCoordBuffer;
+            texCoordBufferInfo.offset = 0;
+            texCoordBufferInfo.range = VK_WHOLE_SIZE;
+
+            VkDescriptorBufferInfo tangentFrameBufferInfo{};
+            tangentFrameBufferInfo.buffer = m_TangentFrameBuffer;
+            tangentFrameBufferInfo.offset = 0;
+            tangentFrameBufferInfo.range = VK_WHOLE_SIZE;
+
+            VkDescriptorBufferInfo instanceBufferInfo{};
+            instanceBufferInfo.buffer = m_InstanceBuffers[i];
+            instanceBufferInfo.offset = 0;
+            instanceBufferInfo.range = VK_WHOLE_SIZE;
+
+            VkDescriptorBufferInfo visibleInstanceBufferInfo{};
+            visibleInstanceBufferInfo.buffer = m_VisibleInstanceBuffers[i];
+            visibleInstanceBufferInfo.offset = 0;
+            visibleInstanceBufferInfo.range = VK_WHOLE_SIZE;
+
+            VkDescriptorBufferInfo meshDrawBufferInfo{};
+            meshDrawBufferInfo.buffer = m_MeshDrawBuffer;
+            meshDrawBufferInfo.offset = 0;
+            meshDrawBufferInfo.range = VK_WHOLE_SIZE;
+
+            VkDescriptorBufferInfo drawCountBufferInfo{};
+            drawCountBufferInfo.buffer = m_DrawCountBuffers[i];
+            drawCountBufferInfo.offset = 0;
+            drawCountBufferInfo.range = VK_WHOLE_SIZE;
+
+            VkDescriptorBufferInfo drawCommandBufferInfo{};
+            drawCommandBufferInfo.buffer = m_DrawCommandBuffers[i];
+            drawCommandBufferInfo.offset = 0;
+            drawCommandBufferInfo.range = VK_WHOLE_SIZE;
+
+            VkDescriptorBufferInfo instanceVisibilityBufferInfo{};
+            instanceVisibilityBufferInfo.buffer = m_InstanceVisibilityBuffer;
+            instanceVisibilityBufferInfo.offset = 0;
+            instanceVisibilityBufferInfo.range = VK_WHOLE_SIZE;
+
+            std::array<VkWriteDescriptorSet, 11> universalWrites{};
 
             universalWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             universalWrites[0].dstSet = m_UniversalDescriptorSets[i];
@@ -445,21 +932,19 @@ void ResourceManager::CreateDescriptorSets(PipelineManager* pipelineManager) {
             universalWrites[0].descriptorCount = 1;
             universalWrites[0].pBufferInfo = &uboInfo;
 
-            universalWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            universalWrites[1].dstSet = m_UniversalDescriptorSets[i];
-            universalWrites[1].dstBinding = 1;
-            universalWrites[1].dstArrayElement = 0;
-            universalWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            universalWrites[1].descriptorCount = 1;
-            universalWrites[1].pBufferInfo = &vertexBufferInfo;
-
-            universalWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            universalWrites[2].dstSet = m_UniversalDescriptorSets[i];
-            universalWrites[2].dstBinding = 2;
-            universalWrites[2].dstArrayElement = 0;
-            universalWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            universalWrites[2].descriptorCount = 1;
-            universalWrites[2].pBufferInfo = &materialBufferInfo;
+            // storage buffers at bindings 1 to 10
+            const VkDescriptorBufferInfo* storageInfos[] = { &positionBufferInfo, &materialBufferInfo, &texCoordBufferInfo, &tangentFrameBufferInfo,
+                &instanceBufferInfo, &visibleInstanceBufferInfo, &meshDrawBufferInfo, &drawCountBufferInfo, &drawCommandBufferInfo,
+                &instanceVisibilityBufferInfo };
+            for (uint32_t binding = 1; binding < universalWrites.size(); ++binding) {
+                universalWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                universalWrites[binding].dstSet = m_UniversalDescriptorSets[i];
+                universalWrites[binding].dstBinding = binding;
+                universalWrites[binding].dstArrayElement = 0;
+                universalWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                universalWrites[binding].descriptorCount = 1;
+                universalWrites[binding].pBufferInfo = storageInfos[binding - 1];
+            }
 
             vkUpdateDescriptorSets(m_Device->GetDevice(), static_cast<uint32_t>(universalWrites.size()), universalWrites.data(), 0, nullptr);
         }
@@ -467,7 +952,8 @@ void ResourceManager::CreateDescriptorSets(PipelineManager* pipelineManager) {
         //Update GBuffer Descriptor Set
         {
             std::vector<VkDescriptorImageInfo> textureInfos;
-            for (const auto& tex : m_Textures) {
+            for (uint32_t textureIndex = 0; textureIndex < m_Textures.size(); ++textureIndex) {
+                const Texture& tex = GetBoundTexture(false, textureIndex);
                 VkDescriptorImageInfo imageInfo{};
                 imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
                 imageInfo.imageView = tex.imageView;
@@ -488,7 +974,8 @@ void ResourceManager::CreateDescriptorSets(PipelineManager* pipelineManager) {
         }
 
         std::vector<VkDescriptorImageInfo> alphaTextureInfos;
-        for (const auto& alphaTex : m_AlphaTextures) {
+        for (uint32_t textureIndex = 0; textureIndex < m_AlphaTextures.size(); ++textureIndex) {
+            const Texture& alphaTex = GetBoundTexture(true, textureIndex);
             VkDescriptorImageInfo imageInfo{};
             imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
             imageInfo.imageView = alphaTex.imageView;
@@ -633,17 +1120,84 @@ void ResourceManager::CreateToneMappingDescriptorSet(PipelineManager* pipelineMa
     vkUpdateDescriptorSets(m_Device->GetDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
+void ResourceManager::CreateDepthPyramidDescriptorSet(PipelineManager* pipelineManager)
+{
+    if (m_DepthPyramid.image == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkDescriptorSetLayout layout = pipelineManager->GetDepthPyramidDescriptorSetLayout();
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_DescriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    if (vkAllocateDescriptorSets(m_Device->GetDevice(), &allocInfo, &m_DepthPyramidDescriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate depth pyramid descriptor set!");
+    }
+
+    std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+
+    VkDescriptorImageInfo depthInfo{};
+    depthInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthInfo.imageView = m_DepthImageView;
+    depthInfo.sampler = m_DepthPyramidSampler;
+
+    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = m_DepthPyramidDescriptorSet;
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstArrayElement = 0;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[0].pImageInfo = &depthInfo;
+
+    // the pyramid stays in GENERAL for the whole occlusion culling pass, built and read at once
+    VkDescriptorImageInfo pyramidInfo{};
+    pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    pyramidInfo.imageView = m_DepthPyramidView;
+    pyramidInfo.sampler = m_DepthPyramidSampler;
+
+    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[1].dstSet = m_DepthPyramidDescriptorSet;
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].dstArrayElement = 0;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[1].pImageInfo = &pyramidInfo;
+
+    std::vector<VkDescriptorImageInfo> levelInfos;
+    for (VkImageView levelView : m_DepthPyramidLevelViews) {
+        VkDescriptorImageInfo levelInfo{};
+        levelInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        levelInfo.imageView = levelView;
+        levelInfo.sampler = VK_NULL_HANDLE;
+        levelInfos.push_back(levelInfo);
+    }
+
+    descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[2].dstSet = m_DepthPyramidDescriptorSet;
+    descriptorWrites[2].dstBinding = 2;
+    descriptorWrites[2].dstArrayElement = 0;
+    descriptorWrites[2].descriptorCount = static_cast<uint32_t>(levelInfos.size());
+    descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorWrites[2].pImageInfo = levelInfos.data();
+
+    vkUpdateDescriptorSets(m_Device->GetDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
 void ResourceManager::RecreateResources(SwapChain* pSwapchain, PipelineManager* pPipelineManager)
 {
     CleanDepth();
     CleanupGBuffer();
+    CleanupDepthPyramid();
 
     vkDestroySampler(m_Device->GetDevice(), m_HdrBuffer.sampler, nullptr);
 
     //hdr cleanup
     vkDestroyImageView(m_Device->GetDevice(), m_HdrBuffer.imageView, nullptr);
     vkDestroyImage(m_Device->GetDevice(), m_HdrBuffer.image.image, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), m_HdrBuffer.imageMemory, nullptr);
+    m_TransientAllocator->Free();
 
     CreateDepthResources(pSwapchain);
 
@@ -651,6 +1205,11 @@ void ResourceManager::RecreateResources(SwapChain* pSwapchain, PipelineManager*
 
     CreateHdrBuffer(pSwapchain->GetSwapChainExtent());
 
+    CreateDepthPyramid(pSwapchain->GetSwapChainExtent());
+
+    AllocateTransientAttachments();
+    CreateAttachmentViews();
+
     CleanupDescriptorPool();
 
     CreateDescriptorPools();
@@ -658,6 +1217,7 @@ void ResourceManager::RecreateResources(SwapChain* pSwapchain, PipelineManager*
     CreateDescriptorSets(pPipelineManager);
     CreateLightingDescriptorSet(pPipelineManager);
     CreateToneMappingDescriptorSet(pPipelineManager);
+    CreateDepthPyramidDescriptorSet(pPipelineManager);
 }
 
 void ResourceManager::AddPointLight(glm::vec3 position, glm::vec3 color, float lumen, float lux)
@@ -675,44 +1235,25 @@ void ResourceManager::CreateGBuffer(VkExtent2D extent)
 
     //albedo
     m_GBuffer.albedo.format = VK_FORMAT_R8G8B8A8_SRGB;
-    CreateImage(extent.width,extent.height,
+    CreateAttachmentImage(extent.width,extent.height,
                 m_GBuffer.albedo.format,
-                VK_IMAGE_TILING_OPTIMAL,
                 VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                m_GBuffer.albedo,m_GBuffer.albedoImageMemory);
-
-    m_GBuffer.albedoImageView = CreateImageView(m_GBuffer.albedo.image,
-                                                m_GBuffer.albedo.format,
-                                                VK_IMAGE_ASPECT_COLOR_BIT);
+                m_GBuffer.albedo);
 
     //normal
     m_GBuffer.normal.format = VK_FORMAT_R8G8B8A8_UNORM;
-	CreateImage(extent.width, extent.height,
+	CreateAttachmentImage(extent.width, extent.height,
 		        m_GBuffer.normal.format,
-		        VK_IMAGE_TILING_OPTIMAL,
 		        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		        m_GBuffer.normal, m_GBuffer.normalImageMemory);
-
-	m_GBuffer.normalImageView = CreateImageView(m_GBuffer.normal.image,
-		                                        m_GBuffer.normal.format,
-		                                        VK_IMAGE_ASPECT_COLOR_BIT);
+		        m_GBuffer.normal);
     m_GBuffer.normal.currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     m_GBuffer.pbr.format = VK_FORMAT_R8G8B8A8_SRGB;
-    CreateImage(
+    CreateAttachmentImage(
         extent.width, extent.height,
         m_GBuffer.pbr.format,
-        VK_IMAGE_TILING_OPTIMAL,
         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_GBuffer.pbr, m_GBuffer.pbrImageMemory
-    );
-    m_GBuffer.pbrImageView = CreateImageView(
-        m_GBuffer.pbr.image,
-        m_GBuffer.pbr.format,
-        VK_IMAGE_ASPECT_COLOR_BIT
+        m_GBuffer.pbr
     );
 
 	m_GBuffer.depth = m_DepthImage;
@@ -741,18 +1282,12 @@ void ResourceManager::CreateGBuffer(VkExtent2D extent)
 void ResourceManager::CreateHdrBuffer(VkExtent2D extent)
 {
     m_HdrBuffer.image.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    CreateImage(extent.width, extent.height,
+    CreateAttachmentImage(extent.width, extent.height,
         m_HdrBuffer.image.format,
-        VK_IMAGE_TILING_OPTIMAL,
         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_HdrBuffer.image, m_HdrBuffer.imageMemory);
+        m_HdrBuffer.image);
 
     m_HdrBuffer.image.extent = extent;
-
-    m_HdrBuffer.imageView = CreateImageView(m_HdrBuffer.image.image,
-        m_HdrBuffer.image.format,
-        VK_IMAGE_ASPECT_COLOR_BIT);
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
     samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -775,49 +1310,7 @@ void ResourceManager::CreateHdrBuffer(VkExtent2D extent)
 
 }
 
-void ResourceManager::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
-{
-    VkCommandBuffer commandBuffer = m_CommandManager->BeginSingleTimeCommands();
-
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-
-    region.imageOffset = { 0,0,0 };
-    region.imageExtent = {
-        width,
-        height,
-        1
-    };
-    vkCmdCopyBufferToImage(
-        commandBuffer,
-        buffer,
-        image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
-    );
-    m_CommandManager->EndSingleTimeCommands(commandBuffer);
-}
-
-void ResourceManager::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
-{
-    VkCommandBuffer commandBuffer = m_CommandManager->BeginSingleTimeCommands();
-
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    m_CommandManager->EndSingleTimeCommands(commandBuffer);
-}
-
-void ResourceManager::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void ResourceManager::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& allocation)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -829,21 +1322,10 @@ void ResourceManager::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
         throw std::runtime_error("failed to create vertex buffer!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(m_Device->GetDevice(), buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(m_Device->GetDevice(), &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
-    }
-    vkBindBufferMemory(m_Device->GetDevice(), buffer, bufferMemory, 0);
+    allocation = m_MemoryAllocator->AllocateBuffer(buffer, properties);
 }
 
-void ResourceManager::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, Image& image, VkDeviceMemory& imageMemory)
+void ResourceManager::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, Image& image, Allocation& allocation)
 {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -865,21 +1347,43 @@ void ResourceManager::CreateImage(uint32_t width, uint32_t height, VkFormat form
         throw std::runtime_error("failed to create image!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(m_Device->GetDevice(), image.image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-
     image.currentLayout = imageInfo.initialLayout;
 	image.format = format;
+    image.lastStage = VK_PIPELINE_STAGE_2_NONE;
+    image.lastAccess = VK_ACCESS_2_NONE;
+
+    allocation = m_MemoryAllocator->AllocateImage(image.image, properties);
+}
 
-    if (vkAllocateMemory(m_Device->GetDevice(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
+void ResourceManager::CreateAttachmentImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, Image& image, uint32_t mipLevels)
+{
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.flags = 0;
+
+    if (vkCreateImage(m_Device->GetDevice(), &imageInfo, nullptr, &image.image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create attachment image!");
     }
-    vkBindImageMemory(m_Device->GetDevice(), image.image, imageMemory, 0);
+
+    // memory is bound later by the transient allocator
+    image.currentLayout = imageInfo.initialLayout;
+    image.format = format;
+    image.mipLevels = mipLevels;
+    image.extent = { width, height };
+    image.lastStage = VK_PIPELINE_STAGE_2_NONE;
+    image.lastAccess = VK_ACCESS_2_NONE;
 }
 
 uint32_t ResourceManager::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
@@ -904,15 +1408,12 @@ void ResourceManager::CleanupGBuffer()
 
     vkDestroyImageView(m_Device->GetDevice(), m_GBuffer.albedoImageView, nullptr);
 	vkDestroyImage(m_Device->GetDevice(), m_GBuffer.albedo.image, nullptr);
-	vkFreeMemory(m_Device->GetDevice(), m_GBuffer.albedoImageMemory, nullptr);
 
 	vkDestroyImageView(m_Device->GetDevice(), m_GBuffer.normalImageView, nullptr);
 	vkDestroyImage(m_Device->GetDevice(), m_GBuffer.normal.image, nullptr);
-	vkFreeMemory(m_Device->GetDevice(), m_GBuffer.normalImageMemory, nullptr);
 
     vkDestroyImageView(m_Device->GetDevice(), m_GBuffer.pbrImageView, nullptr);
     vkDestroyImage(m_Device->GetDevice(), m_GBuffer.pbr.image, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), m_GBuffer.pbrImageMemory, nullptr);
 
     //the depth is done somewhere else
 }
@@ -920,17 +1421,31 @@ void ResourceManager::CleanupGBuffer()
 ResourceManager::ResourceManager(Device* device)
     : m_Device(device)
 {
+    m_MemoryAllocator = new MemoryAllocator(device);
+    m_TransientAllocator = new TransientAllocator(device, this);
+    m_UploadBatcher = new UploadBatcher(device, m_MemoryAllocator);
 }
 
 ResourceManager::~ResourceManager()
 {
+    // decodes still running on the pool own stb allocations, and uploads may still read the textures
+    DrainTextureDecodes(m_NextTextureUpload);
+    m_UploadBatcher->WaitIdle();
+
+    for (Texture* texture : { &m_DefaultTexture, &m_FlatNormalTexture }) {
+        vkDestroyImageView(m_Device->GetDevice(), texture->imageView, nullptr);
+        vkDestroySampler(m_Device->GetDevice(), texture->sampler, nullptr);
+        vkDestroyImage(m_Device->GetDevice(), texture->image.image, nullptr);
+        m_MemoryAllocator->Free(texture->imageAllocation);
+    }
+
 	for (auto& texture : m_Textures)
 	{
 		vkDestroyImageView(m_Device->GetDevice(), texture.imageView, nullptr);
 		vkDestroySampler(m_Device->GetDevice(), texture.sampler, nullptr);
 
         vkDestroyImage(m_Device->GetDevice(), texture.image.image, nullptr);
-        vkFreeMemory(m_Device->GetDevice(), texture.imageMemory, nullptr);
+        m_MemoryAllocator->Free(texture.imageAllocation);
 	}
 
     for (auto& texture : m_AlphaTextures)
@@ -939,40 +1454,72 @@ ResourceManager::~ResourceManager()
         vkDestroySampler(m_Device->GetDevice(), texture.sampler, nullptr);
 
         vkDestroyImage(m_Device->GetDevice(), texture.image.image, nullptr);
-        vkFreeMemory(m_Device->GetDevice(), texture.imageMemory, nullptr);
+        m_MemoryAllocator->Free(texture.imageAllocation);
     }
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		vkDestroyBuffer(m_Device->GetDevice(), m_UniformBuffers[i], nullptr);
-		vkFreeMemory(m_Device->GetDevice(), m_UniformBuffersMemory[i], nullptr);
+		m_MemoryAllocator->Free(m_UniformBuffersAllocation[i]);
+	}
+	for (size_t i = 0; i < m_InstanceBuffers.size(); i++) {
+		vkDestroyBuffer(m_Device->GetDevice(), m_InstanceBuffers[i], nullptr);
+		m_MemoryAllocator->Free(m_InstanceBuffersAllocation[i]);
+		vkDestroyBuffer(m_Device->GetDevice(), m_VisibleInstanceBuffers[i], nullptr);
+		m_MemoryAllocator->Free(m_VisibleInstanceBuffersAllocation[i]);
+	}
+	for (size_t i = 0; i < m_DrawCountBuffers.size(); i++) {
+		vkDestroyBuffer(m_Device->GetDevice(), m_DrawCountBuffers[i], nullptr);
+		m_MemoryAllocator->Free(m_DrawCountBuffersAllocation[i]);
+		vkDestroyBuffer(m_Device->GetDevice(), m_DrawCommandBuffers[i], nullptr);
+		m_MemoryAllocator->Free(m_DrawCommandBuffersAllocation[i]);
 	}
+	vkDestroyBuffer(m_Device->GetDevice(), m_InstanceVisibilityBuffer, nullptr);
+	m_MemoryAllocator->Free(m_InstanceVisibilityBufferAllocation);
 	vkDestroyDescriptorPool(m_Device->GetDevice(), m_DescriptorPool, nullptr);
 
-	vkDestroyBuffer(m_Device->GetDevice(), m_VertexBuffer, nullptr);
-	vkFreeMemory(m_Device->GetDevice(), m_VertexBufferMemory, nullptr);
+	vkDestroyBuffer(m_Device->GetDevice(), m_PositionBuffer, nullptr);
+	m_MemoryAllocator->Free(m_PositionBufferAllocation);
+	vkDestroyBuffer(m_Device->GetDevice(), m_TexCoordBuffer, nullptr);
+	m_MemoryAllocator->Free(m_TexCoordBufferAllocation);
+	vkDestroyBuffer(m_Device->GetDevice(), m_TangentFrameBuffer, nullptr);
+	m_MemoryAllocator->Free(m_TangentFrameBufferAllocation);
 
 	vkDestroyBuffer(m_Device->GetDevice(), m_IndexBuffer, nullptr);
-	vkFreeMemory(m_Device->GetDevice(), m_IndexBufferMemory, nullptr);
+	m_MemoryAllocator->Free(m_IndexBufferAllocation);
+	vkDestroyBuffer(m_Device->GetDevice(), m_Index16Buffer, nullptr);
+	m_MemoryAllocator->Free(m_Index16BufferAllocation);
+
+    vkDestroyBuffer(m_Device->GetDevice(), m_MeshletBuffer, nullptr);
+    m_MemoryAllocator->Free(m_MeshletBufferAllocation);
+    vkDestroyBuffer(m_Device->GetDevice(), m_MeshletVertexBuffer, nullptr);
+    m_MemoryAllocator->Free(m_MeshletVertexBufferAllocation);
+    vkDestroyBuffer(m_Device->GetDevice(), m_MeshletTriangleBuffer, nullptr);
+    m_MemoryAllocator->Free(m_MeshletTriangleBufferAllocation);
 
     vkDestroyBuffer(m_Device->GetDevice(), m_MaterialBuffer, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), m_MaterialBufferMemory, nullptr);
+    m_MemoryAllocator->Free(m_MaterialBufferAllocation);
+    vkDestroyBuffer(m_Device->GetDevice(), m_MeshDrawBuffer, nullptr);
+    m_MemoryAllocator->Free(m_MeshDrawBufferAllocation);
 
     vkDestroyBuffer(m_Device->GetDevice(), m_LightingBuffer, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), m_LightingBufferMemory, nullptr);
+    m_MemoryAllocator->Free(m_LightingBufferAllocation);
 
     CleanupGBuffer();
+    CleanupDepthPyramid();
 
     vkDestroySampler(m_Device->GetDevice(), m_HdrBuffer.sampler, nullptr);
     vkDestroyImageView(m_Device->GetDevice(), m_HdrBuffer.imageView, nullptr);
     vkDestroyImage(m_Device->GetDevice(), m_HdrBuffer.image.image, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), m_HdrBuffer.imageMemory, nullptr);
+
+    delete m_UploadBatcher;
+    delete m_TransientAllocator;
+    delete m_MemoryAllocator;
 }
 
 void ResourceManager::CleanDepth()
 {
     vkDestroyImageView(m_Device->GetDevice(), m_DepthImageView, nullptr);
     vkDestroyImage(m_Device->GetDevice(), m_DepthImage.image, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), m_DepthImageMemory, nullptr);
 }
 
 void ResourceManager::SetCommandManager(CommandManager* commandManager)
@@ -988,42 +1535,37 @@ void ResourceManager::Create(SwapChain* swapChain, PipelineManager* pipelineMana
 
     CreateHdrBuffer(swapChain->GetSwapChainExtent());
 
-    int textureAmount{ 0 };
+    CreateDepthPyramid(swapChain->GetSwapChainExtent());
 
-	// create texture here from the paths that the scene class has loaded
-	for (const auto& path : m_TexturePaths)
-	{
-		CreateTextureImage(path.first,path.second,m_Textures);
-        textureAmount++;
-	}
-    std::cout << textureAmount << " amount of textures loaded." << std::endl;
-
-    int alphaTextureAmount{ 0 };
-    for (const auto& path : m_AlphaTexturePaths)
-    {
-        // Create texture for alpha masking(duplicate cause this exists also in the normal texture paths)
-        CreateTextureImage(path.first, path.second,m_AlphaTextures);
-        alphaTextureAmount++;
-    }
-    std::cout << alphaTextureAmount << " alpha textures loaded." << std::endl;
+    AllocateTransientAttachments();
+    CreateAttachmentViews();
 
-	CreateTextureImageView(m_Textures);
-    CreateTextureSampler(m_Textures);
+    // Textures stream in over the first frames, until then their descriptors use placeholders
+    CreatePlaceholderTextures();
+    StartTextureStreaming();
 
-    CreateTextureImageView(m_AlphaTextures);
-    CreateTextureSampler(m_AlphaTextures);
+    // the pipelines were compiling on the worker threads in the meantime
+    pipelineManager->WaitForPipelines();
 
 	// scene class should have loaded the vertex and index data
 
-    CreateVertexPullingBuffer();
+    CreateVertexStreams();
     CreateMaterialBuffer();
 	CreateIndexBuffer();
+    CreateMeshletBuffers();
 	CreateUniformBuffers();
+    CreateInstanceBuffers();
+    CreateMeshDrawBuffer();
+    CreateDrawCommandBuffers();
     CreateLightingUniformBuffer();
 	CreateDescriptorPools();
     CreateDescriptorSets(pipelineManager);
     CreateLightingDescriptorSet(pipelineManager);
     CreateToneMappingDescriptorSet(pipelineManager);
+    CreateDepthPyramidDescriptorSet(pipelineManager);
+
+    // Nothing waits on the CPU here, the first frame's submit waits on this value instead
+    m_RequiredUploadValue = m_UploadBatcher->Flush();
 }
 
 void ResourceManager::CleanupDescriptorPool()
@@ -1034,13 +1576,14 @@ void ResourceManager::CleanupDescriptorPool()
     }
 }
 
-VkImageView ResourceManager::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,uint32_t mipLevel)
+VkImageView ResourceManager::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,uint32_t mipLevel, VkComponentMapping components)
 {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
     viewInfo.format = format;
+    viewInfo.components = components;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = 0;
     viewInfo.subresourceRange.levelCount = mipLevel;
@@ -1188,30 +1731,58 @@ void ResourceManager::TransitionImageLayoutInline(VkCommandBuffer commandBuffer,
     image.currentLayout = newLayout;
 }
 
-void ResourceManager::CreateVertexPullingBuffer() {
-    VkDeviceSize bufferSize = sizeof(Vertex) * m_Vertices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer,
-        stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(m_Device->GetDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, m_Vertices.data(), bufferSize);
-    vkUnmapMemory(m_Device->GetDevice(), stagingBufferMemory);
-
-    CreateBuffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_VertexBuffer,
-        m_VertexBufferMemory);
+void ResourceManager::CreateVertexStreams() {
+    const size_t vertexCount = m_Vertices.size();
+#ifdef COMPACT_VERTICES
+    // the shaders are built with the same define and read the CompactVertex words instead
+    std::vector<CompactVertex> compactVertices = VertexCompression::EncodeMeshes(m_Vertices, m_Meshes);
+    std::vector<glm::uvec2> positions(vertexCount);
+    std::vector<uint32_t> texCoords(vertexCount);
+    std::vector<glm::uvec2> tangentFrames(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i) {
+        positions[i] = glm::uvec2(compactVertices[i].positionXY, compactVertices[i].positionZ);
+        texCoords[i] = compactVertices[i].texCoord;
+        tangentFrames[i] = glm::uvec2(compactVertices[i].normal, compactVertices[i].tangent);
+    }
+#else
+    // tightly packed floats, a vec3 array would be padded to 16 bytes in std430
+    std::vector<float> positions(vertexCount * 3);
+    std::vector<glm::vec2> texCoords(vertexCount);
+    std::vector<float> tangentFrames(vertexCount * 9);
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const Vertex& vertex = m_Vertices[i];
+        for (int axis = 0; axis < 3; ++axis) {
+            positions[i * 3 + axis] = vertex.pos[axis];
+            tangentFrames[i * 9 + axis] = vertex.normal[axis];
+            tangentFrames[i * 9 + 3 + axis] = vertex.tangent[axis];
+            tangentFrames[i * 9 + 6 + axis] = vertex.bitTangent[axis];
+        }
+        texCoords[i] = vertex.texCoord;
+    }
+#endif
+
+    auto createStream = [this](const auto& stream, VkBuffer& buffer, Allocation& allocation) {
+        // buffers can't be empty, a scene without vertices still gets one element per stream
+        VkDeviceSize bufferSize = sizeof(stream[0]) * stream.size();
+        CreateBuffer(std::max<VkDeviceSize>(bufferSize, sizeof(stream[0])),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            buffer,
+            allocation);
+        if (!stream.empty()) {
+            m_UploadBatcher->UploadBuffer(buffer, stream.data(), bufferSize);
+        }
+        return bufferSize;
+    };
+    VkDeviceSize positionSize = createStream(positions, m_PositionBuffer, m_PositionBufferAllocation);
+    VkDeviceSize texCoordSize = createStream(texCoords, m_TexCoordBuffer, m_TexCoordBufferAllocation);
+    VkDeviceSize tangentFrameSize = createStream(tangentFrames, m_TangentFrameBuffer, m_TangentFrameBufferAllocation);
 
-    CopyBuffer(stagingBuffer, m_VertexBuffer, bufferSize);
+    std::cout << "Vertex streams: positions " << positionSize / 1024 << " KiB, texture coordinates " << texCoordSize / 1024
+        << " KiB, tangent frames " << tangentFrameSize / 1024 << " KiB (interleaved Vertex: " << sizeof(Vertex) * vertexCount / 1024 << " KiB)" << std::endl;
+}
 
-    vkDestroyBuffer(m_Device->GetDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), stagingBufferMemory, nullptr);
+void ResourceManager::AddModel(MeshHandle meshHandle)
+{
+    m_Meshes.push_back(meshHandle);
 }
\ No newline at end of file
@@ -9,6 +9,10 @@
 #include <array>
 #include <string>
 #include <iostream>
+#include <chrono>
+#include <future>
+#include <unordered_set>
+#include "MemoryAllocator.h"
 
 struct GpuMaterial {
     alignas(4) uint32_t baseColorTextureIndex;
@@ -61,16 +65,126 @@ struct UniformBufferObject {
     alignas(16) glm::vec3 CameraManagerPosition;
 };
 
-struct PushConstantData {
+// One placement of a mesh, std430 layout (set 0, binding 5). A mesh's instances are contiguous
+// starting at MeshHandle::firstInstance, so its visible ones are contiguous in the culled list too.
+struct MeshInstance {
     glm::mat4 model;
-    alignas(16) int meshIndex;
+    uint32_t meshIndex;
+    // into the material buffer, one material per imported mesh
+    uint32_t materialIndex;
+    uint32_t padding[2];
 };
+static_assert(sizeof(MeshInstance) == 80, "MeshInstance has to match the std430 layout in instance.glsl");
+
+// Cluster of at most MAX_MESHLET_VERTICES/MAX_MESHLET_TRIANGLES triangles, std430 layout.
+// The triangles are a contiguous range of the mesh's index buffer as well (MeshHandle::indexType,
+// indices relative to MeshHandle::vertexOffset), so a visible meshlet can be drawn as a plain
+// indexed draw. The micro index data (vertex list + packed local triangles) is
+// there for a mesh shader path.
+struct Meshlet {
+    // bounding sphere, mesh space
+    glm::vec3 center;
+    float radius;
+    // back facing when dot(normalize(coneApex - cameraPosition), coneAxis) >= coneCutoff,
+    // a zero axis never culls
+    glm::vec3 coneApex;
+    float coneCutoff;
+    glm::vec3 coneAxis;
+    uint32_t indexOffset;
+    uint32_t vertexOffset;   // into the meshlet vertex buffer, entries are scene vertex indices
+    uint32_t triangleOffset; // into the meshlet triangle buffer, 3 local 8 bit indices per uint
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+static_assert(sizeof(Meshlet) == 64, "Meshlet has to match the std430 layout in the shaders");
+
+constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+// Simplified index list of a mesh, indexing the same vertices as the full resolution one
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    // largest distance the surface moved, mesh space
+    float error;
+};
+
+constexpr uint32_t MAX_MESH_LODS = 4;
+
+// Per mesh data for the vertex shaders and the GPU culling, std430 layout (set 0, binding 7,
+// meshDraw.glsl). The vertex shaders find it through the instance's meshIndex, so draws need no
+// per mesh push constants.
+struct MeshDrawData {
+    // bounding sphere, mesh space
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+    // CompactVertex positions back to mesh space, unused with the full Vertex
+    glm::vec3 positionOffset;
+    uint32_t lodCount;
+    glm::vec3 positionScale;
+    uint32_t vertexOffset;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    // 1 when the mesh's indices are in the 16 bit index buffer
+    uint32_t index16;
+    uint32_t padding;
+    uint32_t lodIndexOffsets[MAX_MESH_LODS];
+    uint32_t lodIndexCounts[MAX_MESH_LODS];
+    float lodErrors[MAX_MESH_LODS];
+};
+static_assert(sizeof(MeshDrawData) == 112, "MeshDrawData has to match the std430 layout in meshDraw.glsl");
+
+// Push constants of the culling compute shaders (culling.glsl)
+struct CullPushConstants {
+    // world space, normalized, inside where dot(plane.xyz, p) + plane.w > 0
+    glm::vec4 frustumPlanes[6];
+    glm::vec3 cameraPosition;
+    // projected size of one unit at distance one
+    float pixelsPerUnit;
+    float lodErrorPixels;
+    uint32_t instanceCount;
+    uint32_t meshCount;
+    // 0 draws last frame's visible instances, 1 tests the rest against the depth pyramid
+    uint32_t phase;
+};
+static_assert(sizeof(CullPushConstants) == 128, "CullPushConstants has to fit the guaranteed push constant size");
+
+// Push constants of depthPyramid.comp, one dispatch per pyramid level
+struct DepthPyramidPushConstants {
+    // level written, level 0 reduces the depth image, every other level the one above
+    uint32_t level;
+};
+
+// Per frame draw count buffer of the GPU-driven path: the draw counts of the 16 and 32 bit index
+// buffer, followed by the visible instance count of every (mesh, LOD) pair
+constexpr uint32_t DRAW_COUNT_HEADER = 2;
+
+// The GPU-driven path culls twice per frame: the early phase draws the instances that were visible
+// last frame, the late phase tests everything else against the depth pyramid built from those
+// draws. Counts, commands and the visible list hold one region per phase.
+constexpr uint32_t CULL_PHASES = 2;
+// storage image descriptors of the depth pyramid build, enough for a 65535 texel wide depth buffer
+constexpr uint32_t MAX_DEPTH_PYRAMID_LEVELS = 16;
 
 struct MeshHandle {
+    // full resolution, the same range as lods[0]. Indices are relative to vertexOffset and index
+    // offsets point into the index buffer of indexType
     uint32_t indexOffset;
     uint32_t indexCount;
-    GpuMaterial material;
-	glm::mat4 modelMatrix;
+    VkIndexType indexType;
+    // the mesh's own vertices, no other mesh indexes them
+    uint32_t vertexOffset;
+    uint32_t vertexCount;
+    uint32_t meshletOffset;
+    uint32_t meshletCount;
+    MeshLod lods[MAX_MESH_LODS];
+    uint32_t lodCount;
+    // bounding sphere, mesh space
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+    // drawn as one instanced draw
+    uint32_t firstInstance;
+    uint32_t instanceCount;
 };
 
 struct Image {
@@ -79,6 +193,9 @@ struct Image {
 	VkFormat format;
     uint32_t mipLevels = 1;
     VkExtent2D extent;
+    // last stage/access that touched the image, used by the render graph as the source scope
+    VkPipelineStageFlags2 lastStage = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 lastAccess = VK_ACCESS_2_NONE;
 };
 struct GBuffer {
     // G-Buffer images
@@ -94,11 +211,6 @@ struct GBuffer {
     VkImageView pbrImageView;
     VkImageView depthImageView;
 
-    // Memory allocations
-    VkDeviceMemory albedoImageMemory;
-    VkDeviceMemory normalImageMemory;
-    VkDeviceMemory pbrImageMemory;
-
     // Sampler (can be shared)
     VkSampler sampler;
 };
@@ -107,7 +219,36 @@ struct Texture {
     VkImageView imageView;
     VkSampler sampler;
     Image image;
-    VkDeviceMemory imageMemory;
+    Allocation imageAllocation;
+    // baked textures store channels where they compress best, the view maps them back
+    VkComponentMapping swizzle{};
+};
+
+// CPU side result of decoding an image file. Either RGBA8 pixels owned by stb_image, or the
+// block compressed mip chain of a baked .ktx2 when compressedFormat is set.
+struct DecodedTexture {
+    std::string path;
+    int width = 0;
+    int height = 0;
+    unsigned char* pixels = nullptr;
+
+    VkFormat compressedFormat = VK_FORMAT_UNDEFINED;
+    std::vector<unsigned char> blocks;
+    // one per mip level, bufferOffset is relative to blocks
+    std::vector<VkBufferImageCopy> levels;
+    VkComponentMapping swizzle{};
+};
+
+// A texture that is decoded and uploaded after startup, its descriptor points at a placeholder
+// until the upload timeline reaches uploadValue
+struct StreamedTexture {
+    std::string path;
+    VkFormat format;
+    bool alpha;
+    uint32_t index;
+    std::future<DecodedTexture> decoded;
+    uint64_t uploadValue = 0;
+    bool resident = false;
 };
 
 struct LightingSSBO {
@@ -121,18 +262,34 @@ class Device;
 class SwapChain;
 class CommandManager;
 class PipelineManager;
+class RenderGraph;
+class TransientAllocator;
+class UploadBatcher;
 class ResourceManager
 {
 private:
 
-    void CreateTextureImage(const std::string& path, VkFormat format, std::vector<Texture>& textureContainer);
-    void GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
-    void CreateTextureImageView(std::vector<Texture>& textureContainer);
-    void CreateTextureSampler(std::vector<Texture>& textureContainer);
-    void CreateVertexBuffer();
+    void CreatePlaceholderTextures();
+    void StartTextureStreaming();
+    void SubmitTextureDecodes();
+    // waits for the decodes from first on that are still running and frees their pixels
+    void DrainTextureDecodes(size_t first);
+    void WriteStreamedTextureDescriptors(uint32_t currentFrame);
+    const Texture& GetBoundTexture(bool alpha, uint32_t index) const;
+    // loadBaked prefers the .ktx2 written by the TextureBaker tool over the source image
+    static DecodedTexture DecodeTexture(const std::string& path, bool loadBaked);
+    static bool LoadBakedTexture(const std::string& path, DecodedTexture& decoded);
+    // returns the upload timeline value at which the texture is resident
+    uint64_t UploadTexture(DecodedTexture& decoded, VkFormat format, Texture& texture);
+    void CreateTextureImageView(Texture& texture);
+    void CreateTextureSampler(Texture& texture);
     void CreateMaterialBuffer();
     void CreateIndexBuffer();
+    void CreateMeshletBuffers();
     void CreateUniformBuffers();
+    void CreateInstanceBuffers();
+    void CreateMeshDrawBuffer();
+    void CreateDrawCommandBuffers();
     void CreateLightingUniformBuffer();
     void CreateGBuffer(VkExtent2D extent);
     void CreateHdrBuffer(VkExtent2D extent);
@@ -141,36 +298,77 @@ private:
     void CreateToneMappingDescriptorSet(PipelineManager* pipelineManager);
     void CreateDescriptorPools();
     void CreateDepthResources(SwapChain* swapChain);
-
-
-
-    void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-    void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-    void CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, Image& image, VkDeviceMemory& imageMemory);
+    void CreateDepthPyramid(VkExtent2D extent);
+    void CreateDepthPyramidDescriptorSet(PipelineManager* pipelineManager);
+    // binds depth, G-buffer and HDR images into the transient heap, views are created afterwards
+    void AllocateTransientAttachments();
+    void CreateAttachmentViews();
+    void CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, Image& image, Allocation& allocation);
+    void CreateAttachmentImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, Image& image, uint32_t mipLevels = 1);
 
     void CleanupGBuffer();
+    void CleanupDepthPyramid();
     void CleanupDescriptorPool();
 
 	std::vector<Texture> m_Textures;
     std::vector<Texture> m_AlphaTextures;
 
-    VkBuffer m_VertexBuffer;
-    VkDeviceMemory m_VertexBufferMemory;
+    // de-interleaved vertex streams, the depth prepass only reads positions and texture coordinates
+    VkBuffer m_PositionBuffer;
+    Allocation m_PositionBufferAllocation;
+    VkBuffer m_TexCoordBuffer;
+    Allocation m_TexCoordBufferAllocation;
+    VkBuffer m_TangentFrameBuffer;
+    Allocation m_TangentFrameBufferAllocation;
 
     VkBuffer m_MaterialBuffer;
-    VkDeviceMemory m_MaterialBufferMemory;
+    Allocation m_MaterialBufferAllocation;
 
     VkBuffer m_LightingBuffer;
-    VkDeviceMemory m_LightingBufferMemory;
+    Allocation m_LightingBufferAllocation;
     void* m_LightingUniformBufferMapped;
 
-    VkBuffer m_IndexBuffer;
-    VkDeviceMemory m_IndexBufferMemory;
+    VkBuffer m_IndexBuffer = VK_NULL_HANDLE;
+    Allocation m_IndexBufferAllocation;
+    // meshes with at most 65536 vertices
+    VkBuffer m_Index16Buffer = VK_NULL_HANDLE;
+    Allocation m_Index16BufferAllocation;
+
+    VkBuffer m_MeshletBuffer;
+    Allocation m_MeshletBufferAllocation;
+    VkBuffer m_MeshletVertexBuffer;
+    Allocation m_MeshletVertexBufferAllocation;
+    VkBuffer m_MeshletTriangleBuffer;
+    Allocation m_MeshletTriangleBufferAllocation;
 
     std::vector<VkBuffer> m_UniformBuffers;
-    std::vector<VkDeviceMemory> m_UniformBuffersMemory;
+    std::vector<Allocation> m_UniformBuffersAllocation;
     std::vector<void*> m_UniformBuffersMapped;
 
+    // per frame in flight, host visible since transforms change from frame to frame
+    std::vector<VkBuffer> m_InstanceBuffers;
+    std::vector<Allocation> m_InstanceBuffersAllocation;
+    // m_InstanceVersion counts changes, a frame's buffer is current when its version matches
+    uint64_t m_InstanceVersion = 1;
+    std::vector<uint64_t> m_InstanceBufferVersions;
+    // host visible and written by the CPU culling, or device local and written by the culling
+    // compute pass with one range of instanceCount entries per LOD
+    std::vector<VkBuffer> m_VisibleInstanceBuffers;
+    std::vector<Allocation> m_VisibleInstanceBuffersAllocation;
+
+    VkBuffer m_MeshDrawBuffer;
+    Allocation m_MeshDrawBufferAllocation;
+    // per frame, filled by the culling compute pass and consumed by the indirect count draws.
+    // The command buffer holds GetMaxDrawCount() 16 bit draws, then as many 32 bit draws
+    std::vector<VkBuffer> m_DrawCountBuffers;
+    std::vector<Allocation> m_DrawCountBuffersAllocation;
+    std::vector<VkBuffer> m_DrawCommandBuffers;
+    std::vector<Allocation> m_DrawCommandBuffersAllocation;
+    // one uint per instance, set by the late culling phase when the instance passed the occlusion
+    // test, the next frame's early phase draws those. Shared by the frames in flight
+    VkBuffer m_InstanceVisibilityBuffer;
+    Allocation m_InstanceVisibilityBufferAllocation;
+
     VkDescriptorPool m_DescriptorPool;
     std::vector<VkDescriptorSet> m_UniversalDescriptorSets;
     std::vector<VkDescriptorSet> m_GBufferDescriptorSets;
@@ -180,14 +378,41 @@ private:
 
     VkDescriptorSet m_ToneMappingDescriptorSet;
 
+    VkDescriptorSet m_DepthPyramidDescriptorSet = VK_NULL_HANDLE;
+
 	Device* m_Device;
 	CommandManager* m_CommandManager;
+    RenderGraph* m_RenderGraph = nullptr;
+    TransientAllocator* m_TransientAllocator = nullptr;
+    UploadBatcher* m_UploadBatcher = nullptr;
+
+    // texture streaming, m_StreamedTextures holds the colour textures first, then the alpha textures
+    static constexpr VkDeviceSize TEXTURE_UPLOAD_BUDGET = 32ull * 1024 * 1024;
+    std::vector<StreamedTexture> m_StreamedTextures;
+    size_t m_NextTextureDecode = 0;
+    size_t m_NextTextureUpload = 0;
+    size_t m_NextTextureResident = 0;
+    // per frame in flight, streamed textures whose descriptor still has to be written
+    std::vector<std::vector<uint32_t>> m_PendingTextureWrites;
+    std::unordered_set<uint32_t> m_NormalTextureIndices;
+    Texture m_DefaultTexture{};
+    Texture m_FlatNormalTexture{};
+    std::chrono::high_resolution_clock::time_point m_StreamingStart;
+    // geometry and placeholders, every frame waits for this value on the GPU
+    uint64_t m_RequiredUploadValue = 0;
+    MemoryAllocator* m_MemoryAllocator = nullptr;
 
     Image m_DepthImage;
-    VkDeviceMemory m_DepthImageMemory;
     VkImageView m_DepthImageView;
 
-    std::vector<PushConstantData> m_PushConstants;
+    // farthest depth of the depth prepass per texel, every level halves the one above, level 0
+    // halves m_DepthImage. GPU-driven path only, m_DepthPyramid.image stays VK_NULL_HANDLE otherwise
+    Image m_DepthPyramid{};
+    VkImageView m_DepthPyramidView = VK_NULL_HANDLE;
+    // one per level, the build writes them as storage images
+    std::vector<VkImageView> m_DepthPyramidLevelViews;
+    VkSampler m_DepthPyramidSampler = VK_NULL_HANDLE;
+
     std::unordered_map<std::string, uint32_t> m_TextureLookup;
     std::vector <std::pair< std::string, VkFormat >> m_TexturePaths;
 
@@ -195,8 +420,14 @@ private:
     std::vector <std::pair< std::string, VkFormat >> m_AlphaTexturePaths;
 
     std::vector<MeshHandle> m_Meshes;
+    std::vector<GpuMaterial> m_Materials;
+    std::vector<MeshInstance> m_Instances;
     std::vector<Vertex> m_Vertices;
     std::vector<uint32_t> m_Indices;
+    std::vector<uint16_t> m_Indices16;
+    std::vector<Meshlet> m_Meshlets;
+    std::vector<uint32_t> m_MeshletVertices;
+    std::vector<uint32_t> m_MeshletTriangles;
     std::vector<LightingSSBO> m_Lights;
 
     GBuffer m_GBuffer;
@@ -215,11 +446,9 @@ public:
 
     VkDescriptorPool GetDescriptorPool() { return m_DescriptorPool; }
 
-    void AddModel(MeshHandle meshHandle,int meshIndex) { 
-		MeshHandle newMeshHandle = meshHandle;
-        m_Meshes.push_back(meshHandle);
-		m_PushConstants.push_back({ meshHandle.modelMatrix, meshIndex});
-    }
+    void AddModel(MeshHandle meshHandle);
+    void AddMaterial(const GpuMaterial& material) { m_Materials.push_back(material); }
+    void AddInstance(const MeshInstance& instance) { m_Instances.push_back(instance); }
     int AddTexture(const std::string path,VkFormat format) { 
         auto it = m_TextureLookup.find(path);
         if (it != m_TextureLookup.end()) {
@@ -245,27 +474,58 @@ public:
         return index;
     }
 
+    const std::vector<std::pair<std::string, VkFormat>>& GetTexturePaths() const { return m_TexturePaths; }
+    const std::vector<std::pair<std::string, VkFormat>>& GetAlphaTexturePaths() const { return m_AlphaTexturePaths; }
     int GetTextureAmount() const { return m_TexturePaths.size(); }
     int GetAlphaTextureAmount() const { return m_AlphaTexturePaths.size(); }
     void SetCommandManager(CommandManager* commandManager);
+    void SetRenderGraph(RenderGraph* renderGraph) { m_RenderGraph = renderGraph; }
 
     void Create(SwapChain* swapChain, PipelineManager* pipelineManager);
-    void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+    void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& allocation);
 
-	void SetModelMatrix(const glm::mat4& model,int index) {
-		m_PushConstants[index].model = model;
+	void SetInstanceTransform(uint32_t instance, const glm::mat4& model) {
+		m_Instances[instance].model = model;
+		++m_InstanceVersion;
 	}
+    // copies the instances into this frame's instance buffer if they changed since its last upload
+    void UpdateInstanceBuffer(uint32_t currentFrame);
+    // bumped by every instance change
+    uint64_t GetInstanceVersion() const { return m_InstanceVersion; }
+    // this frame's instance indices after culling, draws index it with gl_InstanceIndex
+    void UpdateVisibleInstanceBuffer(uint32_t currentFrame, const std::vector<uint32_t>& visibleInstances);
 
     void RecreateResources(SwapChain* pSwapchain,PipelineManager* pPipelineManager);
     
     std::vector<MeshHandle>& GetMeshes() { return m_Meshes; }
+    std::vector<GpuMaterial>& GetMaterials() { return m_Materials; }
+    std::vector<MeshInstance>& GetInstances() { return m_Instances; }
     std::vector<LightingSSBO>& GetLights() { return m_Lights; }
     void AddPointLight(glm::vec3 position, glm::vec3 color, float lumen, float lux);
     void AddDirectionalLight(glm::vec3 direction, glm::vec3 color, float lumen, float lux);
 	std::vector<void*> GetUniformBuffersMapped() { return m_UniformBuffersMapped;}
-	VkBuffer GetVertexBuffer() const { return m_VertexBuffer;}
+	VkBuffer GetPositionBuffer() const { return m_PositionBuffer; }
+    VkBuffer GetTexCoordBuffer() const { return m_TexCoordBuffer; }
+    VkBuffer GetTangentFrameBuffer() const { return m_TangentFrameBuffer; }
     VkBuffer GetMaterialBuffer() const { return m_MaterialBuffer;}
 	VkBuffer GetIndexBuffer() const { return m_IndexBuffer; }
+    VkBuffer GetIndex16Buffer() const { return m_Index16Buffer; }
+    VkBuffer GetIndexBuffer(VkIndexType indexType) const { return indexType == VK_INDEX_TYPE_UINT16 ? m_Index16Buffer : m_IndexBuffer; }
+    VkBuffer GetMeshletBuffer() const { return m_MeshletBuffer; }
+    VkBuffer GetVisibleInstanceBuffer(size_t frameIndex) const { return m_VisibleInstanceBuffers[frameIndex]; }
+    VkBuffer GetDrawCountBuffer(size_t frameIndex) const { return m_DrawCountBuffers[frameIndex]; }
+    VkBuffer GetDrawCommandBuffer(size_t frameIndex) const { return m_DrawCommandBuffers[frameIndex]; }
+    // per index type, one draw for every (mesh, LOD) pair at most
+    uint32_t GetMaxDrawCount() const { return static_cast<uint32_t>(m_Meshes.size()) * MAX_MESH_LODS; }
+    VkBuffer GetInstanceVisibilityBuffer() const { return m_InstanceVisibilityBuffer; }
+    VkBuffer GetMeshletVertexBuffer() const { return m_MeshletVertexBuffer; }
+    VkBuffer GetMeshletTriangleBuffer() const { return m_MeshletTriangleBuffer; }
+
+    // Uploads decoded textures and swaps placeholder descriptors for resident ones, called once
+    // per frame after that frame's fence has been waited on
+    void UpdateTextureStreaming(uint32_t currentFrame);
+    VkSemaphore GetUploadTimeline() const;
+    uint64_t GetRequiredUploadValue() const { return m_RequiredUploadValue; }
     VkDescriptorSet GetUniversalDescriptorSet(size_t frameIndex) const {
         return m_UniversalDescriptorSets[frameIndex];
     }
@@ -281,13 +541,18 @@ public:
 
     VkDescriptorSet& GetToneMappingDescriptorSet() { return m_ToneMappingDescriptorSet; }
 
-    std::vector<PushConstantData>& GetPushConstants() { return m_PushConstants; }
+    Image& GetDepthPyramid() { return m_DepthPyramid; }
+    VkDescriptorSet GetDepthPyramidDescriptorSet() const { return m_DepthPyramidDescriptorSet; }
 
 	std::vector<Vertex>& GetVertices() { return m_Vertices; }
 	std::vector<uint32_t>& GetIndices() { return m_Indices; }
+    std::vector<uint16_t>& GetIndices16() { return m_Indices16; }
+    std::vector<Meshlet>& GetMeshlets() { return m_Meshlets; }
+    std::vector<uint32_t>& GetMeshletVertices() { return m_MeshletVertices; }
+    std::vector<uint32_t>& GetMeshletTriangles() { return m_MeshletTriangles; }
 	VkImageView GetDepthImageView() const { return m_DepthImageView; }
     Image& GetDepthImage() { return m_DepthImage; }
-    VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1);
+    VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1, VkComponentMapping components = {});
     VkFormat FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     VkFormat FindDepthFormat();
     void TransitionImageLayout(Image& image, VkImageLayout newLayout, VkPipelineStageFlags2 srcStageMask,
@@ -299,7 +564,7 @@ public:
                                      VkPipelineStageFlags2 srcAccessMask,
                                      VkPipelineStageFlags2 dstStageMask,
                                      VkPipelineStageFlags2 dstAccessMask);
-    void CreateVertexPullingBuffer();
+    void CreateVertexStreams();
 
     bool HasAlphaTextures() { return !m_AlphaTextures.empty(); }
 
@@ -1,6 +1,23 @@
 #include "Scene.h"
+#include "SceneCache.h"
+#include "VertexWelder.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <queue>
+#include <unordered_map>
 #include <glm/gtc/type_ptr.hpp>
+#include "../../Common/ThreadPool.h"
+
+namespace {
+    size_t HashCombine(size_t seed, size_t value)
+    {
+        return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+    }
+}
 
 Scene::Scene(ResourceManager* resourceManager)
     : m_ResourceManager(resourceManager) {}
@@ -12,77 +29,273 @@ void Scene::LoadScene(const std::string& scenePath)
 
     std::vector<std::string> modelPaths = {/* list of model paths */ };
 
+    // warm start: the final geometry and texture tables straight from the baked cache
+    SceneCache sceneCache(scenePath, IMPORT_FLAGS);
+    if (sceneCache.Load(m_ResourceManager, m_SceneGraph)) {
+        return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
     m_ResourceManager->AddTexture("textures/error.png", VK_FORMAT_R8G8B8A8_SRGB);
 
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(scenePath,
-        aiProcess_Triangulate |
-        aiProcess_FlipUVs |
-        aiProcess_CalcTangentSpace
-
-        /* | aiProcess_RemoveRedundantMaterials */ );
+    const aiScene* scene = importer.ReadFile(scenePath, IMPORT_FLAGS);
 
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         throw std::runtime_error("ERROR::ASSIMP::" + std::string(importer.GetErrorString()));
     }
     std::cout << scenePath << std::endl;
-    LoadObjModel(scenePath, baseDir, scene);
+    std::vector<MeshReference> meshReferences = BuildSceneGraph(scene);
+    LoadObjModel(scenePath, baseDir, scene, meshReferences);
+
+    std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "Imported " << scenePath << " with Assimp in " << time.count() << " ms" << std::endl;
+    sceneCache.Save(m_ResourceManager, m_SceneGraph);
 }
 
-MeshHandle Scene::LoadObjModel(const std::string& modelPath, const std::filesystem::path& baseDir,const aiScene* scene)
+MeshHandle Scene::LoadObjModel(const std::string& modelPath, const std::filesystem::path& baseDir,const aiScene* scene,
+    std::vector<MeshReference> meshReferences)
 {
+    // Meshes are extracted and deduplicated in parallel into their own buffers
+    std::vector<std::future<ImportedMesh>> jobs;
+    jobs.reserve(scene->mNumMeshes);
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        jobs.push_back(ThreadPool::Instance().Submit([this, i, scene, &baseDir]() {
+            return LoadMeshData(i, scene->mMeshes[i], scene, baseDir);
+        }));
+    }
+
+    std::vector<ImportedMesh> importedMeshes;
+    importedMeshes.reserve(jobs.size());
+    for (auto& job : jobs) {
+        importedMeshes.push_back(job.get());
+    }
+
+    // A mesh with the same content as an earlier one (a copy under another name or material)
+    // reuses its geometry, so every geometry is stored once however often it is placed.
+    std::vector<uint32_t> meshGeometries(importedMeshes.size());
+    std::vector<size_t> geometryMeshes;
+    std::unordered_map<size_t, std::vector<uint32_t>> geometriesByHash;
+    for (size_t i = 0; i < importedMeshes.size(); ++i) {
+        const ImportedMesh& imported = importedMeshes[i];
+        std::vector<uint32_t>& candidates = geometriesByHash[imported.contentHash];
+        auto match = std::find_if(candidates.begin(), candidates.end(), [&](uint32_t geometry) {
+            const ImportedMesh& other = importedMeshes[geometryMeshes[geometry]];
+            return other.vertices == imported.vertices && other.indices == imported.indices;
+        });
+        if (match != candidates.end()) {
+            meshGeometries[i] = *match;
+            continue;
+        }
+        meshGeometries[i] = static_cast<uint32_t>(geometryMeshes.size());
+        candidates.push_back(meshGeometries[i]);
+        geometryMeshes.push_back(i);
+    }
+
+    // One material per imported mesh, texture indices are handed out here since they are numbered
+    // in first use order
+    uint32_t firstMaterial = static_cast<uint32_t>(m_ResourceManager->GetMaterials().size());
+    for (size_t i = 0; i < importedMeshes.size(); ++i) {
+        ResolveMaterial(importedMeshes[i]);
+        m_ResourceManager->AddMaterial(importedMeshes[i].material);
+        std::cout << "----------Mesh loaded: " << scene->mMeshes[i]->mName.C_Str() << " --------------" << std::endl;
+    }
+
+    // Instances are grouped by geometry so each geometry is one instanced draw, the scene graph
+    // places instance i with the node that referenced it
+    uint32_t firstMesh = static_cast<uint32_t>(m_ResourceManager->GetMeshes().size());
+    uint32_t instanceCount = static_cast<uint32_t>(m_ResourceManager->GetInstances().size());
+    std::stable_sort(meshReferences.begin(), meshReferences.end(), [&](const MeshReference& a, const MeshReference& b) {
+        return meshGeometries[a.meshIndex] < meshGeometries[b.meshIndex];
+    });
+    std::vector<uint32_t> geometryInstanceCounts(geometryMeshes.size(), 0);
+    std::vector<uint32_t> geometryFirstInstances(geometryMeshes.size(), instanceCount);
+    for (const MeshReference& reference : meshReferences) {
+        uint32_t geometry = meshGeometries[reference.meshIndex];
+        if (geometryInstanceCounts[geometry]++ == 0) {
+            geometryFirstInstances[geometry] = instanceCount;
+        }
+        MeshInstance instance{};
+        instance.model = m_SceneGraph.GetWorldTransform(reference.node);
+        instance.meshIndex = firstMesh + geometry;
+        instance.materialIndex = firstMaterial + reference.meshIndex;
+        m_ResourceManager->AddInstance(instance);
+        m_SceneGraph.AddInstance(reference.node);
+        ++instanceCount;
+    }
+
+    // Prefix sum over the per geometry sizes gives every geometry its place in the global arrays,
+    // in mesh order, so offsets don't depend on which job finished first.
+    std::vector<Vertex>& vertices = m_ResourceManager->GetVertices();
+    std::vector<uint32_t>& indices = m_ResourceManager->GetIndices();
+    std::vector<uint16_t>& indices16 = m_ResourceManager->GetIndices16();
+    std::vector<Meshlet>& meshlets = m_ResourceManager->GetMeshlets();
+    std::vector<uint32_t>& meshletVertices = m_ResourceManager->GetMeshletVertices();
+    std::vector<uint32_t>& meshletTriangles = m_ResourceManager->GetMeshletTriangles();
+    std::vector<uint32_t> vertexOffsets(geometryMeshes.size());
+    std::vector<uint32_t> meshletVertexOffsets(geometryMeshes.size());
+    std::vector<uint32_t> meshletTriangleOffsets(geometryMeshes.size());
+    uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+    uint32_t indexCount = static_cast<uint32_t>(indices.size());
+    uint32_t index16Count = static_cast<uint32_t>(indices16.size());
+    uint32_t meshletCount = static_cast<uint32_t>(meshlets.size());
+    uint32_t meshletVertexCount = static_cast<uint32_t>(meshletVertices.size());
+    uint32_t meshletTriangleCount = static_cast<uint32_t>(meshletTriangles.size());
+    uint64_t sharedVertexCount = 0;
     std::vector<MeshHandle> meshHandles;
+    MeshOptimizer::VertexCacheStats statsBefore;
+    MeshOptimizer::VertexCacheStats statsAfter;
+    std::array<uint64_t, MAX_MESH_LODS> lodTriangles{};
 
-    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[i];
+    for (size_t i = 0; i < importedMeshes.size(); ++i) {
+        if (geometryMeshes[meshGeometries[i]] != i) {
+            sharedVertexCount += importedMeshes[i].vertices.size();
+        }
+    }
 
-        MeshHandle meshHandle = LoadMeshData(i,mesh, scene, baseDir);
+    for (size_t geometry = 0; geometry < geometryMeshes.size(); ++geometry) {
+        ImportedMesh& imported = importedMeshes[geometryMeshes[geometry]];
+        vertexOffsets[geometry] = vertexCount;
+        imported.meshHandle.vertexOffset = vertexCount;
+        imported.meshHandle.vertexCount = static_cast<uint32_t>(imported.vertices.size());
+        vertexCount += static_cast<uint32_t>(imported.vertices.size());
+
+        // indices stay relative to the mesh's vertexOffset, so small meshes fit in 16 bits
+        bool use16BitIndices = imported.vertices.size() <= 65536;
+        uint32_t& typeIndexCount = use16BitIndices ? index16Count : indexCount;
+        imported.meshHandle.indexType = use16BitIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+        imported.meshHandle.indexOffset = typeIndexCount;
+        for (uint32_t lod = 0; lod < imported.meshHandle.lodCount; ++lod) {
+            imported.meshHandle.lods[lod].indexOffset += typeIndexCount;
+            lodTriangles[lod] += imported.meshHandle.lods[lod].indexCount / 3;
+        }
+        typeIndexCount += static_cast<uint32_t>(imported.indices.size());
+
+        imported.meshHandle.meshletOffset = meshletCount;
+        imported.meshHandle.meshletCount = static_cast<uint32_t>(imported.meshlets.size());
+        meshletVertexOffsets[geometry] = meshletVertexCount;
+        meshletTriangleOffsets[geometry] = meshletTriangleCount;
+        meshletCount += imported.meshHandle.meshletCount;
+        meshletVertexCount += static_cast<uint32_t>(imported.meshletVertices.size());
+        meshletTriangleCount += static_cast<uint32_t>(imported.meshletTriangles.size());
+
+        imported.meshHandle.firstInstance = geometryFirstInstances[geometry];
+        imported.meshHandle.instanceCount = geometryInstanceCounts[geometry];
+        m_ResourceManager->AddModel(imported.meshHandle);
+        meshHandles.push_back(imported.meshHandle);
+        statsBefore += imported.cacheStatsBefore;
+        statsAfter += imported.cacheStatsAfter;
+    }
 
-        m_ResourceManager->AddModel(meshHandle,i);
+    std::cout << "Instancing: " << importedMeshes.size() << " meshes, " << geometryMeshes.size() << " unique, "
+        << meshReferences.size() << " instances, " << sharedVertexCount << " vertices shared" << std::endl;
+    std::cout << "Vertex cache (" << MeshOptimizer::CACHE_SIZE << " entries) ACMR " << statsBefore.GetAcmr() << " -> " << statsAfter.GetAcmr()
+        << ", ATVR " << statsBefore.GetAtvr() << " -> " << statsAfter.GetAtvr() << std::endl;
+    std::cout << "LOD triangles:";
+    for (uint64_t triangles : lodTriangles) {
+        std::cout << " " << triangles;
+    }
+    std::cout << std::endl;
+
+    vertices.resize(vertexCount);
+    indices.resize(indexCount);
+    indices16.resize(index16Count);
+    meshlets.resize(meshletCount);
+    meshletVertices.resize(meshletVertexCount);
+    meshletTriangles.resize(meshletTriangleCount);
+
+    // the ranges don't overlap so the copies run in parallel as well
+    std::vector<std::future<void>> copyJobs;
+    copyJobs.reserve(geometryMeshes.size());
+    for (size_t geometry = 0; geometry < geometryMeshes.size(); ++geometry) {
+        copyJobs.push_back(ThreadPool::Instance().Submit([&, geometry]() {
+            const ImportedMesh& imported = importedMeshes[geometryMeshes[geometry]];
+            std::copy(imported.vertices.begin(), imported.vertices.end(), vertices.begin() + vertexOffsets[geometry]);
+            if (imported.meshHandle.indexType == VK_INDEX_TYPE_UINT16) {
+                std::transform(imported.indices.begin(), imported.indices.end(), indices16.begin() + imported.meshHandle.indexOffset,
+                    [](uint32_t index) { return static_cast<uint16_t>(index); });
+            }
+            else {
+                std::copy(imported.indices.begin(), imported.indices.end(), indices.begin() + imported.meshHandle.indexOffset);
+            }
 
-        meshHandles.push_back(meshHandle);
+            for (size_t j = 0; j < imported.meshlets.size(); ++j) {
+                Meshlet meshlet = imported.meshlets[j];
+                meshlet.indexOffset += imported.meshHandle.indexOffset;
+                meshlet.vertexOffset += meshletVertexOffsets[geometry];
+                meshlet.triangleOffset += meshletTriangleOffsets[geometry];
+                meshlets[imported.meshHandle.meshletOffset + j] = meshlet;
+            }
+            uint32_t* meshMeshletVertices = meshletVertices.data() + meshletVertexOffsets[geometry];
+            for (size_t j = 0; j < imported.meshletVertices.size(); ++j) {
+                meshMeshletVertices[j] = imported.meshletVertices[j] + vertexOffsets[geometry];
+            }
+            std::copy(imported.meshletTriangles.begin(), imported.meshletTriangles.end(), meshletTriangles.begin() + meshletTriangleOffsets[geometry]);
+        }));
+    }
+    for (auto& job : copyJobs) {
+        job.get();
     }
 
     return meshHandles.empty() ? MeshHandle{} : meshHandles[0];
 }
 
-const aiNode* Scene::FindMeshNode(const aiNode* node, unsigned int meshIndex)
+std::vector<MeshReference> Scene::BuildSceneGraph(const aiScene* scene)
 {
-    for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-        if (node->mMeshes[i] == meshIndex) return node;
+    m_SceneGraph.Clear();
+
+    // breadth first, so the graph gets its nodes parents first and level by level
+    std::vector<MeshReference> meshReferences;
+    std::vector<bool> referenced(scene->mNumMeshes, false);
+    std::queue<std::pair<const aiNode*, uint32_t>> pending;
+    pending.push({ scene->mRootNode, SceneGraph::NO_PARENT });
+    while (!pending.empty()) {
+        auto [node, parent] = pending.front();
+        pending.pop();
+
+        aiMatrix4x4 m = node->mTransformation;
+        uint32_t index = m_SceneGraph.AddNode(parent, glm::transpose(glm::make_mat4(&m.a1)));
+        for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+            meshReferences.push_back({ index, node->mMeshes[i] });
+            referenced[node->mMeshes[i]] = true;
+        }
+        for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+            pending.push({ node->mChildren[i], index });
+        }
     }
-    for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-        const aiNode* found = FindMeshNode(node->mChildren[i], meshIndex);
-        if (found) return found;
+
+    // meshes no node references stay at the root
+    for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+        if (!referenced[i]) {
+            meshReferences.push_back({ 0, i });
+        }
     }
-    return nullptr;
+    m_SceneGraph.UpdateWorldTransforms();
+    std::cout << "Scene graph: " << m_SceneGraph.GetNodeCount() << " nodes" << std::endl;
+    return meshReferences;
 }
 
-glm::mat4 Scene::GetWorldTransform(const aiNode* node)
+void Scene::Update()
 {
-    glm::mat4 transform(1.f);
-    while (node)
-    {
-        aiMatrix4x4 m = node->mTransformation;
-        glm::mat4 mat = glm::transpose(glm::make_mat4(&m.a1));
-        transform = mat * transform;
-        node = node->mParent;
+    if (!m_SceneGraph.UpdateWorldTransforms()) {
+        return;
+    }
+
+    // the instance buffers pick the new transforms up as each frame in flight comes around
+    const auto& instanceNodes = m_SceneGraph.GetInstanceNodes();
+    for (uint32_t i = 0; i < instanceNodes.size(); ++i) {
+        if (m_SceneGraph.IsChanged(instanceNodes[i])) {
+            m_ResourceManager->SetInstanceTransform(i, m_SceneGraph.GetWorldTransform(instanceNodes[i]));
+        }
     }
-    return transform;
 }
 
-MeshHandle Scene::LoadMeshData(unsigned int meshIndex, aiMesh* mesh, const aiScene* scene, const std::filesystem::path& baseDir)
+ImportedMesh Scene::LoadMeshData(unsigned int meshIndex, aiMesh* mesh, const aiScene* scene, const std::filesystem::path& baseDir)
 {
-    MeshHandle meshHandle{};
-    meshHandle.indexOffset = static_cast<uint32_t>(m_ResourceManager->GetIndices().size());
-    const aiNode* meshNode = FindMeshNode(scene->mRootNode,meshIndex);
-    if(meshNode)
-    meshHandle.modelMatrix = GetWorldTransform(meshNode);
-
-    meshHandle.modelMatrix = glm::mat4(1.0f);
-    const float* mat = glm::value_ptr(meshHandle.modelMatrix);
-    std::unordered_map<Vertex, uint32_t> uniqueVertices;
+    ImportedMesh imported{};
+    VertexWelder welder(mesh->mNumVertices, POSITION_WELD_EPSILON);
 
     // Process faces and vertices
     for (unsigned int f = 0; f < mesh->mNumFaces; f++) {
@@ -91,7 +304,7 @@ MeshHandle Scene::LoadMeshData(unsigned int meshIndex, aiMesh* mesh, const aiSce
             unsigned int vertexIndex = face.mIndices[idx];
 
             Vertex vertex{};
-            aiVector3D position = scene->mRootNode->mTransformation * mesh->mVertices[vertexIndex];
+            aiVector3D position = mesh->mVertices[vertexIndex];
 
             vertex.pos = { position.x,
                            position.y,
@@ -120,29 +333,35 @@ MeshHandle Scene::LoadMeshData(unsigned int meshIndex, aiMesh* mesh, const aiSce
                     mesh->mBitangents[vertexIndex].z)
                 : glm::vec3(0.0f);
 
-            if (uniqueVertices.count(vertex) == 0) {
-                uniqueVertices[vertex] = static_cast<uint32_t>(m_ResourceManager->GetVertices().size());
-                m_ResourceManager->GetVertices().push_back(vertex);
-            }
-
-            // Push back the index for this vertex into the global indices vector
-            m_ResourceManager->GetIndices().push_back(uniqueVertices[vertex]);
+            // local to this mesh, rebased when the meshes are merged
+            imported.indices.push_back(welder.Weld(vertex));
         }
     }
+    imported.vertices = std::move(welder.GetVertices());
 
-    meshHandle.indexCount = static_cast<uint32_t>(m_ResourceManager->GetIndices().size()) - meshHandle.indexOffset;
+    // cache, overdraw and fetch order, the result is what the scene cache stores
+    MeshOptimizer::Optimize(imported.vertices, imported.indices, imported.cacheStatsBefore, imported.cacheStatsAfter);
+    MeshOptimizer::BuildMeshlets(imported.vertices, imported.indices, imported.meshlets, imported.meshletVertices, imported.meshletTriangles);
+    BuildLods(imported);
 
-    // Load texture
-    if (mesh->mMaterialIndex >= 0) {
+    imported.contentHash = 0;
+    for (const Vertex& vertex : imported.vertices) {
+        imported.contentHash = HashCombine(imported.contentHash, std::hash<Vertex>()(vertex));
+    }
+    for (uint32_t index : imported.indices) {
+        imported.contentHash = HashCombine(imported.contentHash, index);
+    }
+
+    // Texture paths only, indices are resolved in mesh order by ResolveMaterial
+    if (mesh->mMaterialIndex < scene->mNumMaterials) {
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         aiString texPath;
         if (material->GetTexture(aiTextureType_DIFFUSE, 0, &texPath) == AI_SUCCESS) {
             std::filesystem::path texturePath = baseDir / texPath.C_Str();
-            texturePath = texturePath.lexically_normal();
-            meshHandle.material.baseColorTextureIndex = m_ResourceManager->AddTexture(texturePath.string(),VK_FORMAT_R8G8B8A8_SRGB);
+            imported.diffusePath = texturePath.lexically_normal().string();
 
-            meshHandle.material.hasAlphaMask = 0;
-            meshHandle.material.alphaCutoff = 0.5f;
+            imported.material.hasAlphaMask = 0;
+            imported.material.alphaCutoff = 0.5f;
 
             aiString alphaModeStr;
             if (material->Get("$mat.gltf.alphaMode",0,0, alphaModeStr)==AI_SUCCESS);// dont pass all textures to the depth buffer cause thats not necessary
@@ -150,39 +369,93 @@ MeshHandle Scene::LoadMeshData(unsigned int meshIndex, aiMesh* mesh, const aiSce
                 std::string alphaMode = alphaModeStr.C_Str();
 
                 if (alphaMode == "MASK") {
-                    meshHandle.material.hasAlphaMask = 1;
+                    imported.material.hasAlphaMask = 1;
 
                     float alphaCutoff = 0.5f;
                     if (material->Get("$mat.gltf.alphaCutoff", 0, 0, alphaCutoff) == AI_SUCCESS) {
-                        meshHandle.material.alphaCutoff = alphaCutoff;
+                        imported.material.alphaCutoff = alphaCutoff;
                     }
                 }
             }
-
-            if (meshHandle.material.hasAlphaMask) {
-                meshHandle.material.alphaTextureIndex = m_ResourceManager->AddAlphaTexture(texturePath.string(), VK_FORMAT_R8G8B8A8_SRGB);
-            }
-        }
-        else {
-            meshHandle.material.baseColorTextureIndex = 0;
         }
         if (material->GetTexture(aiTextureType_NORMALS, 0, &texPath) == AI_SUCCESS) {
             std::filesystem::path texturePath = baseDir / texPath.C_Str();
-            texturePath = texturePath.lexically_normal();
-            meshHandle.material.normalTextureIndex = m_ResourceManager->AddTexture(texturePath.string(),VK_FORMAT_R8G8B8A8_UNORM);
-        }
-        else {
-            meshHandle.material.normalTextureIndex = 0;
+            imported.normalPath = texturePath.lexically_normal().string();
         }
         if (material->GetTexture(aiTextureType_METALNESS, 0, &texPath) == AI_SUCCESS) {
             std::filesystem::path texturePath = baseDir / texPath.C_Str();
-            texturePath = texturePath.lexically_normal();
-            meshHandle.material.metallicRoughnessTextureIndex = m_ResourceManager->AddTexture(texturePath.string(), VK_FORMAT_R8G8B8A8_SRGB);
+            imported.metallicRoughnessPath = texturePath.lexically_normal().string();
         }
-        else {
-            meshHandle.material.metallicRoughnessTextureIndex = 0;
+    }
+    return imported;
+}
+
+void Scene::BuildLods(ImportedMesh& imported)
+{
+    MeshHandle& meshHandle = imported.meshHandle;
+    const std::vector<Vertex>& vertices = imported.vertices;
+
+    glm::vec3 minimum(FLT_MAX);
+    glm::vec3 maximum(-FLT_MAX);
+    for (const Vertex& vertex : vertices) {
+        minimum = glm::min(minimum, vertex.pos);
+        maximum = glm::max(maximum, vertex.pos);
+    }
+    meshHandle.boundsCenter = vertices.empty() ? glm::vec3(0.0f) : (minimum + maximum) * 0.5f;
+    meshHandle.boundsRadius = 0.0f;
+    for (const Vertex& vertex : vertices) {
+        meshHandle.boundsRadius = std::max(meshHandle.boundsRadius, glm::length(vertex.pos - meshHandle.boundsCenter));
+    }
+
+    meshHandle.indexCount = static_cast<uint32_t>(imported.indices.size());
+    meshHandle.lods[0] = { 0, meshHandle.indexCount, 0.0f };
+    meshHandle.lodCount = 1;
+
+    // Every level is simplified from the full resolution indices so its error is measured against
+    // the original surface. The levels are appended behind the full resolution indices.
+    const std::vector<uint32_t> fullIndices = imported.indices;
+    size_t targetIndexCount = fullIndices.size();
+    while (meshHandle.lodCount < MAX_MESH_LODS) {
+        const MeshLod& previous = meshHandle.lods[meshHandle.lodCount - 1];
+        targetIndexCount = static_cast<size_t>(targetIndexCount * LOD_REDUCTION) / 3 * 3;
+
+        float error = 0.0f;
+        std::vector<uint32_t> simplified = MeshOptimizer::Simplify(vertices, fullIndices, targetIndexCount,
+            meshHandle.boundsRadius * LOD_MAX_RELATIVE_ERROR, error);
+        // barely simpler than the previous level, not worth another draw range
+        if (simplified.empty() || simplified.size() > previous.indexCount * 0.85f) {
+            break;
         }
+
+        std::vector<uint32_t> clusters;
+        simplified = MeshOptimizer::OptimizeVertexCache(simplified, vertices.size(), clusters);
+
+        MeshLod& lod = meshHandle.lods[meshHandle.lodCount++];
+        lod.indexOffset = static_cast<uint32_t>(imported.indices.size());
+        lod.indexCount = static_cast<uint32_t>(simplified.size());
+        // selection expects the error to grow with the level
+        lod.error = std::max(error, previous.error);
+        imported.indices.insert(imported.indices.end(), simplified.begin(), simplified.end());
+    }
+}
+
+void Scene::ResolveMaterial(ImportedMesh& imported)
+{
+    GpuMaterial& material = imported.material;
+    material.baseColorTextureIndex = 0;
+    material.normalTextureIndex = 0;
+    material.metallicRoughnessTextureIndex = 0;
+
+    if (!imported.diffusePath.empty()) {
+        material.baseColorTextureIndex = m_ResourceManager->AddTexture(imported.diffusePath, VK_FORMAT_R8G8B8A8_SRGB);
+        if (material.hasAlphaMask) {
+            material.alphaTextureIndex = m_ResourceManager->AddAlphaTexture(imported.diffusePath, VK_FORMAT_R8G8B8A8_SRGB);
+        }
+    }
+    if (!imported.normalPath.empty()) {
+        material.normalTextureIndex = m_ResourceManager->AddTexture(imported.normalPath, VK_FORMAT_R8G8B8A8_UNORM);
+    }
+    if (!imported.metallicRoughnessPath.empty()) {
+        material.metallicRoughnessTextureIndex = m_ResourceManager->AddTexture(imported.metallicRoughnessPath, VK_FORMAT_R8G8B8A8_SRGB);
     }
-	std::cout << "----------Mesh loaded: " << mesh->mName.C_Str()<<" --------------" << std::endl;
-    return meshHandle;
 }
@@ -2,25 +2,79 @@
 #include <vector>
 #include <filesystem>
 #include "ResourceManager.h"
+#include "MeshOptimizer.h"
+#include "SceneGraph.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+// Result of importing one mesh on a worker thread. Indices are local to vertices, texture paths are
+// turned into indices afterwards so they are numbered the same no matter which job finishes first.
+struct ImportedMesh {
+    std::vector<Vertex> vertices;
+    // relative to the mesh's first vertex, also after the merge
+    std::vector<uint32_t> indices;
+    // offsets and vertex indices local to this mesh like the indices
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> meshletTriangles;
+    MeshHandle meshHandle;
+    GpuMaterial material;
+    // of vertices and indices, meshes with equal content share one geometry
+    size_t contentHash;
+    std::string diffusePath;
+    std::string normalPath;
+    std::string metallicRoughnessPath;
+    // post transform cache statistics before and after MeshOptimizer
+    MeshOptimizer::VertexCacheStats cacheStatsBefore;
+    MeshOptimizer::VertexCacheStats cacheStatsAfter;
+};
+
+// One node's use of an imported mesh, becomes one instance
+struct MeshReference {
+    uint32_t node;
+    unsigned int meshIndex;
+};
+
 class Scene {
 public:
     Scene(ResourceManager* resourceManager);
 
     void LoadScene(const std::string& scenePath);
 
-    MeshHandle LoadObjModel(const std::string& modelPath, const std::filesystem::path& baseDir,const aiScene* scene);
+    // meshReferences from BuildSceneGraph, every reference becomes an instance of its mesh's geometry
+    MeshHandle LoadObjModel(const std::string& modelPath, const std::filesystem::path& baseDir,const aiScene* scene,
+        std::vector<MeshReference> meshReferences);
+
+    // flattens the aiNode hierarchy into m_SceneGraph and returns every node's mesh references,
+    // meshes no node references are placed at the root
+    std::vector<MeshReference> BuildSceneGraph(const aiScene* scene);
 
-    const aiNode* FindMeshNode(const aiNode* node, unsigned int meshIndex);
+    // once per frame: world matrices of moved nodes into the transforms of their instances
+    void Update();
 
-    glm::mat4 GetWorldTransform(const aiNode* node);
+    SceneGraph& GetSceneGraph() { return m_SceneGraph; }
 
-    MeshHandle LoadMeshData(unsigned int meshIndex, aiMesh* mesh, const aiScene* scene, const std::filesystem::path& baseDir);
+    // thread safe, only reads the aiScene
+    ImportedMesh LoadMeshData(unsigned int meshIndex, aiMesh* mesh, const aiScene* scene, const std::filesystem::path& baseDir);
+
+    void ResolveMaterial(ImportedMesh& imported);
+
+    // bounding sphere and LOD chain, appends the simplified index lists to imported.indices
+    void BuildLods(ImportedMesh& imported);
 
 private:
+    // part of the scene cache key, changing them invalidates the cache
+    static constexpr unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace
+        /* | aiProcess_RemoveRedundantMaterials */;
+    // 0 welds exact duplicates only, changes the imported geometry so bump SceneCache::VERSION with it
+    static constexpr float POSITION_WELD_EPSILON = 0.0f;
+    // every LOD aims for this fraction of the previous one's triangles, with the surface moving
+    // at most LOD_MAX_RELATIVE_ERROR of the mesh radius. Bump SceneCache::VERSION with them
+    static constexpr float LOD_REDUCTION = 0.5f;
+    static constexpr float LOD_MAX_RELATIVE_ERROR = 0.1f;
+
     ResourceManager* m_ResourceManager;
+    SceneGraph m_SceneGraph;
 
 };
\ No newline at end of file
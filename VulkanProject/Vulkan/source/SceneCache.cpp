@@ -0,0 +1,421 @@
+#include "SceneCache.h"
+#include "ResourceManager.h"
+#include "SceneGraph.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+	constexpr char MAGIC[8] = { 'V', 'K', 'S', 'C', 'E', 'N', 'E', '\0' };
+
+	struct CacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t vertexStride;
+		uint32_t meshStride;
+		uint32_t meshletStride;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t index16Count;
+		uint32_t meshCount;
+		uint32_t materialCount;
+		uint32_t instanceCount;
+		uint32_t meshletCount;
+		uint32_t meshletVertexCount;
+		uint32_t meshletTriangleCount;
+		uint32_t nodeCount;
+		uint32_t texturePathCount;
+		uint32_t alphaTexturePathCount;
+		uint64_t key;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t index16Offset;
+		uint64_t meshOffset;
+		uint64_t meshletOffset;
+		uint64_t meshletVertexOffset;
+		uint64_t meshletTriangleOffset;
+		uint64_t nodeParentOffset;
+		uint64_t nodeTransformOffset;
+		uint64_t materialOffset;
+		uint64_t instanceOffset;
+		uint64_t instanceNodeOffset;
+		uint64_t stringOffset;
+		uint64_t fileSize;
+	};
+
+	// Texture path tables are stored as { format, length } followed by the path bytes
+	struct PathEntry {
+		uint32_t format;
+		uint32_t length;
+	};
+
+	// Read only mapping of a whole file
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::string& path)
+		{
+#ifdef _WIN32
+			m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (m_File == INVALID_HANDLE_VALUE) {
+				return;
+			}
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0) {
+				return;
+			}
+			m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!m_Mapping) {
+				return;
+			}
+			m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+			m_Size = m_Data ? static_cast<size_t>(size.QuadPart) : 0;
+#else
+			m_File = open(path.c_str(), O_RDONLY);
+			if (m_File < 0) {
+				return;
+			}
+			struct stat info;
+			if (fstat(m_File, &info) != 0 || info.st_size == 0) {
+				return;
+			}
+			void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, m_File, 0);
+			if (data == MAP_FAILED) {
+				return;
+			}
+			m_Data = static_cast<const uint8_t*>(data);
+			m_Size = static_cast<size_t>(info.st_size);
+#endif
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if (m_Data) UnmapViewOfFile(m_Data);
+			if (m_Mapping) CloseHandle(m_Mapping);
+			if (m_File != INVALID_HANDLE_VALUE) CloseHandle(m_File);
+#else
+			if (m_Data) munmap(const_cast<uint8_t*>(m_Data), m_Size);
+			if (m_File >= 0) close(m_File);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const uint8_t* GetData() const { return m_Data; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+#ifdef _WIN32
+		HANDLE m_File = INVALID_HANDLE_VALUE;
+		HANDLE m_Mapping = nullptr;
+#else
+		int m_File = -1;
+#endif
+		const uint8_t* m_Data = nullptr;
+		size_t m_Size = 0;
+	};
+
+	constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+	constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+	uint64_t Fnv1a(const void* data, size_t size, uint64_t hash)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ bytes[i]) * FNV_PRIME;
+		}
+		return hash;
+	}
+
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + 15) & ~uint64_t(15);
+	}
+}
+
+SceneCache::SceneCache(const std::string& scenePath, unsigned int importFlags) :
+	m_CachePath(scenePath + ".cache"),
+	m_Key(ComputeKey(scenePath, importFlags))
+{
+}
+
+uint64_t SceneCache::ComputeKey(const std::string& scenePath, unsigned int importFlags)
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+	hash = Fnv1a(&VERSION, sizeof(VERSION), hash);
+	hash = Fnv1a(&importFlags, sizeof(importFlags), hash);
+
+	// materials of an .obj come from the .mtl next to it, an edit there has to invalidate as well
+	std::string materialPath = std::filesystem::path(scenePath).replace_extension(".mtl").string();
+	for (const std::string& path : { scenePath, materialPath }) {
+		MappedFile file(path);
+		uint64_t size = file.GetSize();
+		hash = Fnv1a(&size, sizeof(size), hash);
+		if (file.GetData()) {
+			hash = Fnv1a(file.GetData(), file.GetSize(), hash);
+		}
+	}
+	return hash;
+}
+
+bool SceneCache::Load(ResourceManager* resourceManager, SceneGraph& sceneGraph) const
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	MappedFile file(m_CachePath);
+	if (!file.GetData()) {
+		return false;
+	}
+
+	CacheHeader header{};
+	if (file.GetSize() < sizeof(header)) {
+		std::cerr << "Scene cache " << m_CachePath << " is truncated, rebuilding" << std::endl;
+		return false;
+	}
+	memcpy(&header, file.GetData(), sizeof(header));
+
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+		header.vertexStride != sizeof(Vertex) || header.meshStride != sizeof(MeshHandle) ||
+		header.meshletStride != sizeof(Meshlet)) {
+		std::cout << "Scene cache " << m_CachePath << " has an old layout, rebuilding" << std::endl;
+		return false;
+	}
+	if (header.key != m_Key) {
+		std::cout << "Scene cache " << m_CachePath << " is stale, rebuilding" << std::endl;
+		return false;
+	}
+	if (header.fileSize != file.GetSize() ||
+		header.vertexOffset + uint64_t(header.vertexCount) * sizeof(Vertex) > file.GetSize() ||
+		header.indexOffset + uint64_t(header.indexCount) * sizeof(uint32_t) > file.GetSize() ||
+		header.index16Offset + uint64_t(header.index16Count) * sizeof(uint16_t) > file.GetSize() ||
+		header.meshOffset + uint64_t(header.meshCount) * sizeof(MeshHandle) > file.GetSize() ||
+		header.meshletOffset + uint64_t(header.meshletCount) * sizeof(Meshlet) > file.GetSize() ||
+		header.meshletVertexOffset + uint64_t(header.meshletVertexCount) * sizeof(uint32_t) > file.GetSize() ||
+		header.meshletTriangleOffset + uint64_t(header.meshletTriangleCount) * sizeof(uint32_t) > file.GetSize() ||
+		header.nodeParentOffset + uint64_t(header.nodeCount) * sizeof(uint32_t) > file.GetSize() ||
+		header.nodeTransformOffset + uint64_t(header.nodeCount) * sizeof(glm::mat4) > file.GetSize() ||
+		header.materialOffset + uint64_t(header.materialCount) * sizeof(GpuMaterial) > file.GetSize() ||
+		header.instanceOffset + uint64_t(header.instanceCount) * sizeof(MeshInstance) > file.GetSize() ||
+		header.instanceNodeOffset + uint64_t(header.instanceCount) * sizeof(uint32_t) > file.GetSize() ||
+		header.stringOffset > file.GetSize()) {
+		std::cerr << "Scene cache " << m_CachePath << " is damaged, rebuilding" << std::endl;
+		return false;
+	}
+
+	// the path tables are validated before anything is handed to the resource manager
+	std::vector<std::pair<std::string, VkFormat>> texturePaths;
+	std::vector<std::pair<std::string, VkFormat>> alphaTexturePaths;
+	uint64_t offset = header.stringOffset;
+	for (uint32_t i = 0; i < header.texturePathCount + header.alphaTexturePathCount; ++i) {
+		PathEntry entry;
+		if (offset + sizeof(entry) > file.GetSize()) {
+			std::cerr << "Scene cache " << m_CachePath << " is damaged, rebuilding" << std::endl;
+			return false;
+		}
+		memcpy(&entry, file.GetData() + offset, sizeof(entry));
+		offset += sizeof(entry);
+		if (offset + entry.length > file.GetSize()) {
+			std::cerr << "Scene cache " << m_CachePath << " is damaged, rebuilding" << std::endl;
+			return false;
+		}
+
+		auto& table = i < header.texturePathCount ? texturePaths : alphaTexturePaths;
+		table.push_back({ std::string(reinterpret_cast<const char*>(file.GetData() + offset), entry.length), static_cast<VkFormat>(entry.format) });
+		offset += entry.length;
+	}
+
+	// the graph rejects nodes that are not in breadth first order, instances are checked alongside
+	const uint32_t* nodeParents = reinterpret_cast<const uint32_t*>(file.GetData() + header.nodeParentOffset);
+	const uint32_t* instanceNodes = reinterpret_cast<const uint32_t*>(file.GetData() + header.instanceNodeOffset);
+	try {
+		sceneGraph.Clear();
+		for (uint32_t i = 0; i < header.nodeCount; ++i) {
+			glm::mat4 localTransform;
+			memcpy(&localTransform, file.GetData() + header.nodeTransformOffset + uint64_t(i) * sizeof(glm::mat4), sizeof(glm::mat4));
+			sceneGraph.AddNode(nodeParents[i], localTransform);
+		}
+		for (uint32_t i = 0; i < header.instanceCount; ++i) {
+			if (instanceNodes[i] >= header.nodeCount) {
+				throw std::runtime_error("instance node out of range!");
+			}
+			// culling and the shaders index the mesh and material arrays with these unchecked
+			MeshInstance instance;
+			memcpy(&instance, file.GetData() + header.instanceOffset + uint64_t(i) * sizeof(MeshInstance), sizeof(MeshInstance));
+			if (instance.meshIndex >= header.meshCount || instance.materialIndex >= header.materialCount) {
+				throw std::runtime_error("instance mesh or material out of range!");
+			}
+			sceneGraph.AddInstance(instanceNodes[i]);
+		}
+	}
+	catch (const std::runtime_error&) {
+		sceneGraph.Clear();
+		std::cerr << "Scene cache " << m_CachePath << " is damaged, rebuilding" << std::endl;
+		return false;
+	}
+	sceneGraph.UpdateWorldTransforms();
+
+	// both tables hold unique paths in index order, so re-adding them reproduces the same indices
+	for (const auto& path : texturePaths) {
+		resourceManager->AddTexture(path.first, path.second);
+	}
+	for (const auto& path : alphaTexturePaths) {
+		resourceManager->AddAlphaTexture(path.first, path.second);
+	}
+
+	const Vertex* vertices = reinterpret_cast<const Vertex*>(file.GetData() + header.vertexOffset);
+	const uint32_t* indices = reinterpret_cast<const uint32_t*>(file.GetData() + header.indexOffset);
+	const uint16_t* indices16 = reinterpret_cast<const uint16_t*>(file.GetData() + header.index16Offset);
+	resourceManager->GetVertices().assign(vertices, vertices + header.vertexCount);
+	resourceManager->GetIndices().assign(indices, indices + header.indexCount);
+	resourceManager->GetIndices16().assign(indices16, indices16 + header.index16Count);
+
+	const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(file.GetData() + header.meshletOffset);
+	const uint32_t* meshletVertices = reinterpret_cast<const uint32_t*>(file.GetData() + header.meshletVertexOffset);
+	const uint32_t* meshletTriangles = reinterpret_cast<const uint32_t*>(file.GetData() + header.meshletTriangleOffset);
+	resourceManager->GetMeshlets().assign(meshlets, meshlets + header.meshletCount);
+	resourceManager->GetMeshletVertices().assign(meshletVertices, meshletVertices + header.meshletVertexCount);
+	resourceManager->GetMeshletTriangles().assign(meshletTriangles, meshletTriangles + header.meshletTriangleCount);
+
+	for (uint32_t i = 0; i < header.meshCount; ++i) {
+		MeshHandle meshHandle;
+		memcpy(&meshHandle, file.GetData() + header.meshOffset + uint64_t(i) * sizeof(MeshHandle), sizeof(MeshHandle));
+		resourceManager->AddModel(meshHandle);
+	}
+	const GpuMaterial* materials = reinterpret_cast<const GpuMaterial*>(file.GetData() + header.materialOffset);
+	resourceManager->GetMaterials().assign(materials, materials + header.materialCount);
+	for (uint32_t i = 0; i < header.instanceCount; ++i) {
+		MeshInstance instance;
+		memcpy(&instance, file.GetData() + header.instanceOffset + uint64_t(i) * sizeof(MeshInstance), sizeof(MeshInstance));
+		resourceManager->AddInstance(instance);
+	}
+
+	std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "Loaded scene cache " << m_CachePath << ": " << header.meshCount << " meshes, " << header.instanceCount << " instances, " << header.vertexCount
+		<< " vertices, " << header.indexCount + header.index16Count << " indices in " << time.count() << " ms" << std::endl;
+	return true;
+}
+
+void SceneCache::Save(ResourceManager* resourceManager, const SceneGraph& sceneGraph) const
+{
+	const auto& vertices = resourceManager->GetVertices();
+	const auto& indices = resourceManager->GetIndices();
+	const auto& indices16 = resourceManager->GetIndices16();
+	const auto& meshes = resourceManager->GetMeshes();
+	const auto& meshlets = resourceManager->GetMeshlets();
+	const auto& meshletVertices = resourceManager->GetMeshletVertices();
+	const auto& meshletTriangles = resourceManager->GetMeshletTriangles();
+	const auto& texturePaths = resourceManager->GetTexturePaths();
+	const auto& alphaTexturePaths = resourceManager->GetAlphaTexturePaths();
+	const auto& nodeParents = sceneGraph.GetParents();
+	const auto& nodeTransforms = sceneGraph.GetLocalTransforms();
+	const auto& materials = resourceManager->GetMaterials();
+	const auto& instances = resourceManager->GetInstances();
+	const auto& instanceNodes = sceneGraph.GetInstanceNodes();
+	if (instanceNodes.size() != instances.size()) {
+		std::cerr << "Scene graph does not place every instance, not writing the scene cache" << std::endl;
+		return;
+	}
+
+	CacheHeader header{};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.meshStride = sizeof(MeshHandle);
+	header.meshletStride = sizeof(Meshlet);
+	header.vertexCount = static_cast<uint32_t>(vertices.size());
+	header.indexCount = static_cast<uint32_t>(indices.size());
+	header.index16Count = static_cast<uint32_t>(indices16.size());
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+	header.materialCount = static_cast<uint32_t>(materials.size());
+	header.instanceCount = static_cast<uint32_t>(instances.size());
+	header.meshletCount = static_cast<uint32_t>(meshlets.size());
+	header.meshletVertexCount = static_cast<uint32_t>(meshletVertices.size());
+	header.meshletTriangleCount = static_cast<uint32_t>(meshletTriangles.size());
+	header.nodeCount = static_cast<uint32_t>(nodeParents.size());
+	header.texturePathCount = static_cast<uint32_t>(texturePaths.size());
+	header.alphaTexturePathCount = static_cast<uint32_t>(alphaTexturePaths.size());
+	header.key = m_Key;
+
+	// arrays are 16 byte aligned in the file, so they are aligned in the mapping as well
+	header.vertexOffset = AlignOffset(sizeof(header));
+	header.indexOffset = AlignOffset(header.vertexOffset + vertices.size() * sizeof(Vertex));
+	header.index16Offset = AlignOffset(header.indexOffset + indices.size() * sizeof(uint32_t));
+	header.meshOffset = AlignOffset(header.index16Offset + indices16.size() * sizeof(uint16_t));
+	header.meshletOffset = AlignOffset(header.meshOffset + meshes.size() * sizeof(MeshHandle));
+	header.meshletVertexOffset = AlignOffset(header.meshletOffset + meshlets.size() * sizeof(Meshlet));
+	header.meshletTriangleOffset = AlignOffset(header.meshletVertexOffset + meshletVertices.size() * sizeof(uint32_t));
+	header.nodeParentOffset = AlignOffset(header.meshletTriangleOffset + meshletTriangles.size() * sizeof(uint32_t));
+	header.nodeTransformOffset = AlignOffset(header.nodeParentOffset + nodeParents.size() * sizeof(uint32_t));
+	header.materialOffset = AlignOffset(header.nodeTransformOffset + nodeTransforms.size() * sizeof(glm::mat4));
+	header.instanceOffset = AlignOffset(header.materialOffset + materials.size() * sizeof(GpuMaterial));
+	header.instanceNodeOffset = AlignOffset(header.instanceOffset + instances.size() * sizeof(MeshInstance));
+	header.stringOffset = AlignOffset(header.instanceNodeOffset + instanceNodes.size() * sizeof(uint32_t));
+
+	std::vector<uint8_t> strings;
+	for (const auto* table : { &texturePaths, &alphaTexturePaths }) {
+		for (const auto& path : *table) {
+			PathEntry entry{ static_cast<uint32_t>(path.second), static_cast<uint32_t>(path.first.size()) };
+			const uint8_t* entryBytes = reinterpret_cast<const uint8_t*>(&entry);
+			strings.insert(strings.end(), entryBytes, entryBytes + sizeof(entry));
+			strings.insert(strings.end(), path.first.begin(), path.first.end());
+		}
+	}
+	header.fileSize = header.stringOffset + strings.size();
+
+	std::vector<uint8_t> data(header.fileSize, 0);
+	memcpy(data.data(), &header, sizeof(header));
+	memcpy(data.data() + header.vertexOffset, vertices.data(), vertices.size() * sizeof(Vertex));
+	memcpy(data.data() + header.indexOffset, indices.data(), indices.size() * sizeof(uint32_t));
+	memcpy(data.data() + header.index16Offset, indices16.data(), indices16.size() * sizeof(uint16_t));
+	memcpy(data.data() + header.meshOffset, meshes.data(), meshes.size() * sizeof(MeshHandle));
+	memcpy(data.data() + header.meshletOffset, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+	memcpy(data.data() + header.meshletVertexOffset, meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t));
+	memcpy(data.data() + header.meshletTriangleOffset, meshletTriangles.data(), meshletTriangles.size() * sizeof(uint32_t));
+	memcpy(data.data() + header.nodeParentOffset, nodeParents.data(), nodeParents.size() * sizeof(uint32_t));
+	memcpy(data.data() + header.nodeTransformOffset, nodeTransforms.data(), nodeTransforms.size() * sizeof(glm::mat4));
+	memcpy(data.data() + header.materialOffset, materials.data(), materials.size() * sizeof(GpuMaterial));
+	memcpy(data.data() + header.instanceOffset, instances.data(), instances.size() * sizeof(MeshInstance));
+	memcpy(data.data() + header.instanceNodeOffset, instanceNodes.data(), instanceNodes.size() * sizeof(uint32_t));
+	memcpy(data.data() + header.stringOffset, strings.data(), strings.size());
+
+	// Write to a temporary file first so a crash never leaves a half written cache behind
+	std::string tempPath = m_CachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "Failed to open scene cache file for writing: " << tempPath << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!file) {
+			std::cerr << "Failed to write scene cache: " << tempPath << std::endl;
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, m_CachePath, error);
+	if (error) {
+		std::cerr << "Failed to replace scene cache " << m_CachePath << ": " << error.message() << std::endl;
+		std::filesystem::remove(tempPath, error);
+		return;
+	}
+	std::cout << "Saved scene cache " << m_CachePath << " (" << data.size() / 1024 << " KB)" << std::endl;
+}
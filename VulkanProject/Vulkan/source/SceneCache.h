@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+class ResourceManager;
+class SceneGraph;
+
+// Binary snapshot of everything Scene::LoadScene hands to the ResourceManager: the final vertex
+// and index arrays, mesh handles, materials, instances, the scene graph and both texture path
+// tables. It lives next to the scene file and is keyed by a hash of the source (and its .mtl)
+// plus the import flags, so a warm start is one mapped read instead of an Assimp import.
+class SceneCache
+{
+public:
+	SceneCache(const std::string& scenePath, unsigned int importFlags);
+
+	// Fills the resource manager and scene graph from the cache, false when it is missing, stale
+	// or damaged
+	bool Load(ResourceManager* resourceManager, SceneGraph& sceneGraph) const;
+	void Save(ResourceManager* resourceManager, const SceneGraph& sceneGraph) const;
+
+private:
+	// bump whenever the layout of the file or of Vertex/MeshHandle changes
+	static constexpr uint32_t VERSION = 9;
+
+	static uint64_t ComputeKey(const std::string& scenePath, unsigned int importFlags);
+
+	std::string m_CachePath;
+	uint64_t m_Key;
+};
@@ -0,0 +1,113 @@
+#include "SceneGraph.h"
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+#include "../../Common/ThreadPool.h"
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const glm::mat4& localTransform)
+{
+	uint32_t node = GetNodeCount();
+	if (parent == NO_PARENT) {
+		if (node != 0) {
+			throw std::runtime_error("scene graph can only have one root node!");
+		}
+		m_LevelOffsets.push_back(0);
+	}
+	else {
+		if (parent >= node) {
+			throw std::runtime_error("scene graph parent has to be added before its children!");
+		}
+		// the parent's depth is the last level starting at or before it
+		size_t parentLevel = std::upper_bound(m_LevelOffsets.begin(), m_LevelOffsets.end(), parent) - m_LevelOffsets.begin() - 1;
+		if (parentLevel + 1 == m_LevelOffsets.size()) {
+			m_LevelOffsets.push_back(node);
+		}
+		else if (parentLevel + 2 != m_LevelOffsets.size()) {
+			throw std::runtime_error("scene graph nodes have to be added breadth first!");
+		}
+	}
+
+	m_Parents.push_back(parent);
+	m_LocalTransforms.push_back(localTransform);
+	m_WorldTransforms.push_back(localTransform);
+	m_Dirty.push_back(1);
+	m_Changed.push_back(0);
+	m_AnyDirty = true;
+	return node;
+}
+
+void SceneGraph::AddInstance(uint32_t node)
+{
+	m_InstanceNodes.push_back(node);
+}
+
+void SceneGraph::Clear()
+{
+	m_Parents.clear();
+	m_LocalTransforms.clear();
+	m_WorldTransforms.clear();
+	m_Dirty.clear();
+	m_Changed.clear();
+	m_LevelOffsets.clear();
+	m_InstanceNodes.clear();
+	m_AnyDirty = false;
+	m_AnyChanged = false;
+}
+
+void SceneGraph::SetLocalTransform(uint32_t node, const glm::mat4& localTransform)
+{
+	m_LocalTransforms[node] = localTransform;
+	m_Dirty[node] = 1;
+	m_AnyDirty = true;
+}
+
+bool SceneGraph::UpdateWorldTransforms()
+{
+	if (!m_AnyDirty) {
+		// the flags of the previous update are stale now
+		if (m_AnyChanged) {
+			std::fill(m_Changed.begin(), m_Changed.end(), 0);
+			m_AnyChanged = false;
+		}
+		return false;
+	}
+
+	for (size_t level = 0; level < m_LevelOffsets.size(); ++level) {
+		uint32_t begin = m_LevelOffsets[level];
+		uint32_t end = level + 1 < m_LevelOffsets.size() ? m_LevelOffsets[level + 1] : GetNodeCount();
+		if (end - begin < PARALLEL_NODES) {
+			UpdateRange(begin, end);
+			continue;
+		}
+
+		uint32_t jobCount = ThreadPool::Instance().GetThreadCount();
+		uint32_t nodesPerJob = (end - begin + jobCount - 1) / jobCount;
+		std::vector<std::future<void>> jobs;
+		jobs.reserve(jobCount);
+		for (uint32_t first = begin; first < end; first += nodesPerJob) {
+			uint32_t last = std::min(first + nodesPerJob, end);
+			jobs.push_back(ThreadPool::Instance().Submit([this, first, last]() { UpdateRange(first, last); }));
+		}
+		for (auto& job : jobs) {
+			job.get();
+		}
+	}
+
+	m_AnyDirty = false;
+	m_AnyChanged = true;
+	return true;
+}
+
+void SceneGraph::UpdateRange(uint32_t begin, uint32_t end)
+{
+	for (uint32_t node = begin; node < end; ++node) {
+		uint32_t parent = m_Parents[node];
+		// a moved parent moves the whole subtree
+		m_Changed[node] = m_Dirty[node] | (parent != NO_PARENT ? m_Changed[parent] : 0);
+		m_Dirty[node] = 0;
+		if (!m_Changed[node]) {
+			continue;
+		}
+		m_WorldTransforms[node] = parent != NO_PARENT ? m_WorldTransforms[parent] * m_LocalTransforms[node] : m_LocalTransforms[node];
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Transform hierarchy flattened into structure of arrays. Nodes are stored breadth first, so every
+// parent comes before its children and each depth is one contiguous range: a world matrix update
+// is a single pass over the arrays, and a level's nodes only read the level above it, which lets
+// large levels be split across the thread pool.
+// Instance i (ResourceManager::GetInstances()[i]) is placed by the world matrix of GetInstanceNodes()[i].
+class SceneGraph
+{
+public:
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+	// parent has to be NO_PARENT (a root) for the first node only, and nodes have to be added
+	// breadth first, throws otherwise
+	uint32_t AddNode(uint32_t parent, const glm::mat4& localTransform);
+	void AddInstance(uint32_t node);
+	void Clear();
+
+	// marks the node (and so its subtree) dirty, the world matrices follow in UpdateWorldTransforms
+	void SetLocalTransform(uint32_t node, const glm::mat4& localTransform);
+
+	// Recomputes the world matrix of every dirty node and its descendants, returns false without
+	// touching anything when no node is dirty. IsChanged tells which nodes moved until the next call.
+	bool UpdateWorldTransforms();
+
+	bool IsChanged(uint32_t node) const { return m_Changed[node] != 0; }
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_Parents.size()); }
+	const std::vector<uint32_t>& GetParents() const { return m_Parents; }
+	const std::vector<glm::mat4>& GetLocalTransforms() const { return m_LocalTransforms; }
+	const glm::mat4& GetWorldTransform(uint32_t node) const { return m_WorldTransforms[node]; }
+	const std::vector<uint32_t>& GetInstanceNodes() const { return m_InstanceNodes; }
+
+private:
+	// one level's nodes in [begin, end), their parents are final already
+	void UpdateRange(uint32_t begin, uint32_t end);
+
+	// levels with fewer nodes are updated on the calling thread
+	static constexpr uint32_t PARALLEL_NODES = 4096;
+
+	std::vector<uint32_t> m_Parents;
+	std::vector<glm::mat4> m_LocalTransforms;
+	std::vector<glm::mat4> m_WorldTransforms;
+	std::vector<uint8_t> m_Dirty;
+	std::vector<uint8_t> m_Changed;
+	// first node of every depth
+	std::vector<uint32_t> m_LevelOffsets;
+	std::vector<uint32_t> m_InstanceNodes;
+	bool m_AnyDirty = false;
+	bool m_AnyChanged = false;
+};
@@ -0,0 +1,121 @@
+#include "TransientAllocator.h"
+#include "ResourceManager.h"
+#include "Device.h"
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+
+TransientAllocator::TransientAllocator(Device* device, ResourceManager* resourceManager) :
+	m_Device(device),
+	m_ResourceManager(resourceManager)
+{
+}
+
+TransientAllocator::~TransientAllocator()
+{
+	Free();
+}
+
+void TransientAllocator::Allocate(const std::vector<RenderGraphLifetime>& lifetimes)
+{
+	Free();
+
+	std::vector<Placement> requests;
+	uint32_t memoryTypeBits = UINT32_MAX;
+	VkDeviceSize dedicatedSize = 0;
+	std::vector<VkDeviceSize> alignments;
+
+	for (const auto& lifetime : lifetimes) {
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(m_Device->GetDevice(), lifetime.image->image, &memRequirements);
+
+		memoryTypeBits &= memRequirements.memoryTypeBits;
+		dedicatedSize += memRequirements.size;
+		requests.push_back({ lifetime, 0, memRequirements.size });
+		alignments.push_back(memRequirements.alignment);
+	}
+
+	if (requests.empty()) {
+		return;
+	}
+	if (memoryTypeBits == 0) {
+		throw std::runtime_error("transient attachments have no common memory type!");
+	}
+
+	// Largest first, each image goes to the lowest offset that does not collide with an
+	// already placed image that is alive at the same time
+	std::vector<size_t> order(requests.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return requests[a].size > requests[b].size;
+	});
+
+	std::vector<Placement> placed;
+	VkDeviceSize heapSize = 0;
+	for (size_t index : order) {
+		Placement placement = requests[index];
+		VkDeviceSize alignment = alignments[index];
+
+		bool moved = true;
+		while (moved) {
+			moved = false;
+			for (const auto& other : placed) {
+				bool memoryOverlaps = placement.offset < other.offset + other.size &&
+					other.offset < placement.offset + placement.size;
+				if (memoryOverlaps && LifetimesOverlap(placement.lifetime, other.lifetime)) {
+					placement.offset = (other.offset + other.size + alignment - 1) / alignment * alignment;
+					moved = true;
+				}
+			}
+		}
+
+		for (const auto& other : placed) {
+			bool memoryOverlaps = placement.offset < other.offset + other.size &&
+				other.offset < placement.offset + placement.size;
+			if (memoryOverlaps) {
+				bool otherFirst = other.lifetime.lastPass < placement.lifetime.firstPass;
+				m_Aliases.push_back(otherFirst ?
+					std::make_pair(other.lifetime.image, placement.lifetime.image) :
+					std::make_pair(placement.lifetime.image, other.lifetime.image));
+			}
+		}
+
+		heapSize = std::max(heapSize, placement.offset + placement.size);
+		placed.push_back(placement);
+	}
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = heapSize;
+	allocInfo.memoryTypeIndex = m_ResourceManager->FindMemoryType(memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (vkAllocateMemory(m_Device->GetDevice(), &allocInfo, nullptr, &m_Memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate transient attachment memory!");
+	}
+
+	for (const auto& placement : placed) {
+		vkBindImageMemory(m_Device->GetDevice(), placement.lifetime.image->image, m_Memory, placement.offset);
+	}
+
+	m_BytesSaved = dedicatedSize - heapSize;
+	std::cout << "Transient attachments: " << placed.size() << " images in a " << heapSize / (1024 * 1024)
+		<< " MB heap, " << m_BytesSaved << " bytes saved by aliasing ("
+		<< m_Aliases.size() << " aliased pairs)" << std::endl;
+}
+
+void TransientAllocator::Free()
+{
+	if (m_Memory != VK_NULL_HANDLE) {
+		vkFreeMemory(m_Device->GetDevice(), m_Memory, nullptr);
+		m_Memory = VK_NULL_HANDLE;
+	}
+	m_Aliases.clear();
+	m_BytesSaved = 0;
+}
+
+bool TransientAllocator::LifetimesOverlap(const RenderGraphLifetime& a, const RenderGraphLifetime& b)
+{
+	return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "RenderGraph.h"
+
+class Device;
+class ResourceManager;
+
+// Places the frame's render targets in one device local heap. Images whose render graph
+// lifetimes do not overlap are given overlapping memory ranges.
+class TransientAllocator
+{
+public:
+	TransientAllocator(Device* device, ResourceManager* resourceManager);
+	~TransientAllocator();
+
+	// Images must already be created but not bound to memory
+	void Allocate(const std::vector<RenderGraphLifetime>& lifetimes);
+	void Free();
+
+	// (earlier, later) pairs of images that share memory
+	const std::vector<std::pair<Image*, Image*>>& GetAliases() const { return m_Aliases; }
+	VkDeviceSize GetBytesSaved() const { return m_BytesSaved; }
+
+private:
+	struct Placement {
+		RenderGraphLifetime lifetime;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	static bool LifetimesOverlap(const RenderGraphLifetime& a, const RenderGraphLifetime& b);
+
+	VkDeviceMemory m_Memory = VK_NULL_HANDLE;
+	std::vector<std::pair<Image*, Image*>> m_Aliases;
+	VkDeviceSize m_BytesSaved = 0;
+
+	Device* m_Device;
+	ResourceManager* m_ResourceManager;
+};
@@ -0,0 +1,625 @@
+#include "UploadBatcher.h"
+#include "ResourceManager.h"
+#include "Device.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <iostream>
+
+static VkSemaphore CreateTimelineSemaphore(VkDevice device)
+{
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	VkSemaphore semaphore;
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload timeline semaphore!");
+	}
+	return semaphore;
+}
+
+static VkCommandPool CreateUploadCommandPool(VkDevice device, uint32_t queueFamily)
+{
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+
+	VkCommandPool commandPool;
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+	return commandPool;
+}
+
+static VkCommandBuffer AllocateUploadCommandBuffer(VkDevice device, VkCommandPool commandPool)
+{
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate upload command buffer!");
+	}
+	return commandBuffer;
+}
+
+UploadBatcher::UploadBatcher(Device* device, MemoryAllocator* memoryAllocator) :
+	m_Device(device),
+	m_MemoryAllocator(memoryAllocator)
+{
+	m_CommandPool = CreateUploadCommandPool(m_Device->GetDevice(), m_Device->GetGraphicsQueueFamily());
+	if (m_Device->HasDedicatedTransferQueue()) {
+		m_TransferCommandPool = CreateUploadCommandPool(m_Device->GetDevice(), m_Device->GetTransferQueueFamily());
+		m_TransferTimeline = CreateTimelineSemaphore(m_Device->GetDevice());
+	}
+	m_Timeline = CreateTimelineSemaphore(m_Device->GetDevice());
+
+	for (auto& batch : m_Batches) {
+		batch.commandBuffer = AllocateUploadCommandBuffer(m_Device->GetDevice(), m_CommandPool);
+		if (m_TransferCommandPool != VK_NULL_HANDLE) {
+			batch.transferCommandBuffer = AllocateUploadCommandBuffer(m_Device->GetDevice(), m_TransferCommandPool);
+		}
+	}
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = RING_SIZE;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(m_Device->GetDevice(), &bufferInfo, nullptr, &m_RingBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload staging ring!");
+	}
+	m_RingAllocation = m_MemoryAllocator->AllocateBuffer(m_RingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+UploadBatcher::~UploadBatcher()
+{
+	WaitIdle();
+
+	vkDestroySemaphore(m_Device->GetDevice(), m_Timeline, nullptr);
+	vkDestroySemaphore(m_Device->GetDevice(), m_TransferTimeline, nullptr);
+	vkDestroyCommandPool(m_Device->GetDevice(), m_CommandPool, nullptr);
+	vkDestroyCommandPool(m_Device->GetDevice(), m_TransferCommandPool, nullptr);
+
+	vkDestroyBuffer(m_Device->GetDevice(), m_RingBuffer, nullptr);
+	m_MemoryAllocator->Free(m_RingAllocation);
+}
+
+uint64_t UploadBatcher::UploadImage(Image& image, const void* pixels, VkDeviceSize size, uint32_t width, uint32_t height)
+{
+	if (image.mipLevels > 1) {
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(m_Device->GetPhysicalDevice(), image.format, &formatProperties);
+		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+			throw std::runtime_error("texture image format does not support linear blitting!");
+		}
+	}
+
+	PendingImage pending{};
+	pending.image = image.image;
+	pending.width = width;
+	pending.height = height;
+	pending.mipLevels = image.mipLevels;
+	Stage(pixels, size, pending.buffer, pending.bufferOffset);
+
+	Batch& batch = GetCurrentBatch();
+	batch.images.push_back(pending);
+	image.currentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	++m_ImageCount;
+
+	uint64_t value = batch.value;
+	if (batch.images.size() >= MAX_IMAGES_PER_BATCH) {
+		Flush();
+	}
+	return value;
+}
+
+uint64_t UploadBatcher::UploadCompressedImage(Image& image, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& levels)
+{
+	PendingImage pending{};
+	pending.image = image.image;
+	pending.width = levels[0].imageExtent.width;
+	pending.height = levels[0].imageExtent.height;
+	pending.mipLevels = image.mipLevels;
+	pending.levels = levels;
+	Stage(data, size, pending.buffer, pending.bufferOffset);
+	for (auto& level : pending.levels) {
+		level.bufferOffset += pending.bufferOffset;
+	}
+
+	Batch& batch = GetCurrentBatch();
+	batch.images.push_back(std::move(pending));
+	image.currentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	++m_ImageCount;
+
+	uint64_t value = batch.value;
+	if (batch.images.size() >= MAX_IMAGES_PER_BATCH) {
+		Flush();
+	}
+	return value;
+}
+
+uint64_t UploadBatcher::UploadBuffer(VkBuffer buffer, const void* data, VkDeviceSize size)
+{
+	PendingBuffer pending{};
+	pending.buffer = buffer;
+	pending.size = size;
+	Stage(data, size, pending.stagingBuffer, pending.stagingOffset);
+
+	Batch& batch = GetCurrentBatch();
+	batch.buffers.push_back(pending);
+	++m_BufferCount;
+	return batch.value;
+}
+
+uint64_t UploadBatcher::Flush()
+{
+	Batch& batch = m_Batches[m_CurrentBatch];
+	if (batch.submitted || (batch.images.empty() && batch.buffers.empty())) {
+		return m_SubmittedValue;
+	}
+
+	RecordBatch(batch);
+
+	VkCommandBufferSubmitInfo cmdBufferSubmitInfo{};
+	cmdBufferSubmitInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+	cmdBufferSubmitInfo.commandBuffer = batch.commandBuffer;
+
+	VkSemaphoreSubmitInfo signalInfo{};
+	signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	signalInfo.semaphore = m_Timeline;
+	signalInfo.value = batch.value;
+	signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+	VkSubmitInfo2 submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+	submitInfo.commandBufferInfoCount = 1;
+	submitInfo.pCommandBufferInfos = &cmdBufferSubmitInfo;
+	submitInfo.signalSemaphoreInfoCount = 1;
+	submitInfo.pSignalSemaphoreInfos = &signalInfo;
+
+	VkSemaphoreSubmitInfo waitInfo{};
+	if (m_Device->HasDedicatedTransferQueue()) {
+		VkCommandBufferSubmitInfo transferCmdBufferSubmitInfo{};
+		transferCmdBufferSubmitInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+		transferCmdBufferSubmitInfo.commandBuffer = batch.transferCommandBuffer;
+
+		VkSemaphoreSubmitInfo transferSignalInfo{};
+		transferSignalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		transferSignalInfo.semaphore = m_TransferTimeline;
+		transferSignalInfo.value = batch.value;
+		transferSignalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo2 transferSubmitInfo{};
+		transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+		transferSubmitInfo.commandBufferInfoCount = 1;
+		transferSubmitInfo.pCommandBufferInfos = &transferCmdBufferSubmitInfo;
+		transferSubmitInfo.signalSemaphoreInfoCount = 1;
+		transferSubmitInfo.pSignalSemaphoreInfos = &transferSignalInfo;
+
+		if (vkQueueSubmit2(m_Device->GetTransferQueue(), 1, &transferSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload batch to the transfer queue!");
+		}
+
+		// the ownership acquire barriers and the blits run after the copies landed
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		waitInfo.semaphore = m_TransferTimeline;
+		waitInfo.value = batch.value;
+		waitInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+		submitInfo.waitSemaphoreInfoCount = 1;
+		submitInfo.pWaitSemaphoreInfos = &waitInfo;
+	}
+
+	if (vkQueueSubmit2(m_Device->GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload batch!");
+	}
+
+	batch.submitted = true;
+	m_SubmittedValue = batch.value;
+	m_CurrentBatch = (m_CurrentBatch + 1) % BATCH_COUNT;
+	++m_SubmitCount;
+	return m_SubmittedValue;
+}
+
+void UploadBatcher::WaitIdle()
+{
+	Flush();
+	for (auto& batch : m_Batches) {
+		WaitBatch(batch);
+	}
+
+	if (m_ImageCount > 0 || m_BufferCount > 0) {
+		std::cout << "UploadBatcher: " << m_ImageCount << " images and " << m_BufferCount << " buffers in "
+			<< m_SubmitCount << " submits (" << m_BarrierCount << " barrier batches)" << std::endl;
+		m_ImageCount = 0;
+		m_BufferCount = 0;
+		m_SubmitCount = 0;
+		m_BarrierCount = 0;
+	}
+}
+
+bool UploadBatcher::IsComplete(uint64_t value) const
+{
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(m_Device->GetDevice(), m_Timeline, &completed);
+	return completed >= value;
+}
+
+UploadBatcher::Batch& UploadBatcher::GetCurrentBatch()
+{
+	Batch& batch = m_Batches[m_CurrentBatch];
+	if (batch.submitted) {
+		// the slot is reused, whatever it submitted last time has to be done
+		WaitBatch(batch);
+	}
+	if (batch.value <= m_SubmittedValue) {
+		batch.value = m_SubmittedValue + 1;
+		batch.ringBegin = m_RingHead;
+		batch.ringEnd = m_RingHead;
+	}
+	return batch;
+}
+
+void UploadBatcher::Stage(const void* data, VkDeviceSize size, VkBuffer& stagingBuffer, VkDeviceSize& stagingOffset)
+{
+	if (size <= RING_SIZE) {
+		stagingOffset = AllocateRing(size);
+		stagingBuffer = m_RingBuffer;
+		memcpy(static_cast<char*>(m_RingAllocation.mappedData) + stagingOffset, data, static_cast<size_t>(size));
+		return;
+	}
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(m_Device->GetDevice(), &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create staging buffer!");
+	}
+	Allocation allocation = m_MemoryAllocator->AllocateBuffer(stagingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	memcpy(allocation.mappedData, data, static_cast<size_t>(size));
+
+	GetCurrentBatch().oversized.push_back({ stagingBuffer, allocation });
+	stagingOffset = 0;
+}
+
+VkDeviceSize UploadBatcher::AllocateRing(VkDeviceSize size)
+{
+	size = (size + 15) & ~VkDeviceSize(15);
+
+	if (m_RingHead + size > RING_SIZE) {
+		// Submit before wrapping so every batch reads one contiguous ring range
+		Batch& current = GetCurrentBatch();
+		if (current.ringBegin != current.ringEnd) {
+			Flush();
+		}
+		m_RingHead = 0;
+	}
+
+	Batch& current = GetCurrentBatch();
+	if (current.ringBegin == current.ringEnd) {
+		current.ringBegin = m_RingHead;
+	}
+
+	VkDeviceSize begin = m_RingHead;
+	VkDeviceSize end = begin + size;
+	for (auto& batch : m_Batches) {
+		if (&batch != &current && batch.submitted && batch.ringBegin < end && begin < batch.ringEnd) {
+			WaitBatch(batch);
+		}
+	}
+
+	current.ringEnd = end;
+	m_RingHead = end;
+	return begin;
+}
+
+void UploadBatcher::WaitBatch(Batch& batch)
+{
+	if (!batch.submitted) {
+		return;
+	}
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_Timeline;
+	waitInfo.pValues = &batch.value;
+	vkWaitSemaphores(m_Device->GetDevice(), &waitInfo, UINT64_MAX);
+
+	for (auto& oversized : batch.oversized) {
+		vkDestroyBuffer(m_Device->GetDevice(), oversized.first, nullptr);
+		m_MemoryAllocator->Free(oversized.second);
+	}
+	batch.oversized.clear();
+	batch.images.clear();
+	batch.buffers.clear();
+	batch.ringBegin = 0;
+	batch.ringEnd = 0;
+	batch.submitted = false;
+}
+
+void UploadBatcher::RecordBatch(Batch& batch)
+{
+	bool dedicatedTransfer = m_Device->HasDedicatedTransferQueue();
+	uint32_t transferFamily = m_Device->GetTransferQueueFamily();
+	uint32_t graphicsFamily = m_Device->GetGraphicsQueueFamily();
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkResetCommandBuffer(batch.commandBuffer, 0);
+	vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+	VkCommandBuffer copyCommandBuffer = batch.commandBuffer;
+	if (dedicatedTransfer) {
+		copyCommandBuffer = batch.transferCommandBuffer;
+		vkResetCommandBuffer(copyCommandBuffer, 0);
+		vkBeginCommandBuffer(copyCommandBuffer, &beginInfo);
+	}
+
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+	auto emitBarriers = [&](VkCommandBuffer commandBuffer) {
+		if (imageBarriers.empty() && bufferBarriers.empty()) {
+			return;
+		}
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size());
+		dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+		dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+		dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+		imageBarriers.clear();
+		bufferBarriers.clear();
+		++m_BarrierCount;
+	};
+
+	auto wholeImage = [](VkImage image, uint32_t mipLevels) {
+		VkImageMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		return barrier;
+	};
+
+	auto wholeBuffer = [](VkBuffer buffer) {
+		VkBufferMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		return barrier;
+	};
+
+	// Copy half: runs on the transfer queue when there is one
+	for (const auto& pending : batch.images) {
+		VkImageMemoryBarrier2 barrier = wholeImage(pending.image, pending.mipLevels);
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barrier.srcAccessMask = VK_ACCESS_2_NONE;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageBarriers.push_back(barrier);
+	}
+	emitBarriers(copyCommandBuffer);
+
+	for (const auto& pending : batch.buffers) {
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = pending.stagingOffset;
+		copyRegion.dstOffset = 0;
+		copyRegion.size = pending.size;
+		vkCmdCopyBuffer(copyCommandBuffer, pending.stagingBuffer, pending.buffer, 1, &copyRegion);
+	}
+
+	for (const auto& pending : batch.images) {
+		if (!pending.levels.empty()) {
+			vkCmdCopyBufferToImage(copyCommandBuffer, pending.buffer, pending.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(pending.levels.size()), pending.levels.data());
+			continue;
+		}
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = pending.bufferOffset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { pending.width, pending.height, 1 };
+		vkCmdCopyBufferToImage(copyCommandBuffer, pending.buffer, pending.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+
+	if (dedicatedTransfer) {
+		// Queue family ownership transfer: a release on the transfer queue and a matching acquire
+		// on the graphics queue, ordered by the transfer timeline wait in Flush
+		for (const auto& pending : batch.images) {
+			VkImageMemoryBarrier2 barrier = wholeImage(pending.image, pending.mipLevels);
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			imageBarriers.push_back(barrier);
+		}
+		for (const auto& pending : batch.buffers) {
+			VkBufferMemoryBarrier2 barrier = wholeBuffer(pending.buffer);
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			bufferBarriers.push_back(barrier);
+		}
+		emitBarriers(copyCommandBuffer);
+
+		for (const auto& pending : batch.images) {
+			VkImageMemoryBarrier2 barrier = wholeImage(pending.image, pending.mipLevels);
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			imageBarriers.push_back(barrier);
+		}
+		for (const auto& pending : batch.buffers) {
+			VkBufferMemoryBarrier2 barrier = wholeBuffer(pending.buffer);
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			bufferBarriers.push_back(barrier);
+		}
+		emitBarriers(batch.commandBuffer);
+
+		if (vkEndCommandBuffer(copyCommandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record upload transfer command buffer!");
+		}
+	}
+	else {
+		for (const auto& pending : batch.buffers) {
+			VkBufferMemoryBarrier2 barrier = wholeBuffer(pending.buffer);
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+			bufferBarriers.push_back(barrier);
+		}
+		emitBarriers(batch.commandBuffer);
+	}
+
+	// Graphics half
+	RecordMipChains(batch.commandBuffer, batch);
+
+	if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record upload command buffer!");
+	}
+}
+
+void UploadBatcher::RecordMipChains(VkCommandBuffer commandBuffer, const Batch& batch)
+{
+	std::vector<VkImageMemoryBarrier2> barriers;
+
+	auto addBarrier = [&barriers](VkImage image, uint32_t level, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+		VkImageMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstStageMask = dstStage;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = level;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barriers.push_back(barrier);
+	};
+
+	auto emitBarriers = [&]() {
+		if (barriers.empty()) {
+			return;
+		}
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+		dependencyInfo.pImageMemoryBarriers = barriers.data();
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+		barriers.clear();
+		++m_BarrierCount;
+	};
+
+	// Precomputed chains were copied whole, they go straight to shader read with the first barrier batch
+	uint32_t maxMipLevels = 0;
+	for (const auto& pending : batch.images) {
+		if (!pending.levels.empty()) {
+			addBarrier(pending.image, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+			barriers.back().subresourceRange.levelCount = pending.mipLevels;
+			continue;
+		}
+		maxMipLevels = std::max(maxMipLevels, pending.mipLevels);
+	}
+
+	// Walk the mip chains of all images level by level, so each step is one barrier batch for the
+	// whole batch instead of two per image per level
+	for (uint32_t level = 0; level < maxMipLevels; ++level) {
+		for (const auto& pending : batch.images) {
+			if (!pending.levels.empty()) {
+				continue;
+			}
+			if (level + 1 < pending.mipLevels) {
+				addBarrier(pending.image, level, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+			}
+			else if (level + 1 == pending.mipLevels) {
+				addBarrier(pending.image, level, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+			}
+		}
+		emitBarriers();
+
+		for (const auto& pending : batch.images) {
+			if (!pending.levels.empty() || level + 1 >= pending.mipLevels) {
+				continue;
+			}
+
+			int32_t srcWidth = static_cast<int32_t>(std::max(1u, pending.width >> level));
+			int32_t srcHeight = static_cast<int32_t>(std::max(1u, pending.height >> level));
+
+			VkImageBlit blit{};
+			blit.srcOffsets[0] = { 0, 0, 0 };
+			blit.srcOffsets[1] = { srcWidth, srcHeight, 1 };
+			blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.srcSubresource.mipLevel = level;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = 1;
+			blit.dstOffsets[0] = { 0, 0, 0 };
+			blit.dstOffsets[1] = { srcWidth > 1 ? srcWidth / 2 : 1, srcHeight > 1 ? srcHeight / 2 : 1, 1 };
+			blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.dstSubresource.mipLevel = level + 1;
+			blit.dstSubresource.baseArrayLayer = 0;
+			blit.dstSubresource.layerCount = 1;
+
+			vkCmdBlitImage(commandBuffer,
+				pending.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				pending.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &blit,
+				VK_FILTER_LINEAR);
+
+			// goes out together with the next level's barriers
+			addBarrier(pending.image, level, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_2_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+		}
+	}
+	emitBarriers();
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <array>
+#include <vector>
+#include "MemoryAllocator.h"
+
+class Device;
+struct Image;
+
+// Records uploads (buffer copies, texture copy + mip chain) into a few large command buffers
+// instead of one queue wait per operation. Data is staged in a persistently mapped ring buffer.
+//
+// Every batch signals the upload timeline semaphore with its own value, which is what callers
+// wait on (GPU side in a submit, or CPU side through IsComplete). When the device has a dedicated
+// transfer family the copies run there and ownership is handed to the graphics family, which
+// builds the mip chains (blits need a graphics queue).
+class UploadBatcher
+{
+public:
+	UploadBatcher(Device* device, MemoryAllocator* memoryAllocator);
+	~UploadBatcher();
+
+	// Both copy the data into the staging ring right away, the GPU work is recorded on Flush.
+	// Return the timeline value at which the upload is complete.
+	// The image must be freshly created (UNDEFINED layout), it ends up SHADER_READ_ONLY_OPTIMAL.
+	uint64_t UploadImage(Image& image, const void* pixels, VkDeviceSize size, uint32_t width, uint32_t height);
+	uint64_t UploadBuffer(VkBuffer buffer, const void* data, VkDeviceSize size);
+	// Block compressed image with every mip level precomputed, nothing is blitted. The region
+	// bufferOffsets are relative to data.
+	uint64_t UploadCompressedImage(Image& image, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& levels);
+
+	// Submits the current batch without waiting for it, returns the last submitted value
+	uint64_t Flush();
+	// Flushes and blocks until every submitted batch has completed
+	void WaitIdle();
+
+	bool IsComplete(uint64_t value) const;
+	VkSemaphore GetTimeline() const { return m_Timeline; }
+
+private:
+	static constexpr VkDeviceSize RING_SIZE = 64ull * 1024 * 1024;
+	static constexpr uint32_t BATCH_COUNT = 3;
+	// a batch is submitted early once it holds this many images so the GPU starts while we keep decoding
+	static constexpr uint32_t MAX_IMAGES_PER_BATCH = 32;
+
+	struct PendingImage {
+		VkImage image;
+		VkBuffer buffer;
+		VkDeviceSize bufferOffset;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		// set for precomputed mip chains, one copy per level and no blits
+		std::vector<VkBufferImageCopy> levels;
+	};
+
+	struct PendingBuffer {
+		VkBuffer buffer;
+		VkBuffer stagingBuffer;
+		VkDeviceSize stagingOffset;
+		VkDeviceSize size;
+	};
+
+	struct Batch {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		// only used with a dedicated transfer queue
+		VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+		uint64_t value = 0;
+		bool submitted = false;
+		// staging ring range read by this batch
+		VkDeviceSize ringBegin = 0;
+		VkDeviceSize ringEnd = 0;
+		std::vector<PendingImage> images;
+		std::vector<PendingBuffer> buffers;
+		// one-off staging buffers for uploads larger than the ring
+		std::vector<std::pair<VkBuffer, Allocation>> oversized;
+	};
+
+	Batch& GetCurrentBatch();
+	void Stage(const void* data, VkDeviceSize size, VkBuffer& stagingBuffer, VkDeviceSize& stagingOffset);
+	VkDeviceSize AllocateRing(VkDeviceSize size);
+	void RecordBatch(Batch& batch);
+	void RecordMipChains(VkCommandBuffer commandBuffer, const Batch& batch);
+	void WaitBatch(Batch& batch);
+
+	VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+	VkCommandPool m_TransferCommandPool = VK_NULL_HANDLE;
+	std::array<Batch, BATCH_COUNT> m_Batches;
+	uint32_t m_CurrentBatch = 0;
+
+	// graphics side completion, this is the semaphore everyone waits on
+	VkSemaphore m_Timeline = VK_NULL_HANDLE;
+	// transfer side completion, only waited on by the graphics half of a batch
+	VkSemaphore m_TransferTimeline = VK_NULL_HANDLE;
+	uint64_t m_SubmittedValue = 0;
+
+	VkBuffer m_RingBuffer = VK_NULL_HANDLE;
+	Allocation m_RingAllocation;
+	VkDeviceSize m_RingHead = 0;
+
+	uint32_t m_SubmitCount = 0;
+	uint32_t m_ImageCount = 0;
+	uint32_t m_BufferCount = 0;
+	uint32_t m_BarrierCount = 0;
+
+	Device* m_Device;
+	MemoryAllocator* m_MemoryAllocator;
+};
@@ -0,0 +1,187 @@
+#include "VertexCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	constexpr float POSITION_STEPS = 65535.0f;
+	constexpr uint32_t BITANGENT_SIGN_BIT = 1u << 16;
+
+	// round to nearest even like the GPU's packHalf2x16
+	uint16_t FloatToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		uint32_t sign = (bits >> 16) & 0x8000;
+		uint32_t exponentBits = (bits >> 23) & 0xff;
+		uint32_t mantissa = bits & 0x7fffff;
+
+		if (exponentBits == 0xff) {
+			return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+		}
+		int32_t exponent = static_cast<int32_t>(exponentBits) - 127 + 15;
+		if (exponent >= 31) {
+			return static_cast<uint16_t>(sign | 0x7c00);
+		}
+		if (exponent <= 0) {
+			if (exponent < -10) {
+				return static_cast<uint16_t>(sign);
+			}
+			// subnormal half
+			mantissa |= 0x800000;
+			uint32_t shift = static_cast<uint32_t>(14 - exponent);
+			uint32_t half = mantissa >> shift;
+			uint32_t remainder = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			if (remainder > halfway || (remainder == halfway && (half & 1))) {
+				++half;
+			}
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+		uint32_t remainder = mantissa & 0x1fff;
+		// a carry out of the mantissa correctly bumps the exponent
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+			++half;
+		}
+		return static_cast<uint16_t>(half);
+	}
+
+	float HalfToFloat(uint16_t half)
+	{
+		uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+		uint32_t exponent = (half >> 10) & 0x1f;
+		uint32_t mantissa = half & 0x3ff;
+		uint32_t bits;
+		if (exponent == 0x1f) {
+			bits = sign | 0x7f800000 | (mantissa << 13);
+		}
+		else if (exponent != 0) {
+			bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+		}
+		else if (mantissa == 0) {
+			bits = sign;
+		}
+		else {
+			// subnormal half, normalize it
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400) == 0) {
+				mantissa <<= 1;
+				--exponent;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	uint32_t PackSnorm2x16(const glm::vec2& value)
+	{
+		auto pack = [](float component) {
+			int32_t snorm = static_cast<int32_t>(std::round(std::clamp(component, -1.0f, 1.0f) * 32767.0f));
+			return static_cast<uint32_t>(snorm) & 0xffff;
+		};
+		return pack(value.x) | (pack(value.y) << 16);
+	}
+
+	glm::vec2 UnpackSnorm2x16(uint32_t packed)
+	{
+		auto unpack = [](uint32_t bits) {
+			return std::clamp(static_cast<int16_t>(bits & 0xffff) / 32767.0f, -1.0f, 1.0f);
+		};
+		return glm::vec2(unpack(packed), unpack(packed >> 16));
+	}
+
+	glm::vec2 SignNotZero(const glm::vec2& value)
+	{
+		return glm::vec2(value.x >= 0.0f ? 1.0f : -1.0f, value.y >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	// octahedral mapping of a unit vector to [-1, 1]^2
+	glm::vec2 OctEncode(glm::vec3 direction, const glm::vec3& fallback)
+	{
+		float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+		if (length == 0.0f) {
+			direction = fallback;
+			length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+		}
+		direction /= length;
+		glm::vec2 encoded(direction.x, direction.y);
+		if (direction.z < 0.0f) {
+			encoded = (glm::vec2(1.0f) - glm::vec2(std::abs(direction.y), std::abs(direction.x))) * SignNotZero(encoded);
+		}
+		return encoded;
+	}
+
+	glm::vec3 OctDecode(const glm::vec2& encoded)
+	{
+		glm::vec3 direction(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+		if (direction.z < 0.0f) {
+			glm::vec2 folded = (glm::vec2(1.0f) - glm::vec2(std::abs(direction.y), std::abs(direction.x))) * SignNotZero(encoded);
+			direction.x = folded.x;
+			direction.y = folded.y;
+		}
+		return glm::normalize(direction);
+	}
+}
+
+namespace VertexCompression {
+
+	glm::vec3 GetPositionOffset(const MeshHandle& mesh)
+	{
+		return mesh.boundsCenter - glm::vec3(mesh.boundsRadius);
+	}
+
+	glm::vec3 GetPositionScale(const MeshHandle& mesh)
+	{
+		return glm::vec3(2.0f * mesh.boundsRadius / POSITION_STEPS);
+	}
+
+	CompactVertex Encode(const Vertex& vertex, const glm::vec3& positionOffset, const glm::vec3& positionScale)
+	{
+		uint32_t quantized[3];
+		for (int axis = 0; axis < 3; ++axis) {
+			float steps = positionScale[axis] > 0.0f ? (vertex.pos[axis] - positionOffset[axis]) / positionScale[axis] : 0.0f;
+			quantized[axis] = static_cast<uint32_t>(std::round(std::clamp(steps, 0.0f, POSITION_STEPS)));
+		}
+
+		CompactVertex compact{};
+		compact.positionXY = quantized[0] | (quantized[1] << 16);
+		compact.positionZ = quantized[2];
+		compact.normal = PackSnorm2x16(OctEncode(vertex.normal, glm::vec3(0.0f, 0.0f, 1.0f)));
+		compact.tangent = PackSnorm2x16(OctEncode(vertex.tangent, glm::vec3(1.0f, 0.0f, 0.0f)));
+		if (glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitTangent) < 0.0f) {
+			compact.positionZ |= BITANGENT_SIGN_BIT;
+		}
+		compact.texCoord = FloatToHalf(vertex.texCoord.x) | (static_cast<uint32_t>(FloatToHalf(vertex.texCoord.y)) << 16);
+		return compact;
+	}
+
+	Vertex Decode(const CompactVertex& compact, const glm::vec3& positionOffset, const glm::vec3& positionScale)
+	{
+		Vertex vertex{};
+		glm::vec3 quantized(compact.positionXY & 0xffff, compact.positionXY >> 16, compact.positionZ & 0xffff);
+		vertex.pos = positionOffset + quantized * positionScale;
+		vertex.normal = OctDecode(UnpackSnorm2x16(compact.normal));
+		vertex.tangent = OctDecode(UnpackSnorm2x16(compact.tangent));
+		float sign = (compact.positionZ & BITANGENT_SIGN_BIT) ? -1.0f : 1.0f;
+		vertex.bitTangent = sign * glm::cross(vertex.normal, vertex.tangent);
+		vertex.texCoord = glm::vec2(HalfToFloat(compact.texCoord & 0xffff), HalfToFloat(compact.texCoord >> 16));
+		return vertex;
+	}
+
+	std::vector<CompactVertex> EncodeMeshes(const std::vector<Vertex>& vertices, const std::vector<MeshHandle>& meshes)
+	{
+		std::vector<CompactVertex> compact(vertices.size());
+		for (const MeshHandle& mesh : meshes) {
+			glm::vec3 offset = GetPositionOffset(mesh);
+			glm::vec3 scale = GetPositionScale(mesh);
+			for (uint32_t i = mesh.vertexOffset; i < mesh.vertexOffset + mesh.vertexCount; ++i) {
+				compact[i] = Encode(vertices[i], offset, scale);
+			}
+		}
+		return compact;
+	}
+}
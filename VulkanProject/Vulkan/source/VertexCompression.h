@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include "ResourceManager.h"
+
+// 20 byte vertex for the vertex streams when COMPACT_VERTICES is defined, split into the
+// position (positionXY, positionZ), texCoord and tangent frame (normal, tangent) streams and
+// decoded in resources/shaders/vertex.glsl:
+//   position   16 bit unorm per axis inside the cube around the mesh's bounding sphere, the
+//              mesh's MeshDrawData carries the offset and scale back to mesh space
+//   normal     octahedral, 2 x 16 bit snorm
+//   tangent    octahedral, 2 x 16 bit snorm, the bitangent is rebuilt as
+//              sign * cross(normal, tangent) with the sign in bit 16 of positionZ
+//   texCoord   2 x half
+struct CompactVertex {
+	uint32_t positionXY;
+	uint32_t positionZ;
+	uint32_t normal;
+	uint32_t tangent;
+	uint32_t texCoord;
+};
+static_assert(sizeof(CompactVertex) == 20, "CompactVertex has to match the streams in vertex.glsl");
+
+namespace VertexCompression {
+
+	// mesh space position = offset + quantized * scale, what goes into MeshDrawData
+	glm::vec3 GetPositionOffset(const MeshHandle& mesh);
+	glm::vec3 GetPositionScale(const MeshHandle& mesh);
+
+	CompactVertex Encode(const Vertex& vertex, const glm::vec3& positionOffset, const glm::vec3& positionScale);
+	// the shader's decode on the CPU, for checking the accuracy of Encode
+	Vertex Decode(const CompactVertex& vertex, const glm::vec3& positionOffset, const glm::vec3& positionScale);
+
+	// Encodes every mesh's vertex range with that mesh's bounds
+	std::vector<CompactVertex> EncodeMeshes(const std::vector<Vertex>& vertices, const std::vector<MeshHandle>& meshes);
+}
@@ -0,0 +1,120 @@
+#include "VertexWelder.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+	// xxHash64/XXH3 constants
+	constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+	constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+
+	inline uint64_t RotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	inline void Store(float* out, const glm::vec3& value)
+	{
+		// + 0.0f turns -0.0 into 0.0 so both hash and compare the way operator== does
+		out[0] = value.x + 0.0f;
+		out[1] = value.y + 0.0f;
+		out[2] = value.z + 0.0f;
+	}
+}
+
+VertexWelder::VertexWelder(size_t expectedVertexCount, float positionEpsilon) :
+	m_PositionEpsilon(positionEpsilon)
+{
+	// keep the load factor at or below one half
+	size_t capacity = 64;
+	while (capacity < expectedVertexCount * 2) {
+		capacity *= 2;
+	}
+	m_Slots.assign(capacity, 0);
+	m_SlotTags.assign(capacity, 0);
+	m_Mask = capacity - 1;
+
+	m_Keys.reserve(expectedVertexCount);
+	m_Vertices.reserve(expectedVertexCount);
+}
+
+VertexWelder::Key VertexWelder::MakeKey(const Vertex& vertex) const
+{
+	Key key;
+	Store(&key.values[0], vertex.pos);
+	Store(&key.values[3], vertex.normal);
+	key.values[6] = vertex.texCoord.x + 0.0f;
+	key.values[7] = vertex.texCoord.y + 0.0f;
+	Store(&key.values[8], vertex.tangent);
+	Store(&key.values[11], vertex.bitTangent);
+
+	if (m_PositionEpsilon > 0.0f) {
+		for (int i = 0; i < 3; ++i) {
+			key.values[i] = std::round(key.values[i] / m_PositionEpsilon) + 0.0f;
+		}
+	}
+	return key;
+}
+
+uint64_t VertexWelder::Hash(const Key& key)
+{
+	// 64 bit lanes through an xxHash style round, then the XXH3 avalanche
+	static_assert(sizeof(Key) % sizeof(uint64_t) == 0, "key is hashed in 64 bit lanes");
+	uint64_t lanes[sizeof(Key) / sizeof(uint64_t)];
+	memcpy(lanes, &key, sizeof(Key));
+
+	uint64_t hash = PRIME64_3 ^ sizeof(Key);
+	for (uint64_t lane : lanes) {
+		hash ^= RotateLeft(lane * PRIME64_2, 31) * PRIME64_1;
+		hash = RotateLeft(hash, 27) * PRIME64_1 + PRIME64_3;
+	}
+
+	hash ^= hash >> 37;
+	hash *= 0x165667919E3779F9ull;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+uint32_t VertexWelder::Weld(const Vertex& vertex)
+{
+	if ((m_Vertices.size() + 1) * 2 > m_Slots.size()) {
+		Grow();
+	}
+
+	Key key = MakeKey(vertex);
+	uint64_t hash = Hash(key);
+	uint32_t tag = static_cast<uint32_t>(hash >> 32);
+
+	for (uint64_t slot = hash & m_Mask;; slot = (slot + 1) & m_Mask) {
+		uint32_t entry = m_Slots[slot];
+		if (entry == 0) {
+			uint32_t index = static_cast<uint32_t>(m_Vertices.size());
+			m_Slots[slot] = index + 1;
+			m_SlotTags[slot] = tag;
+			m_Keys.push_back(key);
+			m_Vertices.push_back(vertex);
+			return index;
+		}
+		if (m_SlotTags[slot] == tag && memcmp(&m_Keys[entry - 1], &key, sizeof(Key)) == 0) {
+			return entry - 1;
+		}
+	}
+}
+
+void VertexWelder::Grow()
+{
+	size_t capacity = m_Slots.size() * 2;
+	m_Slots.assign(capacity, 0);
+	m_SlotTags.assign(capacity, 0);
+	m_Mask = capacity - 1;
+
+	for (uint32_t index = 0; index < m_Keys.size(); ++index) {
+		uint64_t hash = Hash(m_Keys[index]);
+		uint64_t slot = hash & m_Mask;
+		while (m_Slots[slot] != 0) {
+			slot = (slot + 1) & m_Mask;
+		}
+		m_Slots[slot] = index + 1;
+		m_SlotTags[slot] = static_cast<uint32_t>(hash >> 32);
+	}
+}
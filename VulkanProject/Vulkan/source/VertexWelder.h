@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ResourceManager.h"
+
+// Deduplicates vertices while a mesh is imported. Open addressing table with linear probing over
+// a packed copy of the vertex attributes, one probe sequence per insert and no per node allocations.
+//
+// With a positionEpsilon above zero positions are snapped to a grid of that size before they are
+// compared, so near identical positions weld together (the first vertex seen is kept). Two
+// positions on different sides of a grid line still stay apart. All other attributes always
+// have to match exactly.
+class VertexWelder
+{
+public:
+	explicit VertexWelder(size_t expectedVertexCount = 0, float positionEpsilon = 0.0f);
+
+	// Returns the index of the vertex in GetVertices(), appending it if it is new
+	uint32_t Weld(const Vertex& vertex);
+
+	std::vector<Vertex>& GetVertices() { return m_Vertices; }
+
+private:
+	// pos, normal, texCoord, tangent, bitTangent without the alignment padding of Vertex
+	static constexpr uint32_t KEY_FLOATS = 14;
+	struct Key {
+		float values[KEY_FLOATS];
+	};
+
+	Key MakeKey(const Vertex& vertex) const;
+	static uint64_t Hash(const Key& key);
+	void Grow();
+
+	float m_PositionEpsilon;
+	// slot holds vertex index + 1, 0 is empty
+	std::vector<uint32_t> m_Slots;
+	// upper hash bits per slot, compared before touching the key
+	std::vector<uint32_t> m_SlotTags;
+	uint64_t m_Mask = 0;
+
+	std::vector<Key> m_Keys;
+	std::vector<Vertex> m_Vertices;
+};
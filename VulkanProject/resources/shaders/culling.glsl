@@ -0,0 +1,44 @@
+// Shared by cull.comp and compact.comp: the push constants (CullPushConstants in
+// ResourceManager.h) and the per frame draw count and indirect command buffers in set 0.
+
+layout(push_constant) uniform CullPushConstants {
+    vec4 frustumPlanes[6];
+    vec3 cameraPosition;
+    float pixelsPerUnit;
+    float lodErrorPixels;
+    uint instanceCount;
+    uint meshCount;
+    // 0 for the early phase, 1 for the late one
+    uint phase;
+} push;
+
+const uint DRAW_COUNT_HEADER = 2;
+
+// One region per phase: draw counts of the 16 and 32 bit index buffer, then the visible instances
+// of every (mesh, LOD) pair at DRAW_COUNT_HEADER + meshIndex * MAX_MESH_LODS + lod. Cleared
+// before the early phase.
+layout(set = 0, binding = 8, std430) buffer DrawCountBuffer {
+    uint counts[];
+} drawCountBuffer;
+
+uint MaxDrawCount() {
+    return push.meshCount * MAX_MESH_LODS;
+}
+
+// first count of the current phase's region
+uint DrawCountOffset() {
+    return push.phase * (DRAW_COUNT_HEADER + MaxDrawCount());
+}
+
+// VkDrawIndexedIndirectCommand, per phase meshCount * MAX_MESH_LODS 16 bit draws followed by as
+// many 32 bit ones
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+layout(set = 0, binding = 9, std430) writeonly buffer DrawCommandBuffer {
+    DrawCommand commands[];
+} drawCommandBuffer;
@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 view;
@@ -7,15 +8,6 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
     vec3 CameraManagerPosition;
 } ubo;
 
-// Vertex structure definition
-struct Vertex {
-    vec3 pos;
-    vec3 color;
-    vec2 texCoord;
-    vec3 tangent;
-    vec3 bitTangent;
-};
-
 struct Material {
     int baseColorTextureIndex;
     int normalTextureIndex;
@@ -26,10 +18,12 @@ struct Material {
     float alphaCutoff;
 };
 
-// Set 0, Binding 1: Vertex buffer (universal)
-layout(set = 0, binding = 1, std430) readonly buffer VertexBuffer {
-    Vertex vertices[];
-} vertexBuffer;
+// Set 0, Bindings 1 and 3: position and texture coordinate streams (universal)
+#include "vertex.glsl"
+// Set 0, Binding 5: instance transforms and material indices (universal)
+#include "instance.glsl"
+// Set 0, Binding 7: per mesh position dequantization (universal)
+#include "meshDraw.glsl"
 
 // Set 0, Binding 2: Material buffer (universal)
 layout(set = 0, binding = 2, std430) readonly buffer MaterialBuffer {
@@ -41,28 +35,26 @@ layout(location = 1) flat out int fragAlphaTextureIndex;
 layout(location = 2) flat out float fragAlphaCutoff;
 layout(location = 3) flat out int fragHasAlpha;
 
-// Push constants
-layout(push_constant) uniform PushConstantData {
-    mat4 model;
-    int meshIndex;
-} push;
-
 void main() {
-    Vertex vertex = vertexBuffer.vertices[gl_VertexIndex];
-    Material material = materialBuffer.materials[push.meshIndex];
-    
-    fragTexCoord = vertex.texCoord;
+    uint vertexIndex = uint(gl_VertexIndex);
+    Instance instance = LoadInstance();
+    MeshDraw mesh = meshDrawBuffer.meshDraws[instance.meshIndex];
+    Material material = materialBuffer.materials[instance.materialIndex];
     
     fragHasAlpha = material.hasAlphaMask;
     
+    // texture coordinates are only fetched for alpha tested materials
     if (material.hasAlphaMask > 0) {
+        fragTexCoord = LoadTexCoord(vertexIndex);
         fragAlphaTextureIndex = material.alphaTextureIndex;
         
         fragAlphaCutoff = material.alphaCutoff;
     } else {
+        fragTexCoord = vec2(0.0);
         fragAlphaTextureIndex = 0;
         fragAlphaCutoff = 0.5;
     }
     
-    gl_Position = ubo.proj * ubo.view * push.model * vec4(vertex.pos, 1.0);
+    vec3 position = LoadPosition(vertexIndex, mesh.positionOffset, mesh.positionScale);
+    gl_Position = ubo.proj * ubo.view * instance.model * vec4(position, 1.0);
 }
\ No newline at end of file
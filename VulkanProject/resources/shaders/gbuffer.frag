@@ -30,8 +30,9 @@ vec3 calcNormal(vec3 normal, vec2 texCoord, mat3 TBN)
     vec3 newNormal = normal;
     if(true)
     {
-        newNormal = texture(textures[fragNormalTextureIndex], texCoord).rgb;
-        newNormal = normalize(newNormal * 2.0 - 1.0);
+        // only xy is used (baked normal maps are BC5), z is rebuilt from the unit length
+        vec2 xy = texture(textures[fragNormalTextureIndex], texCoord).rg * 2.0 - 1.0;
+        newNormal = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
         newNormal = normalize(TBN * newNormal);
     }
     return newNormal;
@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 // set 0 ---------------------------------------------------------------
 layout(set = 0, binding = 0) uniform UniformBufferObject {
@@ -8,16 +9,10 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
     vec3 CameraManagerPosition;
 } ubo;
 
-struct Vertex {
-    vec3 pos;
-    vec3 normal;
-    vec2 texCoord;
-    vec3 tangent;
-    vec3 biTangent;
-};
-layout(set = 0, binding = 1, std430) readonly buffer VertexBuffer {
-    Vertex vertices[];
-} vertexBuffer;
+#define LOAD_TANGENT_FRAME
+#include "vertex.glsl"
+#include "instance.glsl"
+#include "meshDraw.glsl"
 
 struct Material {
     int baseColorTextureIndex;
@@ -43,15 +38,11 @@ layout(location = 5) out vec3 fragTangent;
 layout(location = 6) out vec3 fragBiTangent;
 //----------------------------------------------------------------------
 
-// Push constant data --------------------------------------------------
-layout(push_constant) uniform PushConstantData {
-    mat4 model;
-    int meshIndex;
-} push;
-//----------------------------------------------------------------------
 void main() {
-    Vertex vertex = vertexBuffer.vertices[gl_VertexIndex];
-    Material material = materialBuffer.materials[push.meshIndex];
+    Instance instance = LoadInstance();
+    MeshDraw mesh = meshDrawBuffer.meshDraws[instance.meshIndex];
+    Vertex vertex = LoadVertex(uint(gl_VertexIndex), mesh.positionOffset, mesh.positionScale);
+    Material material = materialBuffer.materials[instance.materialIndex];
     
     fragTexCoord = vertex.texCoord;
     
@@ -59,7 +50,7 @@ void main() {
     fragNormalTextureIndex = material.normalTextureIndex;
     fragMetalicRoughness = material.metallicRoughnessTextureIndex;
     
-    mat4 modelMatrix = push.model;
+    mat4 modelMatrix = instance.model;
     fragTangent = normalize(modelMatrix * vec4(vertex.tangent, 0.0)).xyz;
     fragBiTangent = normalize(modelMatrix * vec4(vertex.biTangent, 0.0)).xyz;
     fragNormal = normalize(modelMatrix * vec4(vertex.normal, 0.0)).xyz;
@@ -0,0 +1,20 @@
+// Per instance placement and material in set 0, binding 5 (MeshInstance in ResourceManager.h),
+// and at binding 6 the indices of this frame's visible instances. Every draw covers the visible
+// instances of one mesh (of one mesh and LOD when cull.comp fills the list), its firstInstance
+// makes gl_InstanceIndex index the visible list.
+
+struct Instance {
+    mat4 model;
+    uint meshIndex;
+    uint materialIndex;
+};
+layout(set = 0, binding = 5, std430) readonly buffer InstanceBuffer {
+    Instance instances[];
+} instanceBuffer;
+layout(set = 0, binding = 6, std430) readonly buffer VisibleInstanceBuffer {
+    uint visibleInstances[];
+} visibleInstanceBuffer;
+
+Instance LoadInstance() {
+    return instanceBuffer.instances[visibleInstanceBuffer.visibleInstances[gl_InstanceIndex]];
+}
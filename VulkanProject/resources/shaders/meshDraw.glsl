@@ -0,0 +1,23 @@
+// Per mesh data in set 0, binding 7 (MeshDrawData in ResourceManager.h). The vertex shaders reach
+// it through the instance's meshIndex, the culling compute shaders read bounds and LODs from it.
+
+const uint MAX_MESH_LODS = 4;
+
+struct MeshDraw {
+    vec3 boundsCenter;
+    float boundsRadius;
+    vec3 positionOffset;
+    uint lodCount;
+    vec3 positionScale;
+    uint vertexOffset;
+    uint firstInstance;
+    uint instanceCount;
+    uint index16;
+    uint padding;
+    uint lodIndexOffsets[MAX_MESH_LODS];
+    uint lodIndexCounts[MAX_MESH_LODS];
+    float lodErrors[MAX_MESH_LODS];
+};
+layout(set = 0, binding = 7, std430) readonly buffer MeshDrawBuffer {
+    MeshDraw meshDraws[];
+} meshDrawBuffer;
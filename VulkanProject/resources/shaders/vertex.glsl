@@ -0,0 +1,100 @@
+// De-interleaved vertex streams in set 0: positions at binding 1, texture coordinates at
+// binding 3 and tangent frames at binding 4. Passes only declare what they read, the depth
+// prepass never touches the tangent frames.
+// Built with COMPACT_VERTICES the streams hold the CompactVertex words (VertexCompression.h).
+
+struct Vertex {
+    vec3 pos;
+    vec3 normal;
+    vec2 texCoord;
+    vec3 tangent;
+    vec3 biTangent;
+};
+
+#ifdef COMPACT_VERTICES
+layout(set = 0, binding = 1, std430) readonly buffer PositionStream {
+    uvec2 positions[];      // x | y << 16, z | bitangent sign << 16
+} positionStream;
+layout(set = 0, binding = 3, std430) readonly buffer TexCoordStream {
+    uint texCoords[];       // half x 2
+} texCoordStream;
+#ifdef LOAD_TANGENT_FRAME
+layout(set = 0, binding = 4, std430) readonly buffer TangentFrameStream {
+    uvec2 tangentFrames[];  // octahedral snorm16 x 2 normal, tangent
+} tangentFrameStream;
+#endif
+
+vec3 LoadPosition(uint index, vec3 positionOffset, vec3 positionScale) {
+    uvec2 packed = positionStream.positions[index];
+    vec3 quantized = vec3(packed.x & 0xffffu, packed.x >> 16, packed.y & 0xffffu);
+    return positionOffset + quantized * positionScale;
+}
+
+vec2 LoadTexCoord(uint index) {
+    return unpackHalf2x16(texCoordStream.texCoords[index]);
+}
+
+#ifdef LOAD_TANGENT_FRAME
+vec3 OctDecode(vec2 encoded) {
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (direction.z < 0.0) {
+        vec2 signNotZero = vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+        direction.xy = (1.0 - abs(direction.yx)) * signNotZero;
+    }
+    return normalize(direction);
+}
+
+void LoadTangentFrame(uint index, out vec3 normal, out vec3 tangent, out vec3 biTangent) {
+    uvec2 packed = tangentFrameStream.tangentFrames[index];
+    normal = OctDecode(unpackSnorm2x16(packed.x));
+    tangent = OctDecode(unpackSnorm2x16(packed.y));
+    float bitangentSign = (positionStream.positions[index].y & 0x10000u) != 0u ? -1.0 : 1.0;
+    biTangent = bitangentSign * cross(normal, tangent);
+}
+#endif
+#else
+// tightly packed floats, 3 per position and 9 per tangent frame
+layout(set = 0, binding = 1, std430) readonly buffer PositionStream {
+    float positions[];
+} positionStream;
+layout(set = 0, binding = 3, std430) readonly buffer TexCoordStream {
+    vec2 texCoords[];
+} texCoordStream;
+#ifdef LOAD_TANGENT_FRAME
+layout(set = 0, binding = 4, std430) readonly buffer TangentFrameStream {
+    float tangentFrames[];
+} tangentFrameStream;
+#endif
+
+vec3 LoadPosition(uint index, vec3 positionOffset, vec3 positionScale) {
+    uint base = index * 3u;
+    return vec3(positionStream.positions[base], positionStream.positions[base + 1u], positionStream.positions[base + 2u]);
+}
+
+vec2 LoadTexCoord(uint index) {
+    return texCoordStream.texCoords[index];
+}
+
+#ifdef LOAD_TANGENT_FRAME
+vec3 LoadFrameVector(uint base) {
+    return vec3(tangentFrameStream.tangentFrames[base], tangentFrameStream.tangentFrames[base + 1u], tangentFrameStream.tangentFrames[base + 2u]);
+}
+
+void LoadTangentFrame(uint index, out vec3 normal, out vec3 tangent, out vec3 biTangent) {
+    uint base = index * 9u;
+    normal = LoadFrameVector(base);
+    tangent = LoadFrameVector(base + 3u);
+    biTangent = LoadFrameVector(base + 6u);
+}
+#endif
+#endif
+
+#ifdef LOAD_TANGENT_FRAME
+Vertex LoadVertex(uint index, vec3 positionOffset, vec3 positionScale) {
+    Vertex vertex;
+    vertex.pos = LoadPosition(index, positionOffset, positionScale);
+    vertex.texCoord = LoadTexCoord(index);
+    LoadTangentFrame(index, vertex.normal, vertex.tangent, vertex.biTangent);
+    return vertex;
+}
+#endif